@@ -41,7 +41,8 @@ namespace Gauss {
         inline void init(unsigned int m, unsigned int n=1, unsigned int rowOffset = 0, unsigned int colOffset = 0) {
          
             //do everything in parallel
-            m_assembled.resize(m,n); // TODO need conditional to deal with case where MatrixType is a vector
+            //vector valued assemblers (i.e matrix vector products) keep a single column
+            m_assembled.resize(m, (MatrixType::ColsAtCompileTime == 1 ? 1 : n));
             m_assembled.setZero();
             
             for(unsigned int ii=0; ii < m_serialAssemblers.size(); ++ii) {
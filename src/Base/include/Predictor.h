@@ -0,0 +1,80 @@
+//
+//  Predictor.h
+//  Gauss
+//
+//  Initial guesses for the nonlinear solves in the implicit time steppers
+//
+//
+
+#ifndef Predictor_h
+#define Predictor_h
+
+#include <deque>
+#include <Eigen/Dense>
+
+namespace Gauss {
+
+    //Zero     : start Newton from zero (old behaviour)
+    //Constant : start from the current unknowns (i.e the last velocity and lagrange multipliers)
+    //Linear   : extrapolate the last two
+    //Quadratic: extrapolate the last three
+    enum class PredictorType { Zero, Constant, Linear, Quadratic };
+
+    //Keeps the unknowns (primal and dual) seen at the start of the last few steps and extrapolates them with equally spaced
+    //polynomials. Falls back to lower order while the history is filling up, the history is dropped when the problem size or
+    //the time step changes.
+    template<typename DataType>
+    class Predictor
+    {
+    public:
+
+        using VectorType = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+
+        Predictor(PredictorType type = PredictorType::Constant) { m_type = type; m_dt = 0; }
+
+        inline void setType(PredictorType type) { m_type = type; m_history.clear(); }
+        inline PredictorType getType() const { return m_type; }
+
+        inline void reset() { m_history.clear(); }
+
+        //x holds the current unknowns on input and the initial guess on output, dt is the step about to be taken
+        template<typename Vector>
+        void predict(Vector &x, double dt = 0) {
+
+            if(m_type == PredictorType::Zero) {
+                x.setZero();
+                return;
+            }
+
+            if(m_history.size() > 0 && (m_history.front().rows() != x.rows() || dt != m_dt)) {
+                m_history.clear();
+            }
+
+            m_dt = dt;
+
+            m_history.push_front(x);
+
+            unsigned int order = (m_type == PredictorType::Quadratic ? 3 : (m_type == PredictorType::Linear ? 2 : 1));
+
+            if(m_history.size() > order) {
+                m_history.pop_back();
+            }
+
+            if(m_history.size() == 3) {
+                x = 3.0*m_history[0] - 3.0*m_history[1] + m_history[2];
+            } else if(m_history.size() == 2) {
+                x = 2.0*m_history[0] - m_history[1];
+            }
+        }
+
+    protected:
+
+        PredictorType m_type;
+        double m_dt;
+        std::deque<VectorType> m_history; //most recent first
+
+    private:
+    };
+}
+
+#endif /* Predictor_h */
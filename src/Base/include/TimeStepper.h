@@ -31,7 +31,10 @@ namespace Gauss {
         void step(World &world) { m_impl.step(world, m_dt, m_t); m_t += m_dt; }
         inline DataType getTime() const { return m_t; }
         inline void setDt(DataType dt) { m_dt = dt; }
+        inline DataType getDt() const { return m_dt; }
+        inline void setTime(DataType t) { m_t = t; }
         inline auto & getLagrangeMultipliers() { return m_impl.getLagrangeMultipliers(); }
+        inline Impl & getImpl() { return m_impl; }
         
     protected:
         
@@ -0,0 +1,198 @@
+//
+//  TimeStepperAdaptive.h
+//  Gauss
+//
+//  Adaptive time step control wrapped around any of the fixed step TimeSteppers
+//
+//
+
+#ifndef TimeStepperAdaptive_h
+#define TimeStepperAdaptive_h
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <World.h>
+#include <TimeStepper.h>
+#include <UtilitiesEigen.h>
+
+namespace Gauss {
+
+    //Wraps a TimeStepper and picks dt for it. After every step the local error is estimated with the embedded trapezoidal
+    //position update, err = dt/2*|qDot_n+1 - qDot_n| (the leading term of backward Euler's local error), measured against
+    //atol + rtol*|q|. Steps with err > 1 (or that produce inf/nan) are rejected, the world state is restored and the step is
+    //retried with a smaller dt. Accepted steps grow or shrink dt with the standard controller dt*safety*err^(-1/2).
+    //A rejected step also resets what the wrapped stepper carried over from it (resetHistory(), i.e predictor history, lagged
+    //Hessian, contact warm starts). At dtMin steps that miss the tolerance are accepted with a warning, steps that blow up abort.
+    template<typename DataType, typename Stepper>
+    class TimeStepperAdaptive
+    {
+    public:
+
+        //params are forwarded to the wrapped stepper (after its dt)
+        template<typename ...Params>
+        TimeStepperAdaptive(DataType dt, DataType atol, DataType rtol, Params&& ...params) : m_stepper(dt, std::forward<Params>(params)...) {
+            m_dt = dt;
+            m_t = 0;
+            m_atol = atol;
+            m_rtol = rtol;
+            m_dtMin = 1e-4*dt;
+            m_dtMax = 1e2*dt;
+            m_safety = 0.9;
+            m_facMin = 0.2;
+            m_facMax = 2.0;
+            m_numAccepted = 0;
+            m_numRejected = 0;
+        }
+
+        //take one accepted step, returns the dt that was used
+        template<typename World>
+        DataType step(World &world);
+
+        //step until duration has elapsed, the last step is clipped to land on it exactly
+        template<typename World>
+        void advance(World &world, DataType duration);
+
+        inline void setDtBounds(DataType dtMin, DataType dtMax) { m_dtMin = dtMin; m_dtMax = dtMax; }
+        inline void setDt(DataType dt) { m_dt = std::min(std::max(dt, m_dtMin), m_dtMax); }
+
+        inline DataType getTime() const { return m_t; }
+        inline DataType getDt() const { return m_dt; }
+        inline unsigned int getNumAccepted() const { return m_numAccepted; }
+        inline unsigned int getNumRejected() const { return m_numRejected; }
+
+        inline auto & getLagrangeMultipliers() { return m_stepper.getLagrangeMultipliers(); }
+        inline Stepper & getStepper() { return m_stepper; }
+
+    protected:
+
+        //scaled max norm of the embedded error estimate, inf if the step blew up
+        template<typename World>
+        DataType errorEstimate(World &world, DataType dt);
+
+        Stepper m_stepper;
+
+        DataType m_t, m_dt, m_dtMin, m_dtMax;
+        DataType m_atol, m_rtol;
+        DataType m_safety, m_facMin, m_facMax;
+
+        unsigned int m_numAccepted, m_numRejected;
+
+        //state at the start of the step for roll back
+        Eigen::VectorXx<DataType> m_savedState, m_qDotOld;
+
+    private:
+    };
+
+    //steppers that keep data from previous steps around implement resetHistory(), the others have nothing to reset
+    template <typename T>
+    inline auto callResetHistory(T &t, int i) -> decltype( t.resetHistory() )
+    { t.resetHistory(); }
+
+    template <typename T>
+    inline void callResetHistory(T &t, long i)
+    {  }
+}
+
+template<typename DataType, typename Stepper>
+template<typename World>
+DataType Gauss::TimeStepperAdaptive<DataType, Stepper>::errorEstimate(World &world, DataType dt) {
+
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::Map<Eigen::VectorXx<DataType> > qDot = mapStateEigen<1>(world);
+
+    if(!q.allFinite() || !qDot.allFinite()) {
+        return std::numeric_limits<DataType>::infinity();
+    }
+
+    DataType err = 0;
+
+    for(unsigned int ii=0; ii<qDot.rows(); ++ii) {
+        DataType scale = m_atol + m_rtol*std::fabs(q[ii]);
+        err = std::max(err, 0.5*dt*std::fabs(qDot[ii] - m_qDotOld[ii])/scale);
+    }
+
+    return err;
+}
+
+template<typename DataType, typename Stepper>
+template<typename World>
+DataType Gauss::TimeStepperAdaptive<DataType, Stepper>::step(World &world) {
+
+    m_savedState = mapStateEigen(world);
+    m_qDotOld = mapStateEigen<1>(world);
+
+    while(true) {
+
+        m_stepper.setTime(m_t);
+        m_stepper.setDt(m_dt);
+        m_stepper.step(world);
+
+        DataType err = errorEstimate(world, m_dt);
+
+        if(err > 1 && m_dt > m_dtMin) {
+
+            //reject, roll back and shrink
+            mapStateEigen(world) = m_savedState;
+            callResetHistory(m_stepper.getImpl(), 0);
+
+            DataType factor = (std::isfinite(err) ? std::max(m_facMin, m_safety/std::sqrt(err)) : m_facMin);
+            m_dt = std::max(m_dtMin, m_dt*factor);
+            ++m_numRejected;
+            continue;
+        }
+
+        if(!std::isfinite(err)) {
+            mapStateEigen(world) = m_savedState;
+            assert(1 == 0);
+            std::cout<<"TimeStepperAdaptive: non-finite state at minimum dt \n";
+            exit(1);
+        }
+
+        if(err > 1) {
+            std::cout<<"TimeStepperAdaptive: error tolerance not met at minimum dt \n";
+        }
+
+        //accept and pick the next dt
+        DataType dtTaken = m_dt;
+        m_t += dtTaken;
+        ++m_numAccepted;
+
+        DataType factor = (err > 0 ? std::min(m_facMax, std::max(m_facMin, m_safety/std::sqrt(err))) : m_facMax);
+        m_dt = std::min(m_dtMax, std::max(m_dtMin, m_dt*factor));
+
+        return dtTaken;
+    }
+}
+
+template<typename DataType, typename Stepper>
+template<typename World>
+void Gauss::TimeStepperAdaptive<DataType, Stepper>::advance(World &world, DataType duration) {
+
+    DataType tEnd = m_t + duration;
+
+    while(m_t < tEnd - 1e-12*duration) {
+
+        DataType dtNext = m_dt;
+        bool clipped = false;
+
+        if(m_t + m_dt > tEnd) {
+            m_dt = tEnd - m_t;
+            clipped = true;
+        }
+
+        unsigned int numRejected = m_numRejected;
+        DataType dtTaken = step(world);
+
+        //a clipped step that went through says nothing about the dt the controller wanted, go back to the dt from before the
+        //clip unless the step had to be retried or the controller wants less than the clipped step
+        if(clipped && m_numRejected == numRejected && m_dt >= dtTaken) {
+            m_dt = dtNext;
+        } else if(clipped) {
+            m_dt = std::min(m_dt, dtNext);
+        }
+    }
+}
+
+#endif /* TimeStepperAdaptive_h */
@@ -0,0 +1,263 @@
+//
+//  TimeStepperEulerIMEX.h
+//  Gauss
+//
+//  Implicit-explicit Euler, rest state stiffness implicit, nonlinear remainder explicit
+//
+//
+
+#ifndef TimeStepperEulerIMEX_h
+#define TimeStepperEulerIMEX_h
+
+#include <limits>
+#include <World.h>
+#include <Assembler.h>
+#include <TimeStepper.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <UtilitiesEigen.h>
+#include <SolverPardiso.h>
+
+namespace Gauss {
+
+    //Splits the internal force as f(q) = K0*q + (f(q) - K0*q) where K0 is the stiffness matrix at the rest state (q = 0).
+    //The linear part is integrated with implicit Euler, the nonlinear remainder explicitly so the system matrix
+    //[M - dt^2*K0, J'; J, 0] never changes and each step is a single back substitution:
+    //  (M - dt^2*K0)*v+ = M*v + dt*(f(q) + f_body + f_ext) (constraints as in TimeStepperEulerImplicitLinear)
+    //numCorrections > 0 re-evaluates the nonlinear remainder at the predicted end of step position, each correction is another
+    //back substitution and moves the result towards fully implicit Euler. Corrections that don't contract are discarded.
+    //The factorization is rebuilt if dt, the number of DOFs or the number of constraints changes.
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    class TimeStepperImplEulerIMEX
+    {
+    public:
+
+        TimeStepperImplEulerIMEX(unsigned int numCorrections = 0) {
+            m_numCorrections = numCorrections;
+            m_factored = false;
+            m_dt = 0;
+        }
+
+        TimeStepperImplEulerIMEX(const TimeStepperImplEulerIMEX &toCopy) {
+            m_numCorrections = toCopy.m_numCorrections;
+            m_factored = false;
+            m_dt = 0;
+        }
+
+        ~TimeStepperImplEulerIMEX() {
+            #ifdef GAUSS_PARDISO
+                if(m_factored) {
+                    m_pardiso.cleanup();
+                }
+            #endif
+        }
+
+        //Methods
+        template<typename World>
+        void step(World &world, double dt, double t);
+
+        //rebuild K0 and the factorization on the next step (i.e after changing material parameters)
+        inline void reset() { m_factored = false; }
+
+        inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
+
+    protected:
+
+        template<typename World>
+        void factor(World &world, double dt);
+
+        //M*v + dt*(f_int(q) + f_body + f_ext(q)) for the current world state, constraint velocities in the tail
+        template<typename World>
+        void assembleRHS(World &world, double dt, Eigen::VectorXx<DataType> &rhs);
+
+        MatrixAssembler m_massMatrix;
+        MatrixAssembler m_stiffnessMatrix;
+        VectorAssembler m_forceVector;
+
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_K0;
+        Eigen::VectorXx<DataType> m_fBody;
+
+        unsigned int m_numCorrections, m_numDOFs, m_numConstraints;
+        bool m_factored;
+        double m_dt;
+
+        //storage for lagrange multipliers
+        typename VectorAssembler::MatrixType m_lagrangeMultipliers;
+
+#ifdef GAUSS_PARDISO
+
+        SolverPardiso<Eigen::SparseMatrix<DataType, Eigen::RowMajor> > m_pardiso;
+
+#else
+
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > m_solver;
+
+#endif
+
+    private:
+    };
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void TimeStepperImplEulerIMEX<DataType, MatrixAssembler, VectorAssembler>::factor(World &world, double dt) {
+
+    m_numDOFs = world.getNumQDotDOFs();
+    m_numConstraints = world.getNumConstraints();
+
+    //First two lines work around the fact that C++11 lambda can't directly capture a member variable.
+    MatrixAssembler &massMatrix = m_massMatrix;
+    MatrixAssembler &stiffnessMatrix = m_stiffnessMatrix;
+    VectorAssembler &forceVector = m_forceVector;
+
+    //mass matrix and constraints
+    ASSEMBLEMATINIT(massMatrix, m_numDOFs+m_numConstraints, m_numDOFs+m_numConstraints);
+    ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+    ASSEMBLELISTOFFSET(massMatrix, world.getConstraintList(), getGradient, m_numDOFs, 0);
+    ASSEMBLELISTOFFSETTRANSPOSE(massMatrix, world.getConstraintList(), getGradient, 0, m_numDOFs);
+    ASSEMBLEEND(massMatrix);
+
+    //rest state stiffness and body forces, the state is zeroed while they are assembled
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::VectorXx<DataType> qSaved = q;
+    q.setZero();
+
+    ASSEMBLEMATINIT(stiffnessMatrix, m_numDOFs+m_numConstraints, m_numDOFs+m_numConstraints);
+    ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
+    ASSEMBLELIST(stiffnessMatrix, world.getForceList(), getStiffnessMatrix);
+    ASSEMBLEEND(stiffnessMatrix);
+
+    //body force = total system force - internal force
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fBody = (*forceVector);
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getInternalForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fBody -= (*forceVector);
+    q = qSaved;
+
+    m_K0 = (*m_stiffnessMatrix).block(0,0, m_numDOFs, m_numDOFs);
+
+    Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = (*m_massMatrix) - dt*dt*(*m_stiffnessMatrix);
+
+#ifdef GAUSS_PARDISO
+    if(m_factored) {
+        m_pardiso.cleanup();
+    }
+
+    m_pardiso.symbolicFactorization(systemMatrix);
+    m_pardiso.numericalFactorization();
+#else
+    m_solver.compute(systemMatrix);
+
+    if(m_solver.info()!=Eigen::Success) {
+        // decomposition failed
+        assert(1 == 0);
+        std::cout<<"Decomposition Failed \n";
+        exit(1);
+    }
+#endif
+
+    m_dt = dt;
+    m_factored = true;
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void TimeStepperImplEulerIMEX<DataType, MatrixAssembler, VectorAssembler>::assembleRHS(World &world, double dt, Eigen::VectorXx<DataType> &rhs) {
+
+    VectorAssembler &forceVector = m_forceVector;
+
+    //internal forces of the systems plus external forces
+    ASSEMBLEVECINIT(forceVector, m_numDOFs+m_numConstraints);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getInternalForce);
+    ASSEMBLELIST(forceVector, world.getForceList(), getForce);
+    ASSEMBLELISTOFFSET(forceVector, world.getConstraintList(), getDbDt, m_numDOFs, 0);
+    ASSEMBLEEND(forceVector);
+
+    Eigen::Map<Eigen::VectorXx<DataType> > qDot = mapStateEigen<1>(world);
+
+    rhs = (*forceVector);
+    rhs.head(m_numDOFs) = (*m_massMatrix).block(0,0, m_numDOFs, m_numDOFs)*qDot + dt*((*forceVector).head(m_numDOFs) + m_fBody);
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void TimeStepperImplEulerIMEX<DataType, MatrixAssembler, VectorAssembler>::step(World &world, double dt, double t) {
+
+    if(!m_factored || m_dt != dt || m_numDOFs != world.getNumQDotDOFs() || m_numConstraints != world.getNumConstraints()) {
+        factor(world, dt);
+    }
+
+    //Grab the state
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::Map<Eigen::VectorXx<DataType> > qDot = mapStateEigen<1>(world);
+
+    Eigen::VectorXx<DataType> qStart = q;
+    Eigen::VectorXx<DataType> rhs, x0, xPrev;
+
+    //size of the last update, corrections have to shrink it or they are discarded
+    DataType lastChange = std::numeric_limits<DataType>::infinity();
+
+    assembleRHS(world, dt, rhs);
+
+    for(unsigned int ii=0; ii<=m_numCorrections; ++ii) {
+
+#ifdef GAUSS_PARDISO
+        m_pardiso.solve(rhs);
+        x0 = m_pardiso.getX();
+#else
+        x0 = m_solver.solve(rhs);
+
+        if(m_solver.info()!=Eigen::Success) {
+            // solving failed
+            assert(1 == 0);
+            std::cout<<"Solve Failed \n";
+            exit(1);
+        }
+#endif
+
+        //the fixed point iteration diverges when the tangent stiffness is far from K0 (large rotations), keep the previous iterate
+        //(velocities only, the multipliers are on a different scale)
+        DataType change = (ii == 0 ? (x0.head(m_numDOFs) - qDot).norm() : (x0.head(m_numDOFs) - xPrev.head(m_numDOFs)).norm());
+
+        if(ii > 0 && (!x0.allFinite() || change > lastChange)) {
+            x0 = xPrev;
+            break;
+        }
+
+        if(ii == m_numCorrections) {
+            break;
+        }
+
+        xPrev = x0;
+        lastChange = change;
+
+        //re-evaluate the explicit part at the predicted end of step position:
+        //f(q*) - K0*(q* - q) replaces f(q) so only the nonlinear remainder moves
+        Eigen::VectorXx<DataType> dq = dt*x0.head(m_numDOFs);
+
+        q = qStart + dq;
+        assembleRHS(world, dt, rhs);
+        rhs.head(m_numDOFs) -= dt*(m_K0*dq);
+        q = qStart;
+    }
+
+    qDot = x0.head(m_numDOFs);
+
+    m_lagrangeMultipliers = x0.tail(m_numConstraints);
+
+    //update state
+    updateState(world, world.getState(), dt);
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+using TimeStepperEulerIMEX = TimeStepper<DataType, TimeStepperImplEulerIMEX<DataType, MatrixAssembler, VectorAssembler> >;
+
+#endif /* TimeStepperEulerIMEX_h */
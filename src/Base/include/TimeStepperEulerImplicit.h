@@ -21,6 +21,7 @@
 #include <Eigen/SparseCholesky>
 #include <SolverPardiso.h>
 #include <GaussOptimizationAdapters.h>
+#include <Predictor.h>
 
 //TODO Solver Interface
 namespace Gauss {
@@ -31,12 +32,25 @@ namespace Gauss {
     {
     public:
 
-        TimeStepperImplEulerImplicit(unsigned int num_iterations = 100)  {
+        //mode = Lagged or LaggedLBFGS keeps the Hessian factorization across Newton iterations and time steps, it is refreshed after
+        //maxAge directions or once successive Newton steps shrink by less than rate (see DirectionLaggedNewtonAssembler)
+        //predictor picks the initial guess for Newton from the current and previous velocities and multipliers (see Predictor.h)
+        TimeStepperImplEulerImplicit(unsigned int num_iterations = 100, Optimization::HessianMode mode = Optimization::HessianMode::Full,
+                                     unsigned int maxAge = 20, DataType rate = 0.5, PredictorType predictor = PredictorType::Constant) : m_newton(mode, maxAge, rate), m_predictor(predictor) {
             m_num_iterations = num_iterations;
+            m_mode = mode;
+            m_maxAge = maxAge;
+            m_rate = rate;
+            m_dt = 0;
         }
 
-        TimeStepperImplEulerImplicit(const TimeStepperImplEulerImplicit &toCopy) {
-
+        TimeStepperImplEulerImplicit(const TimeStepperImplEulerImplicit &toCopy) : m_newton(toCopy.m_mode, toCopy.m_maxAge, toCopy.m_rate), m_predictor(toCopy.m_predictor.getType()) {
+            m_num_iterations = toCopy.m_num_iterations;
+            m_mode = toCopy.m_mode;
+            m_maxAge = toCopy.m_maxAge;
+            m_rate = toCopy.m_rate;
+            m_dt = 0;
+            m_newton.setTimeBudget(toCopy.m_newton.getTimeBudget());
         }
 
         ~TimeStepperImplEulerImplicit() { }
@@ -48,6 +62,18 @@ namespace Gauss {
 
         inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
 
+        inline unsigned int getNumFactorizations() const { return m_newton.getDirection().getNumFactorizations(); }
+
+        inline Predictor<DataType> & getPredictor() { return m_predictor; }
+
+        //forget the predictor history, multipliers and lagged Hessian of previous steps (i.e after TimeStepperAdaptive rejects a step)
+        inline void resetHistory() { m_predictor.reset(); m_lagrangeMultipliers.resize(0); m_newton.getDirection().refresh(); }
+
+        //wall clock budget per step in seconds for interactive use (0 = none), Newton stops before it would overrun and keeps
+        //the iterate with the smallest residual, getNewtonReport() says how the last step went
+        inline void setTimeBudget(double seconds) { m_newton.setTimeBudget(seconds); }
+        inline const Optimization::NewtonReport & getNewtonReport() const { return m_newton.getReport(); }
+
     protected:
 
         MatrixAssembler m_massMatrix;
@@ -56,9 +82,13 @@ namespace Gauss {
         VectorAssembler m_forceVector;
         VectorAssembler m_b;
         
-        unsigned int m_num_iterations;
+        unsigned int m_num_iterations, m_maxAge;
+        DataType m_rate;
+        double m_dt;
+        Optimization::HessianMode m_mode;
         typename VectorAssembler::MatrixType m_lagrangeMultipliers;
-        Optimization::NewtonSearchWithBackTracking<DataType> m_newton;
+        Optimization::NewtonSearchWithBackTracking<DataType, Optimization::DirectionLaggedNewtonAssembler<DataType> > m_newton;
+        Predictor<DataType> m_predictor;
         
     private:
     };
@@ -93,7 +123,22 @@ void TimeStepperImplEulerImplicit<DataType, MatrixAssembler, VectorAssembler>::s
         return getEnergy(world) - a.head(world.getNumQDOFs()).transpose()*(*massMatrix)*qDot;
     };
     
-    auto H = [&world, &massMatrix, &stiffnessMatrix, &dt, &qDot](auto &a)->auto & {
+    auto &direction = m_newton.getDirection();
+    direction.beginSolve();
+
+    //a lagged Hessian is M - dt^2*K for the dt it was built with
+    if(dt != m_dt) {
+        direction.refresh();
+        m_dt = dt;
+    }
+
+    auto H = [&world, &massMatrix, &stiffnessMatrix, &dt, &qDot, &direction](auto &a)->auto & {
+
+        //lagged Hessian, the direction solver still has a usable factorization
+        if(!direction.needsHessian(world.getNumQDotDOFs()+world.getNumConstraints())) {
+            return stiffnessMatrix;
+        }
+
         //get stiffness matrix
         ASSEMBLEMATINIT(stiffnessMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
         ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
@@ -142,11 +187,29 @@ void TimeStepperImplEulerImplicit<DataType, MatrixAssembler, VectorAssembler>::s
 
     };
 
-    //solve this using newton's method
+    //solve this using newton's method, starting from the predicted velocities and multipliers
     auto x0 = Eigen::VectorXd(world.getNumQDotDOFs()+world.getNumConstraints());
-    x0.setZero();
-    m_newton(x0, E, g, H, b, Aeq, update, 1e-4, m_num_iterations);
+    x0.head(world.getNumQDotDOFs()) = qDot;
+    
+    if(m_lagrangeMultipliers.rows() == world.getNumConstraints()) {
+        x0.tail(world.getNumConstraints()) = m_lagrangeMultipliers;
+    } else {
+        x0.tail(world.getNumConstraints()).setZero();
+    }
+    
+    m_predictor.predict(x0, dt);
+    
+    //forces with a step bound (barrier contact) are only finite along intersection free paths, the world is still at q here
+    //so pull the initial guess back and bound every line search the same way
+    x0.head(world.getNumQDotDOFs()) *= getStepBound(world, dt*x0.head(world.getNumQDotDOFs()));
+    
+    auto maxStep = [&world, &dt](auto &x, auto &p) {
+        return getStepBound(world, dt*p.head(world.getNumQDotDOFs()));
+    };
+    
+    m_newton(x0, E, g, H, b, Aeq, update, 1e-4, m_num_iterations, maxStep);
     
+    m_lagrangeMultipliers = x0.tail(world.getNumConstraints());
 
 }
 
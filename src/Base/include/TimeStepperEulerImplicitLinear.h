@@ -18,6 +18,7 @@
 #include <UtilitiesMATLAB.h>
 #include <Eigen/SparseCholesky>
 #include <SolverPardiso.h>
+#include <SolverMixedPrecision.h>
 
 //TODO Solver Interface
 namespace Gauss {
@@ -28,18 +29,27 @@ namespace Gauss {
     {
     public:
         
-        TimeStepperImplEulerImplicitLinear(bool refactor = true) {
+        //precision selects a single precision factorization + refinement/PCG for large systems (see SolverMixedPrecision.h),
+        //PCG falls back to refinement when the world has constraints
+        TimeStepperImplEulerImplicitLinear(bool refactor = true, SolverPrecision precision = SolverPrecision::Double) : m_mixedSolver(precision) {
             m_factored = false;
             m_refactor = refactor;
+            m_precision = precision;
+            m_dt = 0;
         }
         
-        TimeStepperImplEulerImplicitLinear(const TimeStepperImplEulerImplicitLinear &toCopy) {
+        TimeStepperImplEulerImplicitLinear(const TimeStepperImplEulerImplicitLinear &toCopy) : m_mixedSolver(toCopy.m_precision) {
             m_factored = false;
+            m_refactor = toCopy.m_refactor;
+            m_precision = toCopy.m_precision;
+            m_dt = 0;
         }
         
         ~TimeStepperImplEulerImplicitLinear() {
             #ifdef GAUSS_PARDISO
-                m_pardiso.cleanup();
+                if(m_factored && m_precision == SolverPrecision::Double) {
+                    m_pardiso.cleanup();
+                }
             #endif
         }
         
@@ -59,11 +69,20 @@ namespace Gauss {
         typename VectorAssembler::MatrixType m_lagrangeMultipliers;
         
         bool m_factored, m_refactor;
+        SolverPrecision m_precision;
+        double m_dt;
+        
+        SolverMixedPrecision<DataType> m_mixedSolver;
         
 #ifdef GAUSS_PARDISO
         
         SolverPardiso<Eigen::SparseMatrix<DataType, Eigen::RowMajor> > m_pardiso;
         
+#else
+        
+        //kept around so the factorization can be reused when m_refactor is false
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > m_solver;
+        
 #endif
         
     private:
@@ -78,7 +97,11 @@ void TimeStepperImplEulerImplicitLinear<DataType, MatrixAssembler, VectorAssembl
     Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix;
     Eigen::VectorXx<DataType> x0;
     
-    if(m_refactor || !m_factored) {
+    //a cached factorization is only valid for the dt it was built with
+    bool refactor = m_refactor || !m_factored || dt != m_dt;
+    m_dt = dt;
+    
+    if(refactor) {
         
         //First two lines work around the fact that C++11 lambda can't directly capture a member variable.
         MatrixAssembler &massMatrix = m_massMatrix;
@@ -119,41 +142,72 @@ void TimeStepperImplEulerImplicitLinear<DataType, MatrixAssembler, VectorAssembl
     //setup RHS
     (*forceVector).head(world.getNumQDotDOFs()) = (*m_massMatrix).block(0,0, world.getNumQDotDOFs(), world.getNumQDotDOFs())*qDot + dt*(*forceVector).head(world.getNumQDotDOFs());
     
-#ifdef GAUSS_PARDISO
-    if(m_refactor || !m_factored) {
-        m_pardiso.symbolicFactorization(systemMatrix);
-        m_pardiso.numericalFactorization();
-        m_factored = true; 
-    }
+    if(m_precision != SolverPrecision::Double) {
+        
+        //single precision factor, double precision accuracy recovered by the solver
+        if(refactor) {
+            
+            //constraints make the system matrix indefinite, CG is not valid there so refine instead
+            m_mixedSolver.setMode((m_precision == SolverPrecision::MixedPCG && world.getNumConstraints() > 0) ? SolverPrecision::MixedRefinement : m_precision);
+            m_mixedSolver.compute(systemMatrix);
+            m_factored = true;
+            
+            if(m_mixedSolver.info()!=Eigen::Success) {
+                // decomposition failed
+                assert(1 == 0);
+                std::cout<<"Decomposition Failed \n";
+                exit(1);
+            }
+        }
+        
+        x0 = m_mixedSolver.solve((*forceVector));
+        
+        if(m_mixedSolver.info()!=Eigen::Success) {
+            // solving failed (refinement or PCG did not reach the tolerance)
+            assert(1 == 0);
+            std::cout<<"Solve Failed \n";
+            exit(1);
+        }
+        
+    } else {
     
-    m_pardiso.solve(*forceVector);
-    x0 = m_pardiso.getX();
-    //m_pardiso.cleanup();
+#ifdef GAUSS_PARDISO
+        if(refactor) {
+            if(m_factored) {
+                m_pardiso.cleanup();
+            }
+            
+            m_pardiso.symbolicFactorization(systemMatrix);
+            m_pardiso.numericalFactorization();
+            m_factored = true;
+        }
+        
+        m_pardiso.solve(*forceVector);
+        x0 = m_pardiso.getX();
 #else
-    //solve system (Need interface for solvers but for now just use Eigen LLt)
-    Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > solver;
-    
-    if(m_refactor || !m_factored) {
-        solver.compute(systemMatrix);
-    }
-    
-    if(solver.info()!=Eigen::Success) {
-        // decomposition failed
-        assert(1 == 0);
-        std::cout<<"Decomposition Failed \n";
-        exit(1);
-    }
-    
-    if(solver.info()!=Eigen::Success) {
-        // solving failed
-        assert(1 == 0);
-        std::cout<<"Solve Failed \n";
-        exit(1);
-    }
-
-    
-    x0 = solver.solve((*forceVector));
+        //solve system (Need interface for solvers but for now just use Eigen LLt)
+        if(refactor) {
+            m_solver.compute(systemMatrix);
+            m_factored = true;
+        }
+        
+        if(m_solver.info()!=Eigen::Success) {
+            // decomposition failed
+            assert(1 == 0);
+            std::cout<<"Decomposition Failed \n";
+            exit(1);
+        }
+        
+        x0 = m_solver.solve((*forceVector));
+        
+        if(m_solver.info()!=Eigen::Success) {
+            // solving failed
+            assert(1 == 0);
+            std::cout<<"Solve Failed \n";
+            exit(1);
+        }
 #endif
+    }
     
     qDot = x0.head(world.getNumQDotDOFs());
     
@@ -0,0 +1,208 @@
+//
+//  TimeStepperEulerImplicitNewtonKrylov.h
+//  Gauss
+//
+//  Fully implicit Euler solved by inexact Newton with matrix free CG
+//
+//
+
+#ifndef TimeStepperEulerImplicitNewtonKrylov_h
+#define TimeStepperEulerImplicitNewtonKrylov_h
+
+#include <World.h>
+#include <Assembler.h>
+#include <AssemblerMVP.h>
+#include <TimeStepper.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <UtilitiesEigen.h>
+#include <GaussOptimizationAdapters.h>
+#include <Predictor.h>
+
+namespace Gauss {
+
+    //Same nonlinear problem, line search and constraint treatment as TimeStepperEulerImplicit but the stiffness matrix is never
+    //assembled or factored, Newton directions come from CG on stiffness matrix vector products (see DirectionNewtonKrylov).
+    //The block Jacobi preconditioner is built from M - dt^2*K at the first step and rebuilt every pcRefresh steps (0 = never),
+    //only its 3x3 diagonal blocks are kept.
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    class TimeStepperImplEulerImplicitNewtonKrylov
+    {
+    public:
+
+        TimeStepperImplEulerImplicitNewtonKrylov(unsigned int num_iterations = 100, unsigned int maxCGIterations = 1000, unsigned int pcRefresh = 0,
+                                                 PredictorType predictor = PredictorType::Constant) : m_newton(maxCGIterations), m_predictor(predictor) {
+            m_num_iterations = num_iterations;
+            m_maxCGIterations = maxCGIterations;
+            m_pcRefresh = pcRefresh;
+            m_stepsSincePC = 0;
+        }
+
+        TimeStepperImplEulerImplicitNewtonKrylov(const TimeStepperImplEulerImplicitNewtonKrylov &toCopy) : m_newton(toCopy.m_maxCGIterations), m_predictor(toCopy.m_predictor.getType()) {
+            m_num_iterations = toCopy.m_num_iterations;
+            m_maxCGIterations = toCopy.m_maxCGIterations;
+            m_pcRefresh = toCopy.m_pcRefresh;
+            m_stepsSincePC = 0;
+            m_newton.setTimeBudget(toCopy.m_newton.getTimeBudget());
+        }
+
+        ~TimeStepperImplEulerImplicitNewtonKrylov() { }
+
+        //Methods
+        template<typename World>
+        void step(World &world, double dt, double t);
+
+        inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
+
+        inline unsigned int getNumCGIterations() const { return m_newton.getDirection().getNumCGIterations(); }
+
+        inline Predictor<DataType> & getPredictor() { return m_predictor; }
+
+        //forget the predictor history and multipliers of previous steps (i.e after TimeStepperAdaptive rejects a step)
+        inline void resetHistory() { m_predictor.reset(); m_lagrangeMultipliers.resize(0); }
+
+        //same as TimeStepperImplEulerImplicit::setTimeBudget
+        inline void setTimeBudget(double seconds) { m_newton.setTimeBudget(seconds); }
+        inline const Optimization::NewtonReport & getNewtonReport() const { return m_newton.getReport(); }
+
+    protected:
+
+        MatrixAssembler m_massMatrix;
+        MatrixAssembler m_Aeq;
+        VectorAssembler m_forceVector;
+        VectorAssembler m_b;
+
+        #ifdef GAUSS_OPENMP
+            AssemblerParallel<DataType, AssemblerMVPEigen<DataType> > m_stiffnessMVP;
+        #else
+            AssemblerMVPEigen<DataType> m_stiffnessMVP;
+        #endif
+
+        unsigned int m_num_iterations, m_maxCGIterations, m_pcRefresh, m_stepsSincePC;
+        typename VectorAssembler::MatrixType m_lagrangeMultipliers;
+        Optimization::NewtonSearchWithBackTracking<DataType, Optimization::DirectionNewtonKrylov<DataType> > m_newton;
+        Predictor<DataType> m_predictor;
+
+    private:
+    };
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void TimeStepperImplEulerImplicitNewtonKrylov<DataType, MatrixAssembler, VectorAssembler>::step(World &world, double dt, double t) {
+
+    //First two lines work around the fact that C++11 lambda can't directly capture a member variable.
+    MatrixAssembler &massMatrix = m_massMatrix;
+    MatrixAssembler &AeqMatrix = m_Aeq;
+
+    VectorAssembler &bVector = m_b;
+    VectorAssembler &forceVector = m_forceVector;
+
+    auto &stiffnessMVP = m_stiffnessMVP;
+    auto &direction = m_newton.getDirection();
+
+    //Grab the state
+    Eigen::VectorXd q = mapStateEigen<0>(world);
+    Eigen::VectorXd qDot = mapStateEigen<1>(world);
+
+    ///get mass matrix
+    ASSEMBLEMATINIT(massMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+    ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+    ASSEMBLEEND(massMatrix);
+
+    //preconditioner, the assembled matrix only lives long enough to extract its diagonal blocks
+    if(direction.getPreconditioner().rows() != world.getNumQDotDOFs() || (m_pcRefresh > 0 && m_stepsSincePC >= m_pcRefresh)) {
+
+        MatrixAssembler stiffnessMatrix;
+
+        ASSEMBLEMATINIT(stiffnessMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+        ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
+        ASSEMBLELIST(stiffnessMatrix, world.getForceList(), getStiffnessMatrix);
+        ASSEMBLEEND(stiffnessMatrix);
+
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> A = (*massMatrix) - dt*dt*(*stiffnessMatrix);
+        direction.getPreconditioner().compute(A);
+        m_stepsSincePC = 0;
+    }
+
+    ++m_stepsSincePC;
+
+    auto E = [&world, &massMatrix, &qDot](auto &a) {
+        return getEnergy(world) - a.head(world.getNumQDOFs()).transpose()*(*massMatrix)*qDot;
+    };
+
+    //(M - dt^2*K)*v, stiffness product happens during assembly
+    auto mvp = [&world, &massMatrix, &stiffnessMVP, &dt](const auto &v) -> Eigen::VectorXx<DataType> {
+
+        Eigen::VectorXx<DataType> x = v;
+
+        ASSEMBLEMATINIT(stiffnessMVP, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+        stiffnessMVP.getImpl().setX(x);
+        ASSEMBLELIST(stiffnessMVP, world.getSystemList(), getStiffnessMatrix);
+        ASSEMBLELIST(stiffnessMVP, world.getForceList(), getStiffnessMatrix);
+        ASSEMBLEEND(stiffnessMVP);
+
+        return (*massMatrix)*x - dt*dt*(*stiffnessMVP);
+    };
+
+    //the world is already at the current iterate when the direction is computed so H just hands back the product
+    auto H = [&mvp](auto &a)->auto & {
+        return mvp;
+    };
+
+    auto Aeq = [&world, &AeqMatrix](auto &a)->auto & {
+
+        ASSEMBLEMATINIT(AeqMatrix, world.getNumConstraints(), world.getNumQDotDOFs());
+        ASSEMBLELISTCONSTRAINT(AeqMatrix, world.getConstraintList(), getGradient);
+        ASSEMBLEEND(AeqMatrix);
+
+        return AeqMatrix;
+    };
+
+    auto g = [&world, &massMatrix, &forceVector, &dt, &qDot](auto &a) -> auto & {
+        ASSEMBLEVECINIT(forceVector, world.getNumQDotDOFs());
+        ASSEMBLELIST(forceVector, world.getForceList(), getForce);
+        ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+        ASSEMBLEEND(forceVector);
+
+        (*forceVector).head(world.getNumQDotDOFs()) *= -dt;
+        (*forceVector).head(world.getNumQDotDOFs()) += (*massMatrix)*(a.head(world.getNumQDOFs())-qDot);
+
+        return forceVector;
+    };
+
+    auto b = [&world, &bVector](auto &a) -> auto & {
+        ASSEMBLEVECINIT(bVector, world.getNumConstraints());
+        ASSEMBLELISTCONSTRAINT(bVector, world.getConstraintList(), getDbDt);
+        ASSEMBLEEND(bVector);
+
+        return bVector;
+    };
+
+    auto update = [&world, &q, &dt](auto &dx) {
+        mapStateEigen<1>(world) = dx.head(world.getNumQDOFs());
+        mapStateEigen<0>(world) = q + dt*dx.head(world.getNumQDOFs());
+    };
+
+    //solve this using inexact newton's method
+    direction.beginSolve();
+
+    auto x0 = Eigen::VectorXd(world.getNumQDotDOFs()+world.getNumConstraints());
+    x0.head(world.getNumQDotDOFs()) = qDot;
+
+    if(m_lagrangeMultipliers.rows() == world.getNumConstraints()) {
+        x0.tail(world.getNumConstraints()) = m_lagrangeMultipliers;
+    } else {
+        x0.tail(world.getNumConstraints()).setZero();
+    }
+
+    m_predictor.predict(x0, dt);
+    m_newton(x0, E, g, H, b, Aeq, update, 1e-4, m_num_iterations);
+
+    m_lagrangeMultipliers = x0.tail(world.getNumConstraints());
+}
+
+template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+using TimeStepperEulerImplicitNewtonKrylov = TimeStepper<DataType, TimeStepperImplEulerImplicitNewtonKrylov<DataType, MatrixAssembler, VectorAssembler> >;
+
+#endif /* TimeStepperEulerImplicitNewtonKrylov_h */
@@ -21,6 +21,7 @@
 #include <Eigen/SparseCholesky>
 #include <SolverPardiso.h>
 #include <GaussOptimizationAdapters.h>
+#include <Predictor.h>
 
 //This takes a single static time step by just minimizing the potential energy of the object
 namespace Gauss {
@@ -31,12 +32,13 @@ namespace Gauss {
     {
     public:
         
-        TimeStepperImplStatic(unsigned int num_iterations = 1000)  {
+        //predictor picks the initial guess for Newton from the current and previous configurations (see Predictor.h)
+        TimeStepperImplStatic(unsigned int num_iterations = 1000, PredictorType predictor = PredictorType::Constant) : m_predictor(predictor) {
             m_num_iterations = num_iterations;
         }
         
-        TimeStepperImplStatic(const TimeStepperImplStatic &toCopy) {
-            
+        TimeStepperImplStatic(const TimeStepperImplStatic &toCopy) : m_predictor(toCopy.m_predictor.getType()) {
+            m_num_iterations = toCopy.m_num_iterations;
         }
         
         ~TimeStepperImplStatic() { }
@@ -48,6 +50,11 @@ namespace Gauss {
         
         inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
         
+        inline Predictor<DataType> & getPredictor() { return m_predictor; }
+        
+        //forget the predictor history and multipliers of previous steps
+        inline void resetHistory() { m_predictor.reset(); m_lagrangeMultipliers.resize(0); }
+        
     protected:
         
         MatrixAssembler m_stiffnessMatrix;
@@ -58,6 +65,7 @@ namespace Gauss {
         unsigned int m_num_iterations;
         typename VectorAssembler::MatrixType m_lagrangeMultipliers;
         Optimization::NewtonSearchWithBackTracking<DataType> m_newton;
+        Predictor<DataType> m_predictor;
         
     private:
     };
@@ -128,11 +136,20 @@ void TimeStepperImplStatic<DataType, MatrixAssembler, VectorAssembler>::step(Wor
         
     };
     
-    //solve this using newton's method
+    //solve this using newton's method, starting from the predicted configuration and multipliers
     auto x0 = Eigen::VectorXd(world.getNumQDOFs()+world.getNumConstraints());
-    x0.setZero();
+    x0.head(world.getNumQDOFs()) = q;
+    
+    if(m_lagrangeMultipliers.rows() == world.getNumConstraints()) {
+        x0.tail(world.getNumConstraints()) = m_lagrangeMultipliers;
+    } else {
+        x0.tail(world.getNumConstraints()).setZero();
+    }
+    
+    m_predictor.predict(x0, dt);
     m_newton(x0, E, g, H, b, Aeq, update, 1e-4, m_num_iterations);
     
+    m_lagrangeMultipliers = x0.tail(world.getNumConstraints());
     
 }
 
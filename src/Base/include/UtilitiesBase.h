@@ -8,6 +8,7 @@
 #ifndef UtilitiesBase_h
 #define UtilitiesBase_h
 
+#include <algorithm>
 #include <Assembler.h>
 #include <DOFParticle.h>
 #include <DOFRotation.h>
@@ -32,6 +33,28 @@ double getEnergy(World &world) {
     return energy;
 }
 
+//step bounds for anything in a force list, forces without one allow the full step
+template <typename T, typename State, typename Vector>
+inline auto callGetStepBound(T &t, State &state, const Vector &dq, int i) -> decltype( t.getStepBound(state, dq) )
+{ return t.getStepBound(state, dq); }
+
+template <typename T, typename State, typename Vector>
+inline double callGetStepBound(T &t, State &state, const Vector &dq, long i)
+{ return 1.0; }
+
+//largest fraction (at most 1) of the position change dq, starting at the current state, that every force allows
+//(barrier forces are infinite past contact so they bound steps with continuous collision detection)
+template<typename World, typename Vector>
+double getStepBound(World &world, const Vector &dq) {
+    
+    double alpha = 1.0;
+    forEach(world.getForceList(), [&alpha, &world, &dq](auto a) {
+        alpha = std::min(alpha, static_cast<double>(callGetStepBound(a->getImpl(), world.getState(), dq, 0)));
+    });
+    
+    return alpha;
+}
+
 
 template<typename World>
 double getBodyForceEnergy(World &world) {
@@ -9,13 +9,34 @@
 #ifndef CollisionDetector_h
 #define CollisionDetector_h
 
+#include <unordered_map>
+#include <vector>
 #include <Constraint.h>
 #include <UtilitiesEigen.h>
 #include <GaussIncludes.h>
+#include <UtilitiesContact.h>
 
 //This should become a constraint (just makes everything easier)
 namespace Gauss {
     namespace Collisions {
+        //contact rhs for detectors that provide one
+        template <typename T, typename Vector>
+        inline auto callGetContactBounds(T &t, Vector &b, int i) -> decltype( t.getContactBounds(b) )
+        { t.getContactBounds(b); }
+        
+        template <typename T, typename Vector>
+        inline auto callGetContactBounds(T &t, Vector &b, long i)
+        {  }
+        
+        //time step for detectors that need one
+        template <typename T, typename DataType>
+        inline auto callSetTimeStep(T &t, DataType dt, int i) -> decltype( t.setTimeStep(dt) )
+        { t.setTimeStep(dt); }
+        
+        template <typename T, typename DataType>
+        inline auto callSetTimeStep(T &t, DataType dt, long i)
+        {  }
+        
         template<typename DataType, typename CollisionDetectorImpl>
         class CollisionDetector
         {
@@ -41,8 +62,54 @@ namespace Gauss {
             template<typename World>
             inline void detectCollisions(World &world) {
                 m_impl.detectCollisions(world);
+                updateKeys();
+            }
+            
+            //Contact cache, multipliers of the last solve are kept per contact key (system, primitive of both objects) so
+            //contacts that persist to the next step can warm start the contact solver
+            
+            //rows offset, ..., offset + getNumCollisions() - 1 of lambda get the cached multipliers (0 for new contacts),
+            //duplicate keys share one cached value which goes to the first of them
+            template<typename Vector>
+            inline void getWarmStart(Vector &lambda, unsigned int offset) {
+                
+                std::unordered_map<ContactKey, DataType, ContactKeyHash> cache = m_multipliers;
+                
+                for(unsigned int ii=0; ii<m_keys.size(); ++ii) {
+                    
+                    auto cached = cache.find(m_keys[ii]);
+                    
+                    if(cached != cache.end()) {
+                        lambda[offset + ii] = cached->second;
+                        cached->second = 0;
+                    } else {
+                        lambda[offset + ii] = 0;
+                    }
+                }
             }
             
+            //store the multipliers of the current contacts (rows offset, ..., offset + getNumCollisions() - 1), contacts that
+            //are gone are forgotten
+            template<typename Vector>
+            inline void setMultipliers(const Vector &lambda, unsigned int offset) {
+                
+                m_multipliers.clear();
+                
+                for(unsigned int ii=0; ii<m_keys.size(); ++ii) {
+                    m_multipliers[m_keys[ii]] += lambda[offset + ii];
+                }
+            }
+            
+            inline void clearCache() { m_multipliers.clear(); }
+            
+            //time step of the solve the contact rows go into (continuous detection and contact bounds depend on it), steppers
+            //set it before every detection
+            inline void setTimeStep(DataType dt) { callSetTimeStep(m_impl, dt, 0); }
+            
+            inline const std::vector<ContactKey> & getContactKeys() const { return m_keys; }
+            
+            inline auto & getImpl() { return m_impl; }
+            
             inline unsigned int getNumRows() {
                 return getNumCollisions();
             }
@@ -51,9 +118,14 @@ namespace Gauss {
                 return m_impl.getNumCollisions();
             }
             
+            //contact rows are n'*(vA - vB) >= b, detectors that know how far a pair may still close during the step fill b
+            //(getContactBounds), the others keep b = 0
             template <typename Vector>
             inline void getDbDt(Vector &f,  const State<DataType> &state, const ConstraintIndex &index) {
-               
+                
+                Eigen::VectorXx<DataType> b = Eigen::VectorXx<DataType>::Zero(getNumCollisions());
+                callGetContactBounds(m_impl, b, 0);
+                assign(f, b, std::array<ConstraintIndex,1>{{index}});
             }
             
             //get Gradients
@@ -146,7 +218,34 @@ namespace Gauss {
             
         protected:
             
+            //keys in row order, the same order getGradient assembles the rows in
+            void updateKeys() {
+                
+                m_keys.resize(m_impl.getNumCollisions());
+                
+                unsigned int row = 0;
+                
+                forEach(m_impl.getCollisionsObjectA(), [this, &row](auto &collisionInfo) {
+                    m_keys[row].m_ids[0] = collisionInfo.getObject().type();
+                    m_keys[row].m_ids[1] = collisionInfo.getObject().index();
+                    m_keys[row].m_ids[2] = collisionInfo.getData(collisionInfo.collisionType);
+                    ++row;
+                });
+                
+                row = 0;
+                
+                forEach(m_impl.getCollisionsObjectB(), [this, &row](auto &collisionInfo) {
+                    m_keys[row].m_ids[3] = collisionInfo.getObject().type();
+                    m_keys[row].m_ids[4] = collisionInfo.getObject().index();
+                    m_keys[row].m_ids[5] = collisionInfo.getData(collisionInfo.collisionType);
+                    ++row;
+                });
+            }
+            
             CollisionDetectorImpl m_impl;
+            
+            std::vector<ContactKey> m_keys;
+            std::unordered_map<ContactKey, DataType, ContactKeyHash> m_multipliers;
         
             
         private:
@@ -154,6 +253,23 @@ namespace Gauss {
         
         template<typename DataType, template<typename A> class DetectorImpl>
         using ConstraintCollisionDetector = Constraint<DataType, CollisionDetector<DataType, DetectorImpl<DataType> > >;
+        
+        //contact cache access for anything in an inequality constraint list, constraints without a cache are skipped
+        template <typename T, typename Vector>
+        inline auto callGetWarmStart(T &t, Vector &lambda, unsigned int offset, int i) -> decltype( t.getWarmStart(lambda, offset) )
+        { t.getWarmStart(lambda, offset); }
+        
+        template <typename T, typename Vector>
+        inline auto callGetWarmStart(T &t, Vector &lambda, unsigned int offset, long i)
+        {  }
+        
+        template <typename T, typename Vector>
+        inline auto callSetMultipliers(T &t, const Vector &lambda, unsigned int offset, int i) -> decltype( t.setMultipliers(lambda, offset) )
+        { t.setMultipliers(lambda, offset); }
+        
+        template <typename T, typename Vector>
+        inline auto callSetMultipliers(T &t, const Vector &lambda, unsigned int offset, long i)
+        {  }
     }
 }
 
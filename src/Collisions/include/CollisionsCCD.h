@@ -0,0 +1,524 @@
+//
+//  CollisionsCCD.h
+//  Gauss
+//
+//  Continuous collision detection over a time step
+//
+//
+
+#ifndef CollisionsCCD_h
+#define CollisionsCCD_h
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <GaussIncludes.h>
+#include <UtilitiesContact.h>
+#include <CollisionsSelf.h>
+
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
+
+namespace Gauss {
+    namespace Collisions {
+
+        //a vertex pair taken from the earliest impact of a feature, vertexB = -1 - plane for planes. normal points from B towards A,
+        //approach is the relative motion of the closest points along the normal over the whole step (negative when closing)
+        template<typename DataType>
+        struct ImpactPair {
+            int vertexA, vertexB;
+            Eigen::Vector3x<DataType> normal;
+            Eigen::Vector3x<DataType> position;
+            DataType toi, approach;
+        };
+
+        //Continuous collision detection. Every surface vertex moves linearly from its current position x to x + dt*v
+        //(the motion the velocity level contact constraints act on, TimeStepperEulerImplicitLinearCollisions detects with the
+        //unconstrained end of step velocity in the state), the earliest time of impact of each vertex against
+        //planes and surface triangles and of each edge against other edges (any system, including itself) becomes a contact.
+        //Impacts are the first coplanarity time (or the start/end of the step) at which a feature pair is closer than the
+        //contact thickness, swept boxes in a spatial hash cull the pairs conservatively. Pairs that are already in contact at
+        //the start of the step get time 0 so resting contact is handled like the discrete detectors.
+        //Contacts are reported as vertex pair rows like CollisionSelfImpl. A pair may keep closing until its time of impact,
+        //so the rows are n'*(vA - vB) >= toi*approach/dt (getContactBounds) instead of freezing the pair where it was detected.
+        //thickness = 0 uses 10% of the average surface edge length
+        template<typename DataType>
+        class CollisionCCDImpl {
+
+        public:
+
+            template<typename World>
+            CollisionCCDImpl(World &world, DataType dt, DataType thickness = 0) {
+                m_dt = dt;
+                m_thickness = thickness;
+            }
+
+            ~CollisionCCDImpl() { }
+
+            template<typename World>
+            void detectCollisions(World &world);
+
+            //the normal points to the allowed side of the plane
+            inline void addPlane(const Eigen::Vector3x<DataType> &normal, const Eigen::Vector3x<DataType> &position) {
+                m_planes.conservativeResize(4, m_planes.cols()+1);
+                m_planes.template block<3,1>(0, m_planes.cols()-1) = normal;
+                m_planes(3, m_planes.cols()-1) = -normal.dot(position);
+            }
+
+            inline unsigned int getNumPlanes() const { return m_planes.cols(); }
+
+            //the time step of the integrator, TimeStepperEulerImplicitLinearCollisions sets it before every detection
+            inline void setTimeStep(DataType dt) { m_dt = dt; }
+            inline DataType getTimeStep() const { return m_dt; }
+
+            inline void setThickness(DataType thickness) { m_thickness = thickness; m_surfaces.clear(); }
+            inline DataType getThickness() const { return m_thickness; }
+
+            //rebuild the surface data on the next call (i.e after remeshing)
+            inline void reset() { m_surfaces.clear(); }
+
+            inline unsigned int getNumCollisions() const { return m_sharedList.size(); }
+
+            //time of impact of each contact as a fraction of the step
+            inline const std::vector<DataType> & getTimesOfImpact() const { return m_toiList; }
+
+            //lower bound of the normal velocity of each contact row, the pair moves along its swept path up to the time of
+            //impact and stops at the contact thickness (-gap/dt for planes), pairs touching at the start of the step get 0
+            template<typename Vector>
+            inline void getContactBounds(Vector &b) const {
+                for(unsigned int ii=0; ii<m_toiList.size(); ++ii) {
+                    b[ii] = std::min(m_toiList[ii]*m_approachList[ii], static_cast<DataType>(0))/m_dt;
+                }
+            }
+
+            inline auto & getCollisionsObjectA() { return m_objAList; }
+            inline auto & getCollisionsObjectB() { return m_objBList; }
+            inline auto & getSharedInfo() { return m_sharedList; }
+
+            inline const auto & getCollisionsObjectA() const { return m_objAList; }
+            inline const auto & getCollisionsObjectB() const { return m_objBList; }
+            inline const auto & getSharedInfo() const { return m_sharedList; }
+
+        protected:
+
+            void buildScene();
+            void detect();
+
+            DataType m_dt, m_thickness;
+            Eigen::Matrix<DataType, 4, Eigen::Dynamic> m_planes;
+
+            //per system surfaces, merged into one scene with global vertex ids (system offsets in m_offsets)
+            std::vector<CollisionSurface<DataType> > m_surfaces;
+            std::vector<SystemIndex> m_systems;
+            std::vector<int> m_offsets, m_vertexSystem;
+            Eigen::VectorXi m_vertices;
+            Eigen::MatrixXi m_F, m_E;
+            DataType m_cellSize, m_sceneThickness;
+
+            //positions at the start and end of the step, only surface rows are valid
+            Eigen::MatrixXx<DataType> m_X0, m_X1;
+
+            SpatialHash<DataType> m_triangleHash, m_edgeHash;
+
+            //per thread contact buffers
+            std::vector<std::vector<ImpactPair<DataType> > > m_threadContacts;
+
+            //only vertex collisions for now
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objAList; //collision info for object A
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objBList; //collision info for object B
+            std::vector<SharedCollisionInfo<DataType>> m_sharedList; //normals and world space positions;
+            std::vector<DataType> m_toiList, m_approachList;
+
+        private:
+        };
+    }
+}
+
+template<typename DataType>
+void Gauss::Collisions::CollisionCCDImpl<DataType>::buildScene() {
+
+    std::vector<int> vertices;
+    int numF = 0, numE = 0;
+
+    m_cellSize = 0;
+
+    for(auto &surface : m_surfaces) {
+        numF += surface.F.rows();
+        numE += surface.E.rows();
+        m_cellSize += surface.cellSize;
+    }
+
+    m_cellSize = (m_surfaces.size() > 0 ? m_cellSize/m_surfaces.size() : static_cast<DataType>(1));
+    m_sceneThickness = (m_thickness > 0 ? m_thickness : static_cast<DataType>(0.1)*m_cellSize);
+
+    m_F.resize(numF, 3);
+    m_E.resize(numE, 2);
+    m_vertexSystem.assign(m_offsets.back(), -1);
+
+    numF = 0;
+    numE = 0;
+
+    for(unsigned int ii=0; ii<m_surfaces.size(); ++ii) {
+
+        auto &surface = m_surfaces[ii];
+
+        m_F.block(numF, 0, surface.F.rows(), 3) = surface.F.array() + m_offsets[ii];
+        m_E.block(numE, 0, surface.E.rows(), 2) = surface.E.array() + m_offsets[ii];
+
+        numF += surface.F.rows();
+        numE += surface.E.rows();
+
+        for(unsigned int jj=0; jj<surface.vertices.rows(); ++jj) {
+            vertices.push_back(surface.vertices[jj] + m_offsets[ii]);
+            m_vertexSystem[vertices.back()] = ii;
+        }
+    }
+
+    m_vertices = Eigen::Map<Eigen::VectorXi>(vertices.data(), vertices.size());
+}
+
+template<typename DataType>
+void Gauss::Collisions::CollisionCCDImpl<DataType>::detect() {
+
+    const Eigen::VectorXi &vertices = m_vertices;
+    const Eigen::MatrixXi &F = m_F;
+    const Eigen::MatrixXi &E = m_E;
+    const Eigen::MatrixXx<DataType> &X0 = m_X0;
+    const Eigen::MatrixXx<DataType> &X1 = m_X1;
+    const Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes = m_planes;
+    const DataType d = m_sceneThickness;
+    const DataType eps = std::numeric_limits<DataType>::epsilon()*m_cellSize;
+
+    std::vector<std::vector<ImpactPair<DataType> > > &threadContacts = m_threadContacts;
+    SpatialHash<DataType> &triangleHash = m_triangleHash;
+    SpatialHash<DataType> &edgeHash = m_edgeHash;
+
+    Eigen::MatrixXx<DataType> triMin(F.rows(), 3), triMax(F.rows(), 3);
+    Eigen::MatrixXx<DataType> edgeMin(E.rows(), 3), edgeMax(E.rows(), 3);
+
+    //swept boxes grown by the thickness
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<F.rows(); ++ii) {
+            triMin.row(ii) = X0.row(F(ii,0)).cwiseMin(X0.row(F(ii,1))).cwiseMin(X0.row(F(ii,2))).cwiseMin(
+                             X1.row(F(ii,0)).cwiseMin(X1.row(F(ii,1))).cwiseMin(X1.row(F(ii,2)))).array() - d;
+            triMax.row(ii) = X0.row(F(ii,0)).cwiseMax(X0.row(F(ii,1))).cwiseMax(X0.row(F(ii,2))).cwiseMax(
+                             X1.row(F(ii,0)).cwiseMax(X1.row(F(ii,1))).cwiseMax(X1.row(F(ii,2)))).array() + d;
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<E.rows(); ++ii) {
+            edgeMin.row(ii) = X0.row(E(ii,0)).cwiseMin(X0.row(E(ii,1))).cwiseMin(X1.row(E(ii,0)).cwiseMin(X1.row(E(ii,1)))).array() - d;
+            edgeMax.row(ii) = X0.row(E(ii,0)).cwiseMax(X0.row(E(ii,1))).cwiseMax(X1.row(E(ii,0)).cwiseMax(X1.row(E(ii,1)))).array() + d;
+        }
+    }
+
+    triangleHash.build(triMin, triMax, m_cellSize);
+    edgeHash.build(edgeMin, edgeMax, m_cellSize);
+
+    auto overlap = [](const auto &minA, const auto &maxA, const auto &minB, const auto &maxB) {
+        return (minA.array() <= maxB.array()).all() && (minB.array() <= maxA.array()).all();
+    };
+
+    for(auto &contacts : threadContacts) {
+        contacts.clear();
+    }
+
+    //orient n so the pair starts on its positive side (separation at t = 0, features can pass each other during the step),
+    //relative motion decides if they start touching
+    auto orient = [eps](Eigen::Vector3x<DataType> &n, const Eigen::Vector3x<DataType> &separation, const Eigen::Vector3x<DataType> &motion) {
+        DataType side = n.dot(separation);
+        if((std::abs(side) > eps && side < 0) || (std::abs(side) <= eps && n.dot(motion) > 0)) {
+            n = -n;
+        }
+    };
+
+    //threads own increasing ranges (static schedule) so the buffers merge in serial order
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+            std::vector<ImpactPair<DataType> > &contacts = threadContacts[omp_get_thread_num()];
+        #else
+            std::vector<ImpactPair<DataType> > &contacts = threadContacts[0];
+        #endif
+
+        std::vector<int> candidates;
+        std::vector<DataType> times;
+
+        //vertex-plane and vertex-triangle, earliest impact per vertex
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ii=0; ii<vertices.rows(); ++ii) {
+
+            int iv = vertices[ii];
+            Eigen::Vector3x<DataType> x0 = X0.row(iv).transpose();
+            Eigen::Vector3x<DataType> x1 = X1.row(iv).transpose();
+
+            DataType toi = 2, approach = 0;
+            int plane = -1, triangle = -1;
+            Eigen::Vector3x<DataType> normal, point, weights;
+
+            for(int jj=0; jj<planes.cols(); ++jj) {
+
+                DataType d0 = planes.template block<3,1>(0,jj).dot(x0) + planes(3,jj);
+                DataType d1 = planes.template block<3,1>(0,jj).dot(x1) + planes(3,jj);
+                DataType t = (d0 < d ? 0 : (d1 < d ? (d0 - d)/(d0 - d1) : 2));
+
+                if(t < toi) {
+                    toi = t;
+                    approach = d1 - d0;
+                    plane = jj;
+                    normal = planes.template block<3,1>(0,jj);
+                    point = x0 + t*(x1 - x0);
+                }
+            }
+
+            Eigen::Vector3x<DataType> boxMin = x0.cwiseMin(x1).array() - d;
+            Eigen::Vector3x<DataType> boxMax = x0.cwiseMax(x1).array() + d;
+
+            triangleHash.query(boxMin, boxMax, candidates);
+
+            for(int it : candidates) {
+
+                if(F(it,0) == iv || F(it,1) == iv || F(it,2) == iv || !overlap(boxMin.transpose(), boxMax.transpose(), triMin.row(it), triMax.row(it))) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> a0 = X0.row(F(it,0)).transpose(), a1 = X1.row(F(it,0)).transpose();
+                Eigen::Vector3x<DataType> b0 = X0.row(F(it,1)).transpose(), b1 = X1.row(F(it,1)).transpose();
+                Eigen::Vector3x<DataType> c0 = X0.row(F(it,2)).transpose(), c1 = X1.row(F(it,2)).transpose();
+
+                coplanarityTimes<DataType>(a0, b0, c0, x0, a1, b1, c1, x1, times);
+                times.insert(times.begin(), static_cast<DataType>(0));
+                times.push_back(1);
+
+                for(DataType t : times) {
+
+                    if(t >= toi) {
+                        break;
+                    }
+
+                    Eigen::Vector3x<DataType> a = a0 + t*(a1 - a0), b = b0 + t*(b1 - b0), c = c0 + t*(c1 - c0);
+                    Eigen::Vector3x<DataType> x = x0 + t*(x1 - x0), w;
+                    Eigen::Vector3x<DataType> p = closestPointTriangle<DataType>(x, a, b, c, w);
+                    Eigen::Vector3x<DataType> n = x - p;
+                    DataType distance = n.norm();
+
+                    if(distance >= d) {
+                        continue;
+                    }
+
+                    if(distance > eps) {
+                        n /= distance;
+                    } else {
+                        n = (b - a).cross(c - a).normalized();
+                    }
+
+                    Eigen::Vector3x<DataType> motion = (x1 - x0) - (w[0]*(a1 - a0) + w[1]*(b1 - b0) + w[2]*(c1 - c0));
+                    orient(n, x0 - (w[0]*a0 + w[1]*b0 + w[2]*c0), motion);
+
+                    toi = t;
+                    approach = n.dot(motion);
+                    plane = -1;
+                    triangle = it;
+                    normal = n;
+                    point = p;
+                    weights = w;
+                    break;
+                }
+            }
+
+            if(plane >= 0) {
+                contacts.push_back(ImpactPair<DataType>{iv, -1 - plane, normal, point, toi, approach});
+            } else if(triangle >= 0) {
+                for(unsigned int jj=0; jj<3; ++jj) {
+                    if(weights[jj] > 0) {
+                        contacts.push_back(ImpactPair<DataType>{iv, F(triangle,jj), normal, point, toi, approach});
+                    }
+                }
+            }
+        }
+
+        //edge-edge, earliest impact per edge against edges with a larger index,
+        //impacts at an edge end point are vertex-triangle cases
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ie=0; ie<E.rows(); ++ie) {
+
+            Eigen::Vector3x<DataType> p00 = X0.row(E(ie,0)).transpose(), p01 = X1.row(E(ie,0)).transpose();
+            Eigen::Vector3x<DataType> p10 = X0.row(E(ie,1)).transpose(), p11 = X1.row(E(ie,1)).transpose();
+
+            edgeHash.query(edgeMin.row(ie).transpose(), edgeMax.row(ie).transpose(), candidates);
+
+            DataType toi = 2, approach = 0;
+            int edge = -1;
+            Eigen::Vector3x<DataType> normal, point;
+
+            for(int je : candidates) {
+
+                if(je <= ie || E(je,0) == E(ie,0) || E(je,0) == E(ie,1) || E(je,1) == E(ie,0) || E(je,1) == E(ie,1) ||
+                   !overlap(edgeMin.row(ie), edgeMax.row(ie), edgeMin.row(je), edgeMax.row(je))) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> q00 = X0.row(E(je,0)).transpose(), q01 = X1.row(E(je,0)).transpose();
+                Eigen::Vector3x<DataType> q10 = X0.row(E(je,1)).transpose(), q11 = X1.row(E(je,1)).transpose();
+
+                coplanarityTimes<DataType>(p00, p10, q00, q10, p01, p11, q01, q11, times);
+                times.insert(times.begin(), static_cast<DataType>(0));
+                times.push_back(1);
+
+                for(DataType t : times) {
+
+                    if(t >= toi) {
+                        break;
+                    }
+
+                    Eigen::Vector3x<DataType> p0 = p00 + t*(p01 - p00), p1 = p10 + t*(p11 - p10);
+                    Eigen::Vector3x<DataType> q0 = q00 + t*(q01 - q00), q1 = q10 + t*(q11 - q10);
+
+                    DataType s, r;
+                    DataType distance2 = closestPointsSegments<DataType>(p0, p1, q0, q1, s, r);
+
+                    if(distance2 >= d*d || s <= 0 || s >= 1 || r <= 0 || r >= 1) {
+                        continue;
+                    }
+
+                    Eigen::Vector3x<DataType> pa = p0 + s*(p1 - p0);
+                    Eigen::Vector3x<DataType> n = pa - (q0 + r*(q1 - q0));
+                    DataType distance = std::sqrt(distance2);
+
+                    if(distance > eps) {
+                        n /= distance;
+                    } else {
+                        n = (p1 - p0).cross(q1 - q0);
+
+                        if(n.norm() <= eps*eps) {
+                            continue;
+                        }
+
+                        n.normalize();
+                    }
+
+                    Eigen::Vector3x<DataType> motion = ((p01 - p00) + s*((p11 - p10) - (p01 - p00))) - ((q01 - q00) + r*((q11 - q10) - (q01 - q00)));
+                    orient(n, (p00 + s*(p10 - p00)) - (q00 + r*(q10 - q00)), motion);
+
+                    toi = t;
+                    approach = n.dot(motion);
+                    edge = je;
+                    normal = n;
+                    point = pa;
+                    break;
+                }
+            }
+
+            if(edge >= 0) {
+                for(unsigned int jj=0; jj<2; ++jj) {
+                    for(unsigned int kk=0; kk<2; ++kk) {
+                        contacts.push_back(ImpactPair<DataType>{E(ie,jj), E(edge,kk), normal, point, toi, approach});
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename DataType>
+template<typename World>
+void Gauss::Collisions::CollisionCCDImpl<DataType>::detectCollisions(World &world) {
+
+    m_sharedList.clear();
+    m_objAList.clear();
+    m_objBList.clear();
+    m_toiList.clear();
+    m_approachList.clear();
+
+    #ifdef GAUSS_OPENMP
+        m_threadContacts.resize(omp_thread_count());
+    #else
+        m_threadContacts.resize(1);
+    #endif
+
+    bool buildSurfaces = (m_surfaces.size() == 0);
+
+    if(buildSurfaces) {
+        m_systems.clear();
+        m_offsets.assign(1, 0);
+    }
+
+    unsigned int objIndex = 0;
+
+    forEachIndex(world.getSystemList(), [&](auto type, auto index, auto &a) {
+
+        if(buildSurfaces) {
+            m_surfaces.push_back(CollisionSurface<DataType>());
+            buildCollisionSurface<DataType>(a, m_surfaces.back());
+            m_systems.push_back(SystemIndex(type, index));
+            m_offsets.push_back(m_offsets.back() + a->getGeometry().first.rows());
+        }
+
+        ++objIndex;
+    });
+
+    if(buildSurfaces) {
+        buildScene();
+        m_X0.resize(m_offsets.back(), 3);
+        m_X1.resize(m_offsets.back(), 3);
+    }
+
+    //start and predicted end of step positions
+    objIndex = 0;
+
+    forEachIndex(world.getSystemList(), [&](auto type, auto index, auto &a) {
+
+        const Eigen::VectorXi &surfaceVertices = m_surfaces[objIndex].vertices;
+        int offset = m_offsets[objIndex];
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp parallel for
+        #endif
+        for(int ii=0; ii<surfaceVertices.rows(); ++ii) {
+            m_X0.row(offset + surfaceVertices[ii]) = a->getPosition(world.getState(), surfaceVertices[ii]).transpose();
+            m_X1.row(offset + surfaceVertices[ii]) = m_X0.row(offset + surfaceVertices[ii]) + m_dt*a->getVelocity(world.getState(), surfaceVertices[ii]).transpose();
+        }
+
+        ++objIndex;
+    });
+
+    detect();
+
+    //merge
+    for(auto &contacts : m_threadContacts) {
+        for(auto &contact : contacts) {
+
+            int systemA = m_vertexSystem[contact.vertexA];
+
+            m_sharedList.push_back(SharedCollisionInfo<DataType>(contact.normal, contact.position));
+            m_toiList.push_back(contact.toi);
+            m_approachList.push_back(contact.approach);
+            m_objAList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_systems[systemA], contact.vertexA - m_offsets[systemA]));
+
+            if(contact.vertexB < 0) {
+                m_objBList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, SystemIndex(-1,0), -1 - contact.vertexB));
+            } else {
+                int systemB = m_vertexSystem[contact.vertexB];
+                m_objBList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_systems[systemB], contact.vertexB - m_offsets[systemB]));
+            }
+        }
+    }
+}
+
+#endif /* CollisionsCCD_h */
@@ -9,8 +9,17 @@
 #include "fcl/narrowphase/detail/traversal/collision_node.h"
 
 //GAUSS Stuff
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <igl/boundary_facets.h>
 #include <GaussIncludes.h>
 #include <UtilitiesContact.h>
+
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
 #define MAX_CONTACTS 100000
 
 // Collision detector fo    r triangle meshes using the flexibile collision library (https://github.com/flexible-collision-library/fcl)
@@ -31,7 +40,8 @@ namespace Gauss {
                 //std::vector< SystemIndex> &indexList = m_indexList;
                 m_firstTime = true;
                 
-                             
+                //at most 64 triangle contacts per object pair (each keeps its three vertex rows) after merging duplicate vertex rows
+                m_reduction.setMaxPerPair(64);
             }
             
             ~CollisionFCLImpl() {
@@ -44,6 +54,12 @@ namespace Gauss {
             
             inline unsigned int getNumCollisions() const { return m_sharedList.size(); }
             
+            //number of object pairs whose world space bounding boxes overlapped during the last detectCollisions
+            inline unsigned int getNumCandidatePairs() const { return m_candidatePairs.size(); }
+            
+            //applied to the vertex rows at the end of detectCollisions (setMaxPerPair(0) keeps every distinct row)
+            inline ContactReduction<DataType> & getContactReduction() { return m_reduction; }
+            
             inline auto & getCollisionsObjectA() { return m_objAList; }
             inline auto & getCollisionsObjectB() { return m_objBList; }
             inline auto & getSharedInfo() { return m_sharedList; }
@@ -64,6 +80,29 @@ namespace Gauss {
             std::vector< fcl::BVHModel<fcl::OBBRSS<DataType> > > m_bvhList;
             std::vector< SystemIndex > m_indexList; 
             
+            //collision meshes only hold the surface, boundary facets are cached on the first call. m_surfaceVertices maps
+            //BVH vertex ids back to system vertex ids, m_positions holds the current surface positions
+            std::vector<Eigen::VectorXi> m_surfaceVertices;
+            std::vector<Eigen::MatrixXx<DataType> > m_positions;
+            
+            //broad phase, world space bounding box per object (refit every call) and the overlapping pairs
+            std::vector<Eigen::Vector3x<DataType> > m_boxMin, m_boxMax;
+            std::vector<std::pair<unsigned int, unsigned int> > m_candidatePairs;
+            
+            //what the narrow phase keeps from an fcl contact
+            struct TriangleContact {
+                unsigned int pair;
+                int b1, b2;
+                Eigen::Vector3x<DataType> normal;
+                Eigen::Vector3x<DataType> position;
+                DataType depth;
+            };
+            
+            //per thread narrow phase results
+            std::vector<std::vector<TriangleContact> > m_threadContacts;
+            
+            ContactReduction<DataType> m_reduction;
+            
             bool m_firstTime;
             
         private:
@@ -87,24 +126,67 @@ void Gauss::Collisions::CollisionFCLImpl<DataType>::detectCollisions(World &worl
     std::vector< fcl::BVHModel<fcl::OBBRSS<DataType> > > &bvhList = m_bvhList;
     std::vector< SystemIndex > &indexList = m_indexList;
     
+    std::vector<Eigen::VectorXi> &surfaceVertices = m_surfaceVertices;
+    std::vector<Eigen::MatrixXx<DataType> > &positionList = m_positions;
+    
+    //current positions of the surface vertices, read in parallel
+    auto gather = [&world](auto &a, const Eigen::VectorXi &vertices, Eigen::MatrixXx<DataType> &positions) {
+        
+        positions.resize(vertices.rows(), 3);
+        
+        #ifdef GAUSS_OPENMP
+        #pragma omp parallel for
+        #endif
+        for(int ii=0; ii<static_cast<int>(vertices.rows()); ++ii) {
+            positions.row(ii) = a->getPosition(world.getState(), vertices[ii]).transpose();
+        }
+    };
+    
     if(m_firstTime) {
         
         m_bvhList.clear();
         m_indexList.clear();
+        m_surfaceVertices.clear();
+        m_positions.clear();
         
-        forEachIndex(world.getSystemList(), [&world, &bvhList, &indexList](auto type, auto index, auto &a) {
+        forEachIndex(world.getSystemList(), [&bvhList, &indexList, &surfaceVertices, &positionList, &gather](auto type, auto index, auto &a) {
+            
+            auto geometry = a->getGeometry();
             
-            Eigen::MatrixXx<DataType> positions;
-            positions.resize(a->getGeometry().first.rows(),3);
+            //volumetric meshes are reduced to their boundary, triangle meshes are used as is
+            Eigen::MatrixXi surface;
             
-            for(unsigned int ii=0; ii<a->getGeometry().first.rows(); ++ii) {
-                positions.row(ii) = a->getPosition(world.getState(),ii);
+            if(geometry.second.cols() == 4) {
+                igl::boundary_facets(geometry.second, surface);
+                surface = surface.rowwise().reverse().eval(); //igl boundary facets returns facet indices in reverse order
+            } else {
+                surface = geometry.second;
             }
             
+            //compact surface vertex numbering
+            Eigen::VectorXi localId = Eigen::VectorXi::Constant(geometry.first.rows(), -1);
+            std::vector<int> vertices;
+            
+            for(unsigned int ii=0; ii<surface.rows(); ++ii) {
+                for(unsigned int jj=0; jj<surface.cols(); ++jj) {
+                    
+                    if(localId[surface(ii,jj)] < 0) {
+                        localId[surface(ii,jj)] = vertices.size();
+                        vertices.push_back(surface(ii,jj));
+                    }
+                    
+                    surface(ii,jj) = localId[surface(ii,jj)];
+                }
+            }
+            
+            surfaceVertices.push_back(Eigen::Map<Eigen::VectorXi>(vertices.data(), vertices.size()));
+            positionList.push_back(Eigen::MatrixXx<DataType>());
+            gather(a, surfaceVertices.back(), positionList.back());
+            
             bvhList.push_back(fcl::BVHModel<fcl::OBBRSS<DataType> >());
             
             bvhList[bvhList.size()-1].beginModel();
-            bvhList[bvhList.size()-1].addSubModel(positions, a->getGeometry().second);
+            bvhList[bvhList.size()-1].addSubModel(positionList.back(), surface);
             bvhList[bvhList.size()-1].endModel();
             
             
@@ -115,62 +197,144 @@ void Gauss::Collisions::CollisionFCLImpl<DataType>::detectCollisions(World &worl
         m_firstTime = false;
     }
     
-    //update bvhs
-     unsigned int bvhIndex = 0;
-    //fill in collision data using retrived indices and collision data
-    forEachIndex(world.getSystemList(), [&bvhList, &bvhIndex, &world](auto type, auto index, auto &a) {
-        
-        bvhList[bvhIndex].beginUpdateModel();
-        for(unsigned int ii=0; ii<a->getGeometry().first.rows(); ++ii) {
-            bvhList[bvhIndex].updateVertex(a->getPosition(world.getState(), ii));
-        }
-        
-        bvhList[bvhIndex].endUpdateModel(true, true);
-        
+    //gather surface positions and world space bounding boxes
+    m_boxMin.resize(m_bvhList.size());
+    m_boxMax.resize(m_bvhList.size());
+    
+    unsigned int bvhIndex = 0;
+    
+    forEachIndex(world.getSystemList(), [&surfaceVertices, &positionList, &bvhIndex, &gather](auto type, auto index, auto &a) {
+        gather(a, surfaceVertices[bvhIndex], positionList[bvhIndex]);
         bvhIndex++;
-            
     });
     
-    //n^2 collision detection
-    fcl::Transform3<DataType> pose0 = fcl::Transform3<DataType>::Identity();
-    fcl::Transform3<DataType> pose1 = fcl::Transform3<DataType>::Identity();
+    //bottom up refit of the fixed topology surface bvhs, objects are independent
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for(int obj=0; obj<static_cast<int>(m_bvhList.size()); ++obj) {
+        
+        m_boxMin[obj] = m_positions[obj].colwise().minCoeff().transpose();
+        m_boxMax[obj] = m_positions[obj].colwise().maxCoeff().transpose();
+        
+        m_bvhList[obj].beginUpdateModel();
+        
+        for(unsigned int ii=0; ii<m_positions[obj].rows(); ++ii) {
+            m_bvhList[obj].updateVertex(m_positions[obj].row(ii).transpose());
+        }
+        
+        m_bvhList[obj].endUpdateModel(true, true);
+    }
     
-    //size_t num_max_contacts_=1, bool enable_contact_=false, size_t num_max_cost_sources_=1, bool enable_cost_=false, bool use_approximate_cost_=true, GJKSolverType gjk_solver_type_=GST_LIBCCD)
-    fcl::CollisionRequest<DataType> request(MAX_CONTACTS,true, 1, false, true);
-    fcl::CollisionResult<DataType> result;
+    //broad phase, sweep and prune along the axis with the largest spread of box centers
+    m_candidatePairs.clear();
     
-    for(unsigned int obj0=0; obj0<m_bvhList.size(); ++obj0) {
-        for(unsigned int obj1=obj0+1; obj1<m_bvhList.size(); ++obj1) {
-            
-            //do collision detection
-            fcl::collide(&m_bvhList[obj0],pose0, &m_bvhList[obj1], pose1, request, result);
+    if(m_bvhList.size() > 1) {
+        
+        Eigen::Vector3x<DataType> cMin, cMax;
+        cMin.setConstant(std::numeric_limits<DataType>::max());
+        cMax.setConstant(-std::numeric_limits<DataType>::max());
+        
+        for(unsigned int obj=0; obj<m_bvhList.size(); ++obj) {
+            cMin = cMin.cwiseMin(0.5*(m_boxMin[obj] + m_boxMax[obj]));
+            cMax = cMax.cwiseMax(0.5*(m_boxMin[obj] + m_boxMax[obj]));
+        }
+        
+        unsigned int axis = 0;
+        (cMax - cMin).maxCoeff(&axis);
+        
+        std::vector<Eigen::Vector3x<DataType> > &boxMin = m_boxMin;
+        std::vector<unsigned int> sorted(m_bvhList.size());
+        std::iota(sorted.begin(), sorted.end(), 0);
+        std::sort(sorted.begin(), sorted.end(), [&boxMin, axis](unsigned int a, unsigned int b) { return boxMin[a][axis] < boxMin[b][axis]; });
+        
+        for(unsigned int ii=0; ii<sorted.size(); ++ii) {
             
-            int numContacts = result.numContacts();
+            unsigned int obj0 = sorted[ii];
             
-            for(unsigned int ii=0; ii<numContacts; ++ii) {
+            for(unsigned int jj=ii+1; jj<sorted.size() && m_boxMin[sorted[jj]][axis] <= m_boxMax[obj0][axis]; ++jj) {
                 
-            //add each new contact to the contact list here
-            //b1, b2 = collision primitive in obj1 and obj2
-            //normal = contact normal
-            //x = world space contact position
+                unsigned int obj1 = sorted[jj];
                 
-                //add contrait for each vertex in triangle
-                for(unsigned int jj=0; jj< 3; ++jj){
-                    //m_sharedList.push_back(SharedCollisionInfo<DataType>(-result.getContact(ii).normal,result.getContact(ii).pos, result.getContact(ii).penetration_depth));
-                    //m_objAList.add(ObjectCollisionInfo<DataType,1>(m_sharedList.size()-1,m_indexList[obj0], result.getContact(ii).b1));
-                    //m_objBList.add(ObjectCollisionInfo<DataType,1>(m_sharedList.size()-1,m_indexList[obj1], result.getContact(ii).b2));
-                    unsigned int iv0 = m_bvhList[obj0].tri_indices[result.getContact(ii).b1][jj];
-                    unsigned int iv1 = m_bvhList[obj1].tri_indices[result.getContact(ii).b2][jj];
-                    m_sharedList.push_back(SharedCollisionInfo<DataType>(-result.getContact(ii).normal,Eigen::Vector3x<DataType>(0,0,0)));
-                    m_objAList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_indexList[obj0], iv0));
-                    m_objBList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_indexList[obj1], iv1));
+                if((m_boxMin[obj0].array() <= m_boxMax[obj1].array()).all() && (m_boxMin[obj1].array() <= m_boxMax[obj0].array()).all()) {
+                    m_candidatePairs.push_back(std::make_pair(std::min(obj0, obj1), std::max(obj0, obj1)));
                 }
             }
         }
+        
+        //same pair order as the all pairs loop so contacts come out in the same order
+        std::sort(m_candidatePairs.begin(), m_candidatePairs.end());
+    }
+    
+    //narrow phase on candidate pairs, each thread keeps its own contacts
+    #ifdef GAUSS_OPENMP
+        m_threadContacts.resize(omp_thread_count());
+    #else
+        m_threadContacts.resize(1);
+    #endif
+    
+    for(auto &contacts : m_threadContacts) {
+        contacts.clear();
+    }
+    
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for(int pair=0; pair<static_cast<int>(m_candidatePairs.size()); ++pair) {
+        
+        #ifdef GAUSS_OPENMP
+            std::vector<TriangleContact> &contacts = m_threadContacts[omp_get_thread_num()];
+        #else
+            std::vector<TriangleContact> &contacts = m_threadContacts[0];
+        #endif
+        
+        fcl::Transform3<DataType> pose0 = fcl::Transform3<DataType>::Identity();
+        fcl::Transform3<DataType> pose1 = fcl::Transform3<DataType>::Identity();
+        
+        //size_t num_max_contacts_=1, bool enable_contact_=false, size_t num_max_cost_sources_=1, bool enable_cost_=false, bool use_approximate_cost_=true, GJKSolverType gjk_solver_type_=GST_LIBCCD)
+        fcl::CollisionRequest<DataType> request(MAX_CONTACTS,true, 1, false, true);
+        fcl::CollisionResult<DataType> result;
+        
+        //do collision detection
+        fcl::collide(&m_bvhList[m_candidatePairs[pair].first],pose0, &m_bvhList[m_candidatePairs[pair].second], pose1, request, result);
+        
+        for(unsigned int ii=0; ii<result.numContacts(); ++ii) {
+            const fcl::Contact<DataType> &contact = result.getContact(ii);
+            contacts.push_back(TriangleContact{static_cast<unsigned int>(pair), static_cast<int>(contact.b1), static_cast<int>(contact.b2), contact.normal, contact.pos, contact.penetration_depth});
+        }
     }
     
+    //merge, ordered by pair (contacts of a pair all come from one thread so a stable sort keeps fcl's order)
+    std::vector<TriangleContact> contacts;
     
+    for(auto &threadContacts : m_threadContacts) {
+        contacts.insert(contacts.end(), threadContacts.begin(), threadContacts.end());
+    }
+    
+    std::stable_sort(contacts.begin(), contacts.end(), [](const TriangleContact &a, const TriangleContact &b) { return a.pair < b.pair; });
+    
+    for(auto &contact : contacts) {
+        
+        unsigned int obj0 = m_candidatePairs[contact.pair].first;
+        unsigned int obj1 = m_candidatePairs[contact.pair].second;
+        
+        //add each new contact to the contact list here
+        //b1, b2 = collision primitive in obj1 and obj2
+        //normal = contact normal
+        //x = world space contact position
+        
+        //add contrait for each vertex in triangle
+        for(unsigned int jj=0; jj< 3; ++jj){
+            unsigned int iv0 = m_surfaceVertices[obj0][m_bvhList[obj0].tri_indices[contact.b1][jj]];
+            unsigned int iv1 = m_surfaceVertices[obj1][m_bvhList[obj1].tri_indices[contact.b2][jj]];
+            m_sharedList.push_back(SharedCollisionInfo<DataType>(-contact.normal, contact.position, contact.depth));
+            m_objAList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_indexList[obj0], iv0));
+            m_objBList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, m_indexList[obj1], iv1));
+        }
+    }
     
+    //adjacent triangles produce the same vertex rows, deep meshes overlapping produce far too many
+    m_reduction.reduce(m_objAList, m_objBList, m_sharedList);
 }
 
 #endif
@@ -26,22 +26,41 @@
 #ifndef _COLLISIONFLOOR_H
 #define _COLLISIONFLOOR_H
 
+#include <algorithm>
+#include <vector>
+#include <igl/boundary_facets.h>
 #include <GaussIncludes.h>
 #include <UtilitiesContact.h>
 
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
+
 namespace Gauss {
     namespace Collisions {
         
+        //a vertex on the wrong side of a plane
+        template<typename DataType>
+        struct PlaneContact {
+            unsigned int vertex, plane;
+            Eigen::Vector3x<DataType> position;
+        };
+        
         //I've made a lot of different attempts at getting this right (sgh)
         template<typename Geometry>
         class DetectCollisions {
         public:
-            template<typename DataType, typename Object, typename ...Types>
-            inline static void planeContact(int type, int index, const Object *obj, const State<DataType> &state,
-                                       MultiVector<Types...> &listA, MultiVector<Types...> &listB,
-                                       std::vector<SharedCollisionInfo<DataType> > &info,
-                                       Eigen::Vector3x<DataType> &normal,
-                                       Eigen::Vector3x<DataType> &pos) {
+            template<typename Object>
+            inline static void surfaceVertices(Object *obj, Eigen::VectorXi &vertices) {
+                std::cout<<"Generic surfaceVertices routine does nothing \n";
+                exit(0);
+            }
+            
+            template<typename DataType, typename Object>
+            inline static void planeContact(const Object *obj, const State<DataType> &state, const Eigen::VectorXi &vertices,
+                                            const Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes,
+                                            std::vector<std::vector<PlaneContact<DataType> > > &threadContacts) {
                 std::cout<<"Generic planeContact routine does nothing \n";
                 exit(0);
             }
@@ -54,27 +73,87 @@ namespace Gauss {
         template<>
         class DetectCollisions<std::pair<Eigen::MatrixXd &, Eigen::MatrixXi &> >{
         public:
-            template<typename DataType, typename Object, typename ...Types>
-            inline static void planeContact(int type, int index, const Object *obj, const State<DataType> &state,
-                                       MultiVector<Types...> &listA, MultiVector<Types...> &listB,
-                                       std::vector<SharedCollisionInfo<DataType> > &info,
-                                       Eigen::Vector3x<DataType> &normal,
-                                       Eigen::Vector3x<DataType> &pos) {
+            
+            //vertices that can touch a plane, boundary of tet meshes, every referenced vertex otherwise
+            template<typename Object>
+            inline static void surfaceVertices(Object *obj, Eigen::VectorXi &vertices) {
                 
-                for(unsigned int iv =0; iv < obj->getImpl().getV().rows(); ++iv) {
-                    //if the object is on the wrong side of the floor, mark the collision
-                    double proj = (obj->getPosition(state, iv) - pos).dot(normal);
-                    
-                    if(proj < 0){
-                        //store collision
-                        info.push_back(SharedCollisionInfo<DataType>(normal,obj->getPosition(state, iv)));
-                        listA.add(ObjectCollisionInfo<DataType,0>(info.size()-1, SystemIndex(type,index), iv));
-                        listB.add(ObjectCollisionInfo<DataType,0>(info.size()-1, SystemIndex(-1,0), 0));
-                        
+                auto geometry = obj->getGeometry();
+                
+                Eigen::MatrixXi surface;
+                
+                if(geometry.second.cols() == 4) {
+                    igl::boundary_facets(geometry.second, surface);
+                } else {
+                    surface = geometry.second;
+                }
+                
+                std::vector<bool> onSurface(geometry.first.rows(), (surface.size() == 0));
+                
+                for(unsigned int ii=0; ii<surface.size(); ++ii) {
+                    onSurface[surface.data()[ii]] = true;
+                }
+                
+                std::vector<int> list;
+                
+                for(unsigned int iv=0; iv<onSurface.size(); ++iv) {
+                    if(onSurface[iv]) {
+                        list.push_back(iv);
                     }
                 }
                 
+                vertices = Eigen::Map<Eigen::VectorXi>(list.data(), list.size());
+            }
+            
+            //planes are stored column wise as [n; -n.p] so the signed distance of x is planes.col(i).dot([x; 1])
+            //vertices are processed in blocks, the distances to every plane of a block are a single matrix product
+            //each thread writes to its own contact list (ordered by vertex within the thread, threads own increasing ranges)
+            template<typename DataType, typename Object>
+            inline static void planeContact(const Object *obj, const State<DataType> &state, const Eigen::VectorXi &vertices,
+                                            const Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes,
+                                            std::vector<std::vector<PlaneContact<DataType> > > &threadContacts) {
                 
+                const int blockSize = 256;
+                const int numBlocks = (vertices.rows() + blockSize - 1)/blockSize;
+                
+                #ifdef GAUSS_OPENMP
+                #pragma omp parallel
+                #endif
+                {
+                    #ifdef GAUSS_OPENMP
+                        std::vector<PlaneContact<DataType> > &contacts = threadContacts[omp_get_thread_num()];
+                    #else
+                        std::vector<PlaneContact<DataType> > &contacts = threadContacts[0];
+                    #endif
+                    
+                    Eigen::Matrix<DataType, 4, Eigen::Dynamic> X(4, blockSize);
+                    Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic> distance;
+                    
+                    #ifdef GAUSS_OPENMP
+                    #pragma omp for schedule(static)
+                    #endif
+                    for(int block=0; block<numBlocks; ++block) {
+                        
+                        int start = block*blockSize;
+                        int size = std::min<int>(blockSize, vertices.rows() - start);
+                        
+                        for(int ii=0; ii<size; ++ii) {
+                            X.template block<3,1>(0, ii) = obj->getPosition(state, vertices[start+ii]);
+                            X(3, ii) = 1;
+                        }
+                        
+                        distance.noalias() = planes.transpose()*X.leftCols(size);
+                        
+                        for(int ii=0; ii<size; ++ii) {
+                            for(int jj=0; jj<planes.cols(); ++jj) {
+                                //if the object is on the wrong side of the floor, mark the collision
+                                if(distance(jj, ii) < 0) {
+                                    contacts.push_back(PlaneContact<DataType>{static_cast<unsigned int>(vertices[start+ii]), static_cast<unsigned int>(jj), X.template block<3,1>(0, ii)});
+                                }
+                            }
+                        }
+                    }
+                }
             }
             
         protected:
@@ -82,6 +161,7 @@ namespace Gauss {
         };
         
         //Some useful methods for plane-object collision checking
+        //any number of planes (half spaces) can be checked in one pass, only surface vertices are tested
         template<typename DataType>
         class CollisionFloorImpl {
 
@@ -89,8 +169,17 @@ namespace Gauss {
             
             template<typename World>
             CollisionFloorImpl(World &world, Eigen::Vector3x<DataType> floorNormal, Eigen::Vector3x<DataType> floorPosition) {
-                m_floorNormal = floorNormal;
-                m_floorPosition = floorPosition;
+                addPlane(floorNormal, floorPosition);
+            }
+            
+            template<typename World>
+            CollisionFloorImpl(World &world, std::vector<Eigen::Vector3x<DataType> > normals, std::vector<Eigen::Vector3x<DataType> > positions) {
+                
+                assert(normals.size() == positions.size());
+                
+                for(unsigned int ii=0; ii<normals.size(); ++ii) {
+                    addPlane(normals[ii], positions[ii]);
+                }
             }
             
             ~CollisionFloorImpl() { }
@@ -98,6 +187,19 @@ namespace Gauss {
             template<typename World>
             void detectCollisions(World &world);
             
+            //the normal points to the allowed side of the plane
+            inline void addPlane(const Eigen::Vector3x<DataType> &normal, const Eigen::Vector3x<DataType> &position) {
+                m_planes.conservativeResize(4, m_planes.cols()+1);
+                m_planes.template block<3,1>(0, m_planes.cols()-1) = normal;
+                m_planes(3, m_planes.cols()-1) = -normal.dot(position);
+                m_planeNormals.push_back(normal);
+            }
+            
+            inline unsigned int getNumPlanes() const { return m_planes.cols(); }
+            
+            //rebuild the surface vertex lists on the next call (i.e after remeshing)
+            inline void reset() { m_surfaceVertices.clear(); }
+            
             inline unsigned int getNumCollisions() const { return m_sharedList.size(); }
             
             inline auto & getCollisionsObjectA() { return m_objAList; }
@@ -111,8 +213,14 @@ namespace Gauss {
             
         protected:
             
-            Eigen::Vector3x<DataType> m_floorNormal;
-            Eigen::Vector3x<DataType> m_floorPosition;
+            Eigen::Matrix<DataType, 4, Eigen::Dynamic> m_planes;
+            std::vector<Eigen::Vector3x<DataType> > m_planeNormals;
+            
+            //surface vertices of each system (in world order), cached on the first call
+            std::vector<Eigen::VectorXi> m_surfaceVertices;
+            
+            //per thread contact buffers
+            std::vector<std::vector<PlaneContact<DataType> > > m_threadContacts;
             
             //only vertex collisions for now
             MultiVector<ObjectCollisionInfo<DataType, 0> > m_objAList; //collision info for object A
@@ -136,17 +244,49 @@ void Gauss::Collisions::CollisionFloorImpl<DataType>::detectCollisions(World &wo
     MultiVector<Gauss::Collisions::ObjectCollisionInfo<DataType, 0> > &objAList = m_objAList;
     MultiVector<Gauss::Collisions::ObjectCollisionInfo<DataType, 0> > &objBList = m_objBList;
     std::vector<Gauss::Collisions::SharedCollisionInfo<DataType> > &sharedList = m_sharedList;
-    Eigen::Vector3x<DataType> &floorNormal = m_floorNormal;
-    Eigen::Vector3x<DataType> &floorPosition = m_floorPosition;
+    std::vector<Eigen::VectorXi> &surfaceVertices = m_surfaceVertices;
+    std::vector<std::vector<PlaneContact<DataType> > > &threadContacts = m_threadContacts;
+    std::vector<Eigen::Vector3x<DataType> > &planeNormals = m_planeNormals;
+    Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes = m_planes;
+    
+    #ifdef GAUSS_OPENMP
+        threadContacts.resize(omp_thread_count());
+    #else
+        threadContacts.resize(1);
+    #endif
+    
+    bool buildSurface = (m_surfaceVertices.size() == 0);
+    unsigned int objIndex = 0;
     
-    //Loop through every object, check if any points are on the wrong side of the floor, if so
+    //Loop through every object, check if any surface points are on the wrong side of a plane, if so
     //record collision
-    forEachIndex(world.getSystemList(), [&objAList, &objBList, &sharedList, &floorNormal, &floorPosition, &world](auto type, auto index, auto &a) {
-        DetectCollisions<decltype(a->getGeometry())>::planeContact(type, index, a, world.getState(), objAList, objBList, sharedList, floorNormal, floorPosition);
+    forEachIndex(world.getSystemList(), [&](auto type, auto index, auto &a) {
+        
+        using Detector = DetectCollisions<decltype(a->getGeometry())>;
+        
+        if(buildSurface) {
+            surfaceVertices.push_back(Eigen::VectorXi());
+            Detector::surfaceVertices(a, surfaceVertices.back());
+        }
+        
+        for(auto &contacts : threadContacts) {
+            contacts.clear();
+        }
+        
+        Detector::planeContact(a, world.getState(), surfaceVertices[objIndex], planes, threadContacts);
+        
+        //merge
+        for(auto &contacts : threadContacts) {
+            for(auto &contact : contacts) {
+                sharedList.push_back(SharedCollisionInfo<DataType>(planeNormals[contact.plane], contact.position));
+                objAList.add(ObjectCollisionInfo<DataType,0>(sharedList.size()-1, SystemIndex(type,index), contact.vertex));
+                objBList.add(ObjectCollisionInfo<DataType,0>(sharedList.size()-1, SystemIndex(-1,0), contact.plane));
+            }
+        }
+        
+        ++objIndex;
     });
     
-
-    
 }
 
 #endif
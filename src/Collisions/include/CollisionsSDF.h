@@ -0,0 +1,409 @@
+//
+//  CollisionsSDF.h
+//  Gauss
+//
+//  Collisions against static obstacles stored as a signed distance field
+//
+//
+
+#ifndef CollisionsSDF_h
+#define CollisionsSDF_h
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <igl/signed_distance.h>
+#include <GaussIncludes.h>
+#include <UtilitiesContact.h>
+#include <CollisionsFloor.h>
+
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
+
+#ifdef GAUSS_OCTOMAP
+#include <octomap/OcTree.h>
+#include <dynamicEDT3D/dynamicEDTOctomap.h>
+#endif
+
+namespace Gauss {
+    namespace Collisions {
+
+        //Signed distance sampled on a regular grid (negative inside the obstacles). Values live on the grid nodes,
+        //queries are trilinear so distance and gradient cost the same no matter how complex the obstacles are.
+        template<typename DataType>
+        class DistanceField {
+        public:
+
+            DistanceField() : m_spacing(1), m_dims(0,0,0) { m_origin.setZero(); }
+
+            //grid covering [boxMin, boxMax] with node spacing h, values are set to +infinity
+            void resize(const Eigen::Vector3x<DataType> &boxMin, const Eigen::Vector3x<DataType> &boxMax, DataType h) {
+
+                assert(h > 0);
+
+                m_origin = boxMin;
+                m_spacing = h;
+
+                for(unsigned int ii=0; ii<3; ++ii) {
+                    m_dims[ii] = std::max(2, static_cast<int>(std::ceil((boxMax[ii] - boxMin[ii])/h)) + 1);
+                }
+
+                m_values.setConstant(m_dims[0]*m_dims[1]*m_dims[2], std::numeric_limits<DataType>::infinity());
+            }
+
+            //sample phi(x) at every node
+            template<typename Func>
+            void fromFunction(const Eigen::Vector3x<DataType> &boxMin, const Eigen::Vector3x<DataType> &boxMax, DataType h, Func phi) {
+
+                resize(boxMin, boxMax, h);
+
+                #ifdef GAUSS_OPENMP
+                #pragma omp parallel for
+                #endif
+                for(int ii=0; ii<m_values.rows(); ++ii) {
+                    m_values[ii] = phi(node(ii));
+                }
+            }
+
+            //voxelize closed triangle meshes (several obstacles can be concatenated into one V, F), the grid is the bounding box
+            //of the mesh grown by padding. Signs come from the generalized winding number so small holes are tolerated.
+            void fromMesh(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, DataType h, DataType padding) {
+
+                resize(V.colwise().minCoeff().transpose().template cast<DataType>() - Eigen::Vector3x<DataType>::Constant(padding),
+                       V.colwise().maxCoeff().transpose().template cast<DataType>() + Eigen::Vector3x<DataType>::Constant(padding), h);
+
+                Eigen::MatrixXd P(m_values.rows(), 3);
+
+                for(unsigned int ii=0; ii<m_values.rows(); ++ii) {
+                    P.row(ii) = node(ii).transpose().template cast<double>();
+                }
+
+                Eigen::VectorXd S;
+                Eigen::VectorXi I;
+                Eigen::MatrixXd C, N;
+
+                igl::signed_distance(P, V, F, igl::SIGNED_DISTANCE_TYPE_WINDING_NUMBER, S, I, C, N);
+
+                m_values = S.template cast<DataType>();
+            }
+
+#ifdef GAUSS_OCTOMAP
+
+            //Occupied voxels of an octomap (.bt) are the obstacles, dynamicEDT3D computes the distance to them up to maxDistance
+            //(farther nodes are clamped). Voxels have no inside so distances are shifted by half a voxel, occupied nodes end up
+            //at -resolution/2.
+            void fromOctomap(const std::string &filename, DataType maxDistance) {
+
+                octomap::OcTree tree(filename);
+
+                double minX, minY, minZ, maxX, maxY, maxZ;
+                tree.getMetricMin(minX, minY, minZ);
+                tree.getMetricMax(maxX, maxY, maxZ);
+
+                octomap::point3d boxMin(minX, minY, minZ);
+                octomap::point3d boxMax(maxX, maxY, maxZ);
+
+                DynamicEDTOctomap edt(maxDistance, &tree, boxMin, boxMax, false);
+                edt.update();
+
+                DataType h = tree.getResolution();
+                resize(Eigen::Vector3x<DataType>(minX, minY, minZ), Eigen::Vector3x<DataType>(maxX, maxY, maxZ), h);
+
+                for(unsigned int ii=0; ii<m_values.rows(); ++ii) {
+
+                    Eigen::Vector3x<DataType> x = node(ii);
+                    float distance = edt.getDistance(octomap::point3d(x[0], x[1], x[2]));
+
+                    if(distance == DynamicEDTOctomap::distanceValue_Error || distance > maxDistance) {
+                        distance = maxDistance;
+                    }
+
+                    m_values[ii] = distance - 0.5*h;
+                }
+            }
+#endif
+
+            //false if x is outside of the grid (treated as far away from everything), otherwise the interpolated distance
+            //and its gradient
+            inline bool distance(const Eigen::Vector3x<DataType> &x, DataType &phi, Eigen::Vector3x<DataType> &gradient) const {
+
+                int cell[3];
+                DataType t[3];
+
+                for(unsigned int ii=0; ii<3; ++ii) {
+
+                    DataType u = (x[ii] - m_origin[ii])/m_spacing;
+
+                    if(!(u >= 0 && u <= m_dims[ii]-1)) {
+                        return false;
+                    }
+
+                    cell[ii] = std::min(static_cast<int>(u), m_dims[ii]-2);
+                    t[ii] = u - cell[ii];
+                }
+
+                //corner values, c[dx + 2*dy + 4*dz]
+                DataType c[8];
+
+                for(unsigned int kk=0; kk<2; ++kk) {
+                    for(unsigned int jj=0; jj<2; ++jj) {
+                        for(unsigned int ii=0; ii<2; ++ii) {
+                            c[ii + 2*jj + 4*kk] = m_values[index(cell[0]+ii, cell[1]+jj, cell[2]+kk)];
+                        }
+                    }
+                }
+
+                //interpolate along x, then y, then z keeping the partial derivatives
+                DataType c00 = c[0] + t[0]*(c[1] - c[0]);
+                DataType c10 = c[2] + t[0]*(c[3] - c[2]);
+                DataType c01 = c[4] + t[0]*(c[5] - c[4]);
+                DataType c11 = c[6] + t[0]*(c[7] - c[6]);
+
+                DataType c0 = c00 + t[1]*(c10 - c00);
+                DataType c1 = c01 + t[1]*(c11 - c01);
+
+                phi = c0 + t[2]*(c1 - c0);
+
+                DataType dc0 = (1 - t[1])*(c[1] - c[0]) + t[1]*(c[3] - c[2]);
+                DataType dc1 = (1 - t[1])*(c[5] - c[4]) + t[1]*(c[7] - c[6]);
+
+                gradient[0] = ((1 - t[2])*dc0 + t[2]*dc1)/m_spacing;
+                gradient[1] = ((1 - t[2])*(c10 - c00) + t[2]*(c11 - c01))/m_spacing;
+                gradient[2] = (c1 - c0)/m_spacing;
+
+                return true;
+            }
+
+            inline Eigen::Vector3x<DataType> node(unsigned int id) const {
+                int i = id % m_dims[0];
+                int j = (id / m_dims[0]) % m_dims[1];
+                int k = id / (m_dims[0]*m_dims[1]);
+                return m_origin + m_spacing*Eigen::Vector3x<DataType>(i, j, k);
+            }
+
+            inline unsigned int index(int i, int j, int k) const { return i + m_dims[0]*(j + m_dims[1]*k); }
+
+            inline const Eigen::Vector3x<DataType> & getOrigin() const { return m_origin; }
+            inline DataType getSpacing() const { return m_spacing; }
+            inline const Eigen::Vector3i & getDims() const { return m_dims; }
+            inline Eigen::VectorXx<DataType> & getValues() { return m_values; }
+            inline const Eigen::VectorXx<DataType> & getValues() const { return m_values; }
+
+        protected:
+
+            Eigen::Vector3x<DataType> m_origin;
+            DataType m_spacing;
+            Eigen::Vector3i m_dims;
+            Eigen::VectorXx<DataType> m_values;
+
+        private:
+        };
+
+        //a surface vertex closer to the obstacles than the contact distance
+        template<typename DataType>
+        struct FieldContact {
+            unsigned int vertex;
+            Eigen::Vector3x<DataType> normal;
+            Eigen::Vector3x<DataType> position;
+            DataType phi;
+        };
+
+        //Static obstacles as a distance field, built once at construction. Every surface vertex costs one trilinear lookup
+        //per call, contact normals are the normalized field gradient. Vertices within contactDistance of the obstacles
+        //(phi < contactDistance) are reported, 0 only reports penetrating vertices like CollisionFloorImpl. Vertices reported
+        //before they touch may still close their gap within the step (getContactBounds).
+        template<typename DataType>
+        class CollisionSDFImpl {
+
+        public:
+
+            //obstacles from a closed triangle mesh sampled with grid spacing h
+            template<typename World>
+            CollisionSDFImpl(World &world, const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, DataType h, DataType contactDistance = 0) {
+                m_contactDistance = contactDistance;
+                m_dt = 0;
+                m_field.fromMesh(V, F, h, 4*h + contactDistance);
+            }
+
+            //prebuilt field (i.e from DistanceField::fromFunction)
+            template<typename World>
+            CollisionSDFImpl(World &world, const DistanceField<DataType> &field, DataType contactDistance = 0) {
+                m_contactDistance = contactDistance;
+                m_dt = 0;
+                m_field = field;
+            }
+
+#ifdef GAUSS_OCTOMAP
+            //obstacles from an octomap file
+            template<typename World>
+            CollisionSDFImpl(World &world, const std::string &octomapFile, DataType maxDistance, DataType contactDistance = 0) {
+                m_contactDistance = contactDistance;
+                m_dt = 0;
+                m_field.fromOctomap(octomapFile, maxDistance);
+            }
+#endif
+
+            ~CollisionSDFImpl() { }
+
+            template<typename World>
+            void detectCollisions(World &world);
+
+            inline DistanceField<DataType> & getField() { return m_field; }
+            inline const DistanceField<DataType> & getField() const { return m_field; }
+
+            inline void setContactDistance(DataType contactDistance) { m_contactDistance = contactDistance; }
+            inline DataType getContactDistance() const { return m_contactDistance; }
+
+            //the time step of the integrator, TimeStepperEulerImplicitLinearCollisions sets it before every detection
+            inline void setTimeStep(DataType dt) { m_dt = dt; }
+            inline DataType getTimeStep() const { return m_dt; }
+
+            //rebuild the surface vertex lists on the next call (i.e after remeshing)
+            inline void reset() { m_surfaceVertices.clear(); }
+
+            inline unsigned int getNumCollisions() const { return m_sharedList.size(); }
+
+            //signed distance of each contact vertex at detection
+            inline const std::vector<DataType> & getDistances() const { return m_phiList; }
+
+            //lower bound of the normal velocity of each contact row, a vertex outside the obstacles may close its gap in
+            //one step (-phi/dt) and a penetrating one may not sink further (0). All 0 until a time step is set
+            template<typename Vector>
+            inline void getContactBounds(Vector &b) const {
+                if(m_dt <= 0) {
+                    return;
+                }
+
+                for(unsigned int ii=0; ii<m_phiList.size(); ++ii) {
+                    b[ii] = -std::max(m_phiList[ii], static_cast<DataType>(0))/m_dt;
+                }
+            }
+
+            inline auto & getCollisionsObjectA() { return m_objAList; }
+            inline auto & getCollisionsObjectB() { return m_objBList; }
+            inline auto & getSharedInfo() { return m_sharedList; }
+
+            inline const auto & getCollisionsObjectA() const { return m_objAList; }
+            inline const auto & getCollisionsObjectB() const { return m_objBList; }
+            inline const auto & getSharedInfo() const { return m_sharedList; }
+
+        protected:
+
+            DistanceField<DataType> m_field;
+            DataType m_contactDistance, m_dt;
+
+            //surface vertices of each system (in world order), cached on the first call
+            std::vector<Eigen::VectorXi> m_surfaceVertices;
+
+            //per thread contact buffers
+            std::vector<std::vector<FieldContact<DataType> > > m_threadContacts;
+
+            //only vertex collisions for now
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objAList; //collision info for object A
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objBList; //collision info for object B
+            std::vector<SharedCollisionInfo<DataType>> m_sharedList; //normals and world space positions;
+            std::vector<DataType> m_phiList;
+
+        private:
+        };
+    }
+}
+
+template<typename DataType>
+template<typename World>
+void Gauss::Collisions::CollisionSDFImpl<DataType>::detectCollisions(World &world) {
+
+    m_sharedList.clear();
+    m_objAList.clear();
+    m_objBList.clear();
+    m_phiList.clear();
+
+    MultiVector<Gauss::Collisions::ObjectCollisionInfo<DataType, 0> > &objAList = m_objAList;
+    MultiVector<Gauss::Collisions::ObjectCollisionInfo<DataType, 0> > &objBList = m_objBList;
+    std::vector<Gauss::Collisions::SharedCollisionInfo<DataType> > &sharedList = m_sharedList;
+    std::vector<DataType> &phiList = m_phiList;
+    std::vector<Eigen::VectorXi> &surfaceVertices = m_surfaceVertices;
+    std::vector<std::vector<FieldContact<DataType> > > &threadContacts = m_threadContacts;
+    const DistanceField<DataType> &field = m_field;
+    DataType contactDistance = m_contactDistance;
+
+    #ifdef GAUSS_OPENMP
+        threadContacts.resize(omp_thread_count());
+    #else
+        threadContacts.resize(1);
+    #endif
+
+    bool buildSurface = (m_surfaceVertices.size() == 0);
+    unsigned int objIndex = 0;
+
+    forEachIndex(world.getSystemList(), [&](auto type, auto index, auto &a) {
+
+        using Detector = DetectCollisions<decltype(a->getGeometry())>;
+
+        if(buildSurface) {
+            surfaceVertices.push_back(Eigen::VectorXi());
+            Detector::surfaceVertices(a, surfaceVertices.back());
+        }
+
+        for(auto &contacts : threadContacts) {
+            contacts.clear();
+        }
+
+        const Eigen::VectorXi &vertices = surfaceVertices[objIndex];
+
+        //threads own increasing ranges of vertices so merging the buffers in order keeps the serial ordering
+        #ifdef GAUSS_OPENMP
+        #pragma omp parallel
+        #endif
+        {
+            #ifdef GAUSS_OPENMP
+                std::vector<FieldContact<DataType> > &contacts = threadContacts[omp_get_thread_num()];
+            #else
+                std::vector<FieldContact<DataType> > &contacts = threadContacts[0];
+            #endif
+
+            DataType phi;
+            Eigen::Vector3x<DataType> x, gradient;
+
+            #ifdef GAUSS_OPENMP
+            #pragma omp for schedule(static)
+            #endif
+            for(int ii=0; ii<vertices.rows(); ++ii) {
+
+                x = a->getPosition(world.getState(), vertices[ii]);
+
+                if(!field.distance(x, phi, gradient) || phi >= contactDistance) {
+                    continue;
+                }
+
+                //flat spots (i.e the medial axis) have no direction, skip them rather than make up a normal
+                DataType norm = gradient.norm();
+
+                if(norm < 1e-8) {
+                    continue;
+                }
+
+                contacts.push_back(FieldContact<DataType>{static_cast<unsigned int>(vertices[ii]), gradient/norm, x, phi});
+            }
+        }
+
+        //merge
+        for(auto &contacts : threadContacts) {
+            for(auto &contact : contacts) {
+                sharedList.push_back(SharedCollisionInfo<DataType>(contact.normal, contact.position,
+                                                                   std::max(-contact.phi, static_cast<DataType>(0))));
+                phiList.push_back(contact.phi);
+                objAList.add(ObjectCollisionInfo<DataType,0>(sharedList.size()-1, SystemIndex(type,index), contact.vertex));
+                objBList.add(ObjectCollisionInfo<DataType,0>(sharedList.size()-1, SystemIndex(-1,0), 0));
+            }
+        }
+
+        ++objIndex;
+    });
+}
+
+#endif /* CollisionsSDF_h */
@@ -0,0 +1,466 @@
+//
+//  CollisionsSelf.h
+//  Gauss
+//
+//  Self collision detection for deformable bodies using a spatial hash
+//
+//
+
+#ifndef CollisionsSelf_h
+#define CollisionsSelf_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <igl/boundary_facets.h>
+#include <GaussIncludes.h>
+#include <UtilitiesContact.h>
+
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
+
+namespace Gauss {
+    namespace Collisions {
+
+        //Uniform grid of cells hashed into a fixed size table (Teschner et al. 2003), boxes are stored in every cell they overlap.
+        //Hash collisions only add candidates, callers still run exact tests.
+        template<typename DataType>
+        class SpatialHash {
+        public:
+
+            SpatialHash() : m_cellSize(1) { }
+
+            //boxes are stored row wise, the table is rebuilt from scratch
+            void build(const Eigen::MatrixXx<DataType> &boxMin, const Eigen::MatrixXx<DataType> &boxMax, DataType cellSize) {
+
+                assert(cellSize > 0);
+
+                m_cellSize = cellSize;
+                m_offsets.assign(2*boxMin.rows() + 1, 0);
+
+                //count, prefix sum, fill
+                for(unsigned int ii=0; ii<boxMin.rows(); ++ii) {
+                    forEachCell(boxMin.row(ii).transpose(), boxMax.row(ii).transpose(), [this](unsigned int bucket) { ++m_offsets[bucket+1]; });
+                }
+
+                for(unsigned int ii=1; ii<m_offsets.size(); ++ii) {
+                    m_offsets[ii] += m_offsets[ii-1];
+                }
+
+                m_entries.resize(m_offsets.back());
+                std::vector<int> fill(m_offsets.begin(), m_offsets.end()-1);
+
+                for(unsigned int ii=0; ii<boxMin.rows(); ++ii) {
+                    forEachCell(boxMin.row(ii).transpose(), boxMax.row(ii).transpose(), [this, &fill, ii](unsigned int bucket) { m_entries[fill[bucket]++] = ii; });
+                }
+            }
+
+            //ids of every box that shares a bucket with [boxMin, boxMax], sorted and unique
+            inline void query(const Eigen::Vector3x<DataType> &boxMin, const Eigen::Vector3x<DataType> &boxMax, std::vector<int> &candidates) const {
+
+                candidates.clear();
+
+                if(m_entries.size() == 0) {
+                    return;
+                }
+
+                forEachCell(boxMin, boxMax, [this, &candidates](unsigned int bucket) {
+                    candidates.insert(candidates.end(), m_entries.begin() + m_offsets[bucket], m_entries.begin() + m_offsets[bucket+1]);
+                });
+
+                std::sort(candidates.begin(), candidates.end());
+                candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            }
+
+            inline DataType getCellSize() const { return m_cellSize; }
+
+        protected:
+
+            template<typename Func>
+            inline void forEachCell(const Eigen::Vector3x<DataType> &boxMin, const Eigen::Vector3x<DataType> &boxMax, Func func) const {
+
+                int64_t lo[3], hi[3];
+
+                for(unsigned int ii=0; ii<3; ++ii) {
+                    lo[ii] = static_cast<int64_t>(std::floor(boxMin[ii]/m_cellSize));
+                    hi[ii] = static_cast<int64_t>(std::floor(boxMax[ii]/m_cellSize));
+                }
+
+                uint64_t tableSize = m_offsets.size() - 1;
+
+                for(int64_t i=lo[0]; i<=hi[0]; ++i) {
+                    for(int64_t j=lo[1]; j<=hi[1]; ++j) {
+                        for(int64_t k=lo[2]; k<=hi[2]; ++k) {
+                            func(static_cast<unsigned int>((static_cast<uint64_t>(i*73856093) ^ static_cast<uint64_t>(j*19349663) ^ static_cast<uint64_t>(k*83492791)) % tableSize));
+                        }
+                    }
+                }
+            }
+
+            DataType m_cellSize;
+            std::vector<int> m_offsets; //bucket ii holds m_entries[m_offsets[ii]], ..., m_entries[m_offsets[ii+1]-1]
+            std::vector<int> m_entries;
+
+        private:
+        };
+
+        //a vertex pair that is part of a close feature pair, normal points from B towards A
+        template<typename DataType>
+        struct ProximityPair {
+            unsigned int vertexA, vertexB;
+            Eigen::Vector3x<DataType> normal;
+            Eigen::Vector3x<DataType> position;
+        };
+
+        //surface triangles, unique edges and vertices of a vertex/element system (boundary facets for tet meshes)
+        template<typename DataType>
+        struct CollisionSurface {
+            Eigen::VectorXi vertices; //surface vertices
+            Eigen::MatrixXi F; //surface triangles
+            Eigen::MatrixXi E; //unique surface edges
+            DataType cellSize; //average surface edge length at rest
+        };
+
+        template<typename DataType, typename System>
+        void buildCollisionSurface(System *system, CollisionSurface<DataType> &surface);
+
+        //Self contact within each deformable system. Surface triangles and edges are hashed into a grid with cells the size of the
+        //average surface edge, every surface vertex is tested against nearby triangles and every edge against nearby edges
+        //(features sharing a vertex are skipped). Feature pairs closer than the contact thickness become vertex pair constraints,
+        //one for every vertex of one feature paired with every vertex of the other that carries weight at the closest points
+        //(the same vertex-vertex rows CollisionFCLImpl emits). Each vertex pair is reported once, object A holds the smaller vertex id.
+        //thickness = 0 uses 10% of the average surface edge length of each system.
+        template<typename DataType>
+        class CollisionSelfImpl {
+
+        public:
+
+            template<typename World>
+            CollisionSelfImpl(World &world, DataType thickness = 0) {
+                m_thickness = thickness;
+            }
+
+            ~CollisionSelfImpl() { }
+
+            template<typename World>
+            void detectCollisions(World &world);
+
+            inline void setThickness(DataType thickness) { m_thickness = thickness; m_surfaces.clear(); }
+            inline DataType getThickness() const { return m_thickness; }
+
+            //rebuild the surface data on the next call (i.e after remeshing)
+            inline void reset() { m_surfaces.clear(); }
+
+            //applied at the end of detectCollisions, by default it only merges rows shared by neighbouring features
+            inline ContactReduction<DataType> & getContactReduction() { return m_reduction; }
+
+            inline unsigned int getNumCollisions() const { return m_sharedList.size(); }
+
+            inline auto & getCollisionsObjectA() { return m_objAList; }
+            inline auto & getCollisionsObjectB() { return m_objBList; }
+            inline auto & getSharedInfo() { return m_sharedList; }
+
+            inline const auto & getCollisionsObjectA() const { return m_objAList; }
+            inline const auto & getCollisionsObjectB() const { return m_objBList; }
+            inline const auto & getSharedInfo() const { return m_sharedList; }
+
+        protected:
+
+            //per system surface and its contact thickness, built on the first call
+            struct Surface : public CollisionSurface<DataType> {
+                DataType thickness;
+            };
+
+            template<typename System>
+            void detectSelf(System *system, const State<DataType> &state, const Surface &surface);
+
+            DataType m_thickness;
+            std::vector<Surface> m_surfaces;
+
+            SpatialHash<DataType> m_triangleHash, m_edgeHash;
+            Eigen::MatrixXx<DataType> m_X; //current positions, only surface rows are valid
+
+            ContactReduction<DataType> m_reduction;
+
+            //per thread contact buffers
+            std::vector<std::vector<ProximityPair<DataType> > > m_threadContacts;
+
+            //only vertex collisions for now
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objAList; //collision info for object A
+            MultiVector<ObjectCollisionInfo<DataType, 0> > m_objBList; //collision info for object B
+            std::vector<SharedCollisionInfo<DataType>> m_sharedList; //normals and world space positions;
+
+        private:
+        };
+    }
+}
+
+template<typename DataType, typename System>
+void Gauss::Collisions::buildCollisionSurface(System *system, CollisionSurface<DataType> &surface) {
+
+    auto geometry = system->getGeometry();
+
+    if(geometry.second.cols() == 4) {
+        igl::boundary_facets(geometry.second, surface.F);
+    } else {
+        surface.F = geometry.second;
+    }
+
+    //unique edges
+    std::vector<std::pair<int, int> > edges;
+    edges.reserve(3*surface.F.rows());
+
+    for(unsigned int ii=0; ii<surface.F.rows(); ++ii) {
+        for(unsigned int jj=0; jj<3; ++jj) {
+            int v0 = surface.F(ii, jj);
+            int v1 = surface.F(ii, (jj+1)%3);
+            edges.push_back(std::make_pair(std::min(v0, v1), std::max(v0, v1)));
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    surface.E.resize(edges.size(), 2);
+
+    DataType length = 0;
+
+    for(unsigned int ii=0; ii<edges.size(); ++ii) {
+        surface.E(ii,0) = edges[ii].first;
+        surface.E(ii,1) = edges[ii].second;
+        length += (geometry.first.row(edges[ii].first) - geometry.first.row(edges[ii].second)).norm();
+    }
+
+    length = (edges.size() > 0 ? length/edges.size() : static_cast<DataType>(1));
+
+    surface.cellSize = length;
+
+    //surface vertices
+    std::vector<bool> onSurface(geometry.first.rows(), false);
+
+    for(unsigned int ii=0; ii<surface.F.size(); ++ii) {
+        onSurface[surface.F.data()[ii]] = true;
+    }
+
+    std::vector<int> list;
+
+    for(unsigned int iv=0; iv<onSurface.size(); ++iv) {
+        if(onSurface[iv]) {
+            list.push_back(iv);
+        }
+    }
+
+    surface.vertices = Eigen::Map<Eigen::VectorXi>(list.data(), list.size());
+}
+
+template<typename DataType>
+template<typename System>
+void Gauss::Collisions::CollisionSelfImpl<DataType>::detectSelf(System *system, const State<DataType> &state, const Surface &surface) {
+
+    const Eigen::VectorXi &vertices = surface.vertices;
+    const Eigen::MatrixXi &F = surface.F;
+    const Eigen::MatrixXi &E = surface.E;
+    const DataType d = surface.thickness;
+
+    Eigen::MatrixXx<DataType> &X = m_X;
+    std::vector<std::vector<ProximityPair<DataType> > > &threadContacts = m_threadContacts;
+    SpatialHash<DataType> &triangleHash = m_triangleHash;
+    SpatialHash<DataType> &edgeHash = m_edgeHash;
+
+    X.resize(system->getGeometry().first.rows(), 3);
+
+    Eigen::MatrixXx<DataType> triMin(F.rows(), 3), triMax(F.rows(), 3);
+    Eigen::MatrixXx<DataType> edgeMin(E.rows(), 3), edgeMax(E.rows(), 3);
+
+    //positions and feature boxes grown by the thickness
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<vertices.rows(); ++ii) {
+            X.row(vertices[ii]) = system->getPosition(state, vertices[ii]).transpose();
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<F.rows(); ++ii) {
+            triMin.row(ii) = X.row(F(ii,0)).cwiseMin(X.row(F(ii,1))).cwiseMin(X.row(F(ii,2))).array() - d;
+            triMax.row(ii) = X.row(F(ii,0)).cwiseMax(X.row(F(ii,1))).cwiseMax(X.row(F(ii,2))).array() + d;
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<E.rows(); ++ii) {
+            edgeMin.row(ii) = X.row(E(ii,0)).cwiseMin(X.row(E(ii,1))).array() - d;
+            edgeMax.row(ii) = X.row(E(ii,0)).cwiseMax(X.row(E(ii,1))).array() + d;
+        }
+    }
+
+    triangleHash.build(triMin, triMax, surface.cellSize);
+    edgeHash.build(edgeMin, edgeMax, surface.cellSize);
+
+    for(auto &contacts : threadContacts) {
+        contacts.clear();
+    }
+
+    //threads own increasing ranges (static schedule) so the buffers merge in serial order,
+    //vertex-triangle pairs come before edge-edge pairs within each buffer
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+            std::vector<ProximityPair<DataType> > &contacts = threadContacts[omp_get_thread_num()];
+        #else
+            std::vector<ProximityPair<DataType> > &contacts = threadContacts[0];
+        #endif
+
+        std::vector<int> candidates;
+        Eigen::Vector3x<DataType> w;
+
+        //vertex-triangle
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ii=0; ii<vertices.rows(); ++ii) {
+
+            int iv = vertices[ii];
+            Eigen::Vector3x<DataType> x = X.row(iv).transpose();
+
+            triangleHash.query(x.array() - d, x.array() + d, candidates);
+
+            for(int it : candidates) {
+
+                if(F(it,0) == iv || F(it,1) == iv || F(it,2) == iv) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> a = X.row(F(it,0)).transpose();
+                Eigen::Vector3x<DataType> b = X.row(F(it,1)).transpose();
+                Eigen::Vector3x<DataType> c = X.row(F(it,2)).transpose();
+
+                Eigen::Vector3x<DataType> p = closestPointTriangle<DataType>(x, a, b, c, w);
+                Eigen::Vector3x<DataType> n = x - p;
+                DataType distance = n.norm();
+
+                if(distance >= d) {
+                    continue;
+                }
+
+                //touching, fall back to the face normal
+                if(distance > std::numeric_limits<DataType>::epsilon()*surface.cellSize) {
+                    n /= distance;
+                } else {
+                    n = (b - a).cross(c - a).normalized();
+                }
+
+                for(unsigned int jj=0; jj<3; ++jj) {
+                    if(w[jj] > 0) {
+                        contacts.push_back(ProximityPair<DataType>{static_cast<unsigned int>(iv), static_cast<unsigned int>(F(it,jj)), n, p});
+                    }
+                }
+            }
+        }
+
+        //edge-edge, each pair once (ie < je), pairs with a closest point at an end point are vertex-triangle cases
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ie=0; ie<E.rows(); ++ie) {
+
+            Eigen::Vector3x<DataType> p0 = X.row(E(ie,0)).transpose();
+            Eigen::Vector3x<DataType> p1 = X.row(E(ie,1)).transpose();
+
+            edgeHash.query(edgeMin.row(ie).transpose(), edgeMax.row(ie).transpose(), candidates);
+
+            for(int je : candidates) {
+
+                if(je <= ie || E(je,0) == E(ie,0) || E(je,0) == E(ie,1) || E(je,1) == E(ie,0) || E(je,1) == E(ie,1)) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> q0 = X.row(E(je,0)).transpose();
+                Eigen::Vector3x<DataType> q1 = X.row(E(je,1)).transpose();
+
+                DataType s, t;
+                DataType distance2 = closestPointsSegments<DataType>(p0, p1, q0, q1, s, t);
+
+                if(distance2 >= d*d || s <= 0 || s >= 1 || t <= 0 || t >= 1) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> pa = p0 + s*(p1 - p0);
+                Eigen::Vector3x<DataType> n = pa - (q0 + t*(q1 - q0));
+                DataType distance = std::sqrt(distance2);
+
+                if(distance <= std::numeric_limits<DataType>::epsilon()*surface.cellSize) {
+                    continue;
+                }
+
+                n /= distance;
+
+                for(unsigned int jj=0; jj<2; ++jj) {
+                    for(unsigned int kk=0; kk<2; ++kk) {
+                        contacts.push_back(ProximityPair<DataType>{static_cast<unsigned int>(E(ie,jj)), static_cast<unsigned int>(E(je,kk)), n, pa});
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename DataType>
+template<typename World>
+void Gauss::Collisions::CollisionSelfImpl<DataType>::detectCollisions(World &world) {
+
+    m_sharedList.clear();
+    m_objAList.clear();
+    m_objBList.clear();
+
+    #ifdef GAUSS_OPENMP
+        m_threadContacts.resize(omp_thread_count());
+    #else
+        m_threadContacts.resize(1);
+    #endif
+
+    bool buildSurfaces = (m_surfaces.size() == 0);
+    unsigned int objIndex = 0;
+
+    forEachIndex(world.getSystemList(), [&](auto type, auto index, auto &a) {
+
+        if(buildSurfaces) {
+            m_surfaces.push_back(Surface());
+            buildCollisionSurface<DataType>(a, m_surfaces.back());
+            m_surfaces.back().thickness = (m_thickness > 0 ? m_thickness : static_cast<DataType>(0.1)*m_surfaces.back().cellSize);
+        }
+
+        detectSelf(a, world.getState(), m_surfaces[objIndex]);
+
+        //merge, rows are stored as (smaller, larger) vertex id with the normal flipped to match so a vertex pair found from
+        //both sides (i.e vertex-triangle in both directions) ends up as a single row after the reduction
+        for(auto &contacts : m_threadContacts) {
+            for(auto &contact : contacts) {
+
+                bool flip = (contact.vertexA > contact.vertexB);
+
+                m_sharedList.push_back(SharedCollisionInfo<DataType>(flip ? Eigen::Vector3x<DataType>(-contact.normal) : contact.normal, contact.position));
+                m_objAList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, SystemIndex(type,index), flip ? contact.vertexB : contact.vertexA));
+                m_objBList.add(ObjectCollisionInfo<DataType,0>(m_sharedList.size()-1, SystemIndex(type,index), flip ? contact.vertexA : contact.vertexB));
+            }
+        }
+
+        ++objIndex;
+    });
+
+    m_reduction.reduce(m_objAList, m_objBList, m_sharedList);
+}
+
+#endif /* CollisionsSelf_h */
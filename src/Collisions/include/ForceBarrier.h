@@ -0,0 +1,639 @@
+//
+//  ForceBarrier.h
+//  Gauss
+//
+//  Smooth log barrier contact forces (incremental potential contact, Li et al. 2020)
+//
+//
+
+#ifndef ForceBarrier_h
+#define ForceBarrier_h
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <ForceExternal.h>
+#include <GaussIncludes.h>
+#include <UtilitiesContact.h>
+#include <CollisionsSelf.h>
+
+#ifdef GAUSS_OPENMP
+#include <omp.h>
+#include <UtilitiesOMP.h>
+#endif
+
+namespace Gauss {
+    namespace Collisions {
+
+        //Contact as a potential instead of a constraint. Every surface primitive pair closer than dHat (vertex-triangle, edge-edge,
+        //vertex-plane, between and within systems, pairs sharing a vertex are skipped) adds
+        //  b(d) = -kappa*(d - dHat)^2*log(d/dHat)
+        //which is zero at dHat, smooth and infinite at contact so the Newton stepper keeps everything apart with no active set.
+        //Nearby pairs come from a spatial hash of the surface primitives, the stiffness matrix uses b''(d)*grad(d)*grad(d)'
+        //(the positive semi-definite part of the barrier Hessian). It is exact for vertex-plane pairs, for vertex-triangle and
+        //edge-edge pairs it is a Gauss-Newton approximation that drops b'(d)*hess(d). The barrier is only finite along intersection free paths,
+        //steppers have to bound their steps with getStepBound (see TimeStepperEulerImplicit).
+        //dHat = 0 uses 10% of the average surface edge length. All systems must have the same type.
+        template<typename DataType, typename System>
+        class ForceBarrierImpl
+        {
+        public:
+
+            ForceBarrierImpl(System *system, DataType dHat = 0, DataType kappa = 1e3) {
+                m_systems.push_back(system);
+                m_dHat = dHat;
+                m_kappa = kappa;
+            }
+
+            //barrier between this system, the systems already added and the planes as well as within the system itself
+            template<typename OtherSystem>
+            inline void addSystem(OtherSystem *system) {
+                static_assert(std::is_same<OtherSystem, System>::value, "ForceBarrier: all systems must have the same type");
+                m_systems.push_back(system);
+                reset();
+            }
+
+            //the normal points to the allowed side of the plane
+            inline void addPlane(const Eigen::Vector3x<DataType> &normal, const Eigen::Vector3x<DataType> &position) {
+                m_planes.conservativeResize(4, m_planes.cols()+1);
+                m_planes.template block<3,1>(0, m_planes.cols()-1) = normal.normalized();
+                m_planes(3, m_planes.cols()-1) = -normal.normalized().dot(position);
+                m_X.resize(0,3);
+            }
+
+            inline void setDHat(DataType dHat) { m_dHat = dHat; reset(); }
+            inline DataType getDHat() const { return (m_surfaces.size() > 0 ? m_sceneDHat : m_dHat); }
+
+            inline void setStiffness(DataType kappa) { m_kappa = kappa; }
+            inline DataType getStiffness() const { return m_kappa; }
+
+            //rebuild the surface data on the next call (i.e after remeshing)
+            inline void reset() { m_surfaces.clear(); m_X.resize(0,3); }
+
+            //forces can give you the energy stored, the force itself and the hessian
+            inline DataType getEnergy(State<DataType> &state) {
+
+                update(state);
+
+                DataType energy = 0;
+                for(auto &pair : m_pairs) {
+                    if(pair.distance <= 0) {
+                        return std::numeric_limits<DataType>::infinity();
+                    }
+
+                    energy += barrier(pair.distance);
+                }
+
+                return energy;
+            }
+
+            //forces always act on at least one DOF of the system this function returns which DOF the are acting on.
+            inline auto & getDOF(unsigned int index) {
+                return m_systems[index]->getQ();
+            }
+
+            inline unsigned int getNumDOF() { return m_systems.size(); }
+
+            template <typename Vector>
+            inline void getForce(Vector &f, State<DataType> &state) {
+
+                update(state);
+
+                for(auto &pair : m_pairs) {
+
+                    if(pair.distance <= 0) {
+                        continue;
+                    }
+
+                    DataType db = barrierGradient(pair.distance);
+
+                    if(pair.numVertices == 1) {
+                        Eigen::Vector3x<DataType> fPair = -db*pair.gradient.template head<3>();
+                        assign(f, fPair, std::array<const DOFBase<DataType,0> *, 1>{{dof(pair.vertices[0])}});
+                    } else {
+                        Eigen::Matrix<DataType, 12, 1> fPair = -db*pair.gradient;
+                        assign(f, fPair, dofs(pair));
+                    }
+                }
+            }
+
+            template <typename Matrix>
+            inline void getStiffnessMatrix(Matrix &H, State<DataType> &state) {
+
+                update(state);
+
+                for(auto &pair : m_pairs) {
+
+                    if(pair.distance <= 0) {
+                        continue;
+                    }
+
+                    DataType ddb = barrierHessian(pair.distance);
+
+                    if(pair.numVertices == 1) {
+                        Eigen::Matrix<DataType, 3, 3> KPair = -ddb*pair.gradient.template head<3>()*pair.gradient.template head<3>().transpose();
+                        std::array<const DOFBase<DataType,0> *, 1> pairDOFs = {{dof(pair.vertices[0])}};
+                        assign(H, KPair, pairDOFs, pairDOFs);
+                    } else {
+                        Eigen::Matrix<DataType, 12, 12> KPair = -ddb*pair.gradient*pair.gradient.transpose();
+                        std::array<const DOFBase<DataType,0> *, 4> pairDOFs = dofs(pair);
+                        assign(H, KPair, pairDOFs, pairDOFs);
+                    }
+                }
+            }
+
+            //largest fraction (at most 1) of the position change dq (a world sized vector) that keeps every primitive pair apart,
+            //starting from the positions in state. Vertices move linearly, the first time of impact comes from the coplanarity
+            //times of each vertex-triangle and edge-edge pair, 80% of it is returned so the barrier stays finite.
+            DataType getStepBound(const State<DataType> &state, const Eigen::VectorXx<DataType> &dq);
+
+            //number of primitive pairs inside the barrier at the last evaluated state
+            inline unsigned int getNumActivePairs() const { return m_pairs.size(); }
+
+        protected:
+
+            //vertex-plane (vertices[1] = plane), vertex-triangle or edge-edge, gradient holds the gradient of the distance with respect
+            //to the positions of the involved vertices
+            struct BarrierPair {
+                std::array<int, 4> vertices;
+                unsigned int numVertices;
+                DataType distance;
+                Eigen::Matrix<DataType, 12, 1> gradient;
+            };
+
+            inline DataType barrier(DataType d) const {
+                return -m_kappa*(d - m_sceneDHat)*(d - m_sceneDHat)*std::log(d/m_sceneDHat);
+            }
+
+            inline DataType barrierGradient(DataType d) const {
+                return -m_kappa*(d - m_sceneDHat)*(2*std::log(d/m_sceneDHat) + (d - m_sceneDHat)/d);
+            }
+
+            inline DataType barrierHessian(DataType d) const {
+                DataType r = (d - m_sceneDHat)/d;
+                return -m_kappa*(2*std::log(d/m_sceneDHat) + 4*r - r*r);
+            }
+
+            inline const DOFBase<DataType,0> * dof(int vertex) const {
+                unsigned int system = m_vertexSystem[vertex];
+                unsigned int vertexId = vertex - m_offsets[system];
+                return m_systems[system]->getQ(vertexId)[0];
+            }
+
+            inline std::array<const DOFBase<DataType,0> *, 4> dofs(const BarrierPair &pair) const {
+                return std::array<const DOFBase<DataType,0> *, 4>{{dof(pair.vertices[0]), dof(pair.vertices[1]), dof(pair.vertices[2]), dof(pair.vertices[3])}};
+            }
+
+            void buildScene();
+
+            //gather surface positions and find the pairs inside the barrier, nothing happens if the positions did not change
+            void update(const State<DataType> &state);
+
+            DataType m_dHat, m_sceneDHat, m_kappa, m_cellSize;
+            Eigen::Matrix<DataType, 4, Eigen::Dynamic> m_planes;
+
+            std::vector<System *> m_systems;
+
+            //per system surfaces, merged into one scene with global vertex ids (system offsets in m_offsets)
+            std::vector<CollisionSurface<DataType> > m_surfaces;
+            std::vector<int> m_offsets, m_vertexSystem;
+            Eigen::VectorXi m_vertices;
+            Eigen::MatrixXi m_F, m_E;
+
+            //positions the pairs were computed for, only surface rows are valid
+            Eigen::MatrixXx<DataType> m_X;
+
+            SpatialHash<DataType> m_triangleHash, m_edgeHash;
+
+            //per thread pair buffers, merged into m_pairs
+            std::vector<std::vector<BarrierPair, Eigen::aligned_allocator<BarrierPair> > > m_threadPairs;
+            std::vector<BarrierPair, Eigen::aligned_allocator<BarrierPair> > m_pairs;
+
+        private:
+        };
+
+        template<typename DataType, typename System>
+        using ForceBarrier = Force<DataType, ForceBarrierImpl<DataType, System> >;
+    }
+}
+
+template<typename DataType, typename System>
+void Gauss::Collisions::ForceBarrierImpl<DataType, System>::buildScene() {
+
+    std::vector<int> vertices;
+    int numF = 0, numE = 0;
+
+    m_surfaces.clear();
+    m_offsets.assign(1, 0);
+    m_cellSize = 0;
+
+    for(auto system : m_systems) {
+        m_surfaces.push_back(CollisionSurface<DataType>());
+        buildCollisionSurface<DataType>(system, m_surfaces.back());
+        m_offsets.push_back(m_offsets.back() + system->getGeometry().first.rows());
+
+        numF += m_surfaces.back().F.rows();
+        numE += m_surfaces.back().E.rows();
+        m_cellSize += m_surfaces.back().cellSize;
+    }
+
+    m_cellSize = (m_surfaces.size() > 0 ? m_cellSize/m_surfaces.size() : static_cast<DataType>(1));
+    m_sceneDHat = (m_dHat > 0 ? m_dHat : static_cast<DataType>(0.1)*m_cellSize);
+
+    m_F.resize(numF, 3);
+    m_E.resize(numE, 2);
+    m_vertexSystem.assign(m_offsets.back(), -1);
+
+    numF = 0;
+    numE = 0;
+
+    for(unsigned int ii=0; ii<m_surfaces.size(); ++ii) {
+
+        auto &surface = m_surfaces[ii];
+
+        m_F.block(numF, 0, surface.F.rows(), 3) = surface.F.array() + m_offsets[ii];
+        m_E.block(numE, 0, surface.E.rows(), 2) = surface.E.array() + m_offsets[ii];
+
+        numF += surface.F.rows();
+        numE += surface.E.rows();
+
+        for(unsigned int jj=0; jj<surface.vertices.rows(); ++jj) {
+            vertices.push_back(surface.vertices[jj] + m_offsets[ii]);
+            m_vertexSystem[vertices.back()] = ii;
+        }
+    }
+
+    m_vertices = Eigen::Map<Eigen::VectorXi>(vertices.data(), vertices.size());
+}
+
+template<typename DataType, typename System>
+void Gauss::Collisions::ForceBarrierImpl<DataType, System>::update(const State<DataType> &state) {
+
+    if(m_surfaces.size() == 0) {
+        buildScene();
+    }
+
+    Eigen::MatrixXx<DataType> X(m_offsets.back(), 3);
+
+    for(unsigned int ii=0; ii<m_systems.size(); ++ii) {
+
+        const Eigen::VectorXi &surfaceVertices = m_surfaces[ii].vertices;
+        System *system = m_systems[ii];
+        int offset = m_offsets[ii];
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp parallel for
+        #endif
+        for(int jj=0; jj<surfaceVertices.rows(); ++jj) {
+            X.row(offset + surfaceVertices[jj]) = system->getPosition(state, surfaceVertices[jj]).transpose();
+        }
+    }
+
+    //energy, force and stiffness evaluations at the same state share the pairs
+    bool same = (X.rows() == m_X.rows());
+    for(unsigned int ii=0; same && ii<m_vertices.rows(); ++ii) {
+        same = (X.row(m_vertices[ii]) == m_X.row(m_vertices[ii]));
+    }
+
+    if(same) {
+        return;
+    }
+
+    m_X = X;
+
+    const Eigen::VectorXi &vertices = m_vertices;
+    const Eigen::MatrixXi &F = m_F;
+    const Eigen::MatrixXi &E = m_E;
+    const Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes = m_planes;
+    const DataType dHat = m_sceneDHat;
+
+    auto &threadPairs = m_threadPairs;
+    SpatialHash<DataType> &triangleHash = m_triangleHash;
+    SpatialHash<DataType> &edgeHash = m_edgeHash;
+
+    Eigen::MatrixXx<DataType> triMin(F.rows(), 3), triMax(F.rows(), 3);
+    Eigen::MatrixXx<DataType> edgeMin(E.rows(), 3), edgeMax(E.rows(), 3);
+
+    #ifdef GAUSS_OPENMP
+        threadPairs.resize(omp_thread_count());
+    #else
+        threadPairs.resize(1);
+    #endif
+
+    for(auto &pairs : threadPairs) {
+        pairs.clear();
+    }
+
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<F.rows(); ++ii) {
+            triMin.row(ii) = X.row(F(ii,0)).cwiseMin(X.row(F(ii,1))).cwiseMin(X.row(F(ii,2)));
+            triMax.row(ii) = X.row(F(ii,0)).cwiseMax(X.row(F(ii,1))).cwiseMax(X.row(F(ii,2)));
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<E.rows(); ++ii) {
+            edgeMin.row(ii) = X.row(E(ii,0)).cwiseMin(X.row(E(ii,1)));
+            edgeMax.row(ii) = X.row(E(ii,0)).cwiseMax(X.row(E(ii,1)));
+        }
+    }
+
+    triangleHash.build(triMin, triMax, m_cellSize);
+    edgeHash.build(edgeMin, edgeMax, m_cellSize);
+
+    //threads own increasing ranges (static schedule) so the buffers merge in serial order
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+            auto &pairs = threadPairs[omp_get_thread_num()];
+        #else
+            auto &pairs = threadPairs[0];
+        #endif
+
+        std::vector<int> candidates;
+
+        //vertex-plane and vertex-triangle
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ii=0; ii<vertices.rows(); ++ii) {
+
+            int iv = vertices[ii];
+            Eigen::Vector3x<DataType> x = X.row(iv).transpose();
+
+            for(int jj=0; jj<planes.cols(); ++jj) {
+
+                DataType distance = planes.template block<3,1>(0,jj).dot(x) + planes(3,jj);
+
+                if(distance < dHat) {
+                    BarrierPair pair;
+                    pair.vertices = {{iv, jj, -1, -1}};
+                    pair.numVertices = 1;
+                    pair.distance = distance;
+                    pair.gradient.setZero();
+                    pair.gradient.template head<3>() = planes.template block<3,1>(0,jj);
+                    pairs.push_back(pair);
+                }
+            }
+
+            triangleHash.query(x.array() - dHat, x.array() + dHat, candidates);
+
+            for(int it : candidates) {
+
+                if(F(it,0) == iv || F(it,1) == iv || F(it,2) == iv) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> w;
+                Eigen::Vector3x<DataType> p = closestPointTriangle<DataType>(x, X.row(F(it,0)).transpose(), X.row(F(it,1)).transpose(), X.row(F(it,2)).transpose(), w);
+                Eigen::Vector3x<DataType> n = x - p;
+                DataType distance = n.norm();
+
+                if(distance >= dHat) {
+                    continue;
+                }
+
+                //closest point held fixed, this is the exact gradient (envelope theorem)
+                n = (distance > 0 ? (n/distance).eval() : Eigen::Vector3x<DataType>::Zero());
+
+                BarrierPair pair;
+                pair.vertices = {{iv, F(it,0), F(it,1), F(it,2)}};
+                pair.numVertices = 4;
+                pair.distance = distance;
+                pair.gradient << n, -w[0]*n, -w[1]*n, -w[2]*n;
+                pairs.push_back(pair);
+            }
+        }
+
+        //edge-edge against edges with a larger index
+        #ifdef GAUSS_OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int ie=0; ie<E.rows(); ++ie) {
+
+            Eigen::Vector3x<DataType> p0 = X.row(E(ie,0)).transpose(), p1 = X.row(E(ie,1)).transpose();
+
+            edgeHash.query(edgeMin.row(ie).transpose().array() - dHat, edgeMax.row(ie).transpose().array() + dHat, candidates);
+
+            for(int je : candidates) {
+
+                if(je <= ie || E(je,0) == E(ie,0) || E(je,0) == E(ie,1) || E(je,1) == E(ie,0) || E(je,1) == E(ie,1)) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> q0 = X.row(E(je,0)).transpose(), q1 = X.row(E(je,1)).transpose();
+
+                DataType s, t;
+                DataType distance2 = closestPointsSegments<DataType>(p0, p1, q0, q1, s, t);
+
+                if(distance2 >= dHat*dHat) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> n = (p0 + s*(p1 - p0)) - (q0 + t*(q1 - q0));
+                DataType distance = std::sqrt(distance2);
+                n = (distance > 0 ? (n/distance).eval() : Eigen::Vector3x<DataType>::Zero());
+
+                BarrierPair pair;
+                pair.vertices = {{E(ie,0), E(ie,1), E(je,0), E(je,1)}};
+                pair.numVertices = 4;
+                pair.distance = distance;
+                pair.gradient << (1 - s)*n, s*n, -(1 - t)*n, -t*n;
+                pairs.push_back(pair);
+            }
+        }
+    }
+
+    m_pairs.clear();
+
+    for(auto &pairs : threadPairs) {
+        m_pairs.insert(m_pairs.end(), pairs.begin(), pairs.end());
+    }
+}
+
+template<typename DataType, typename System>
+DataType Gauss::Collisions::ForceBarrierImpl<DataType, System>::getStepBound(const State<DataType> &state, const Eigen::VectorXx<DataType> &dq) {
+
+    update(state);
+
+    const Eigen::VectorXi &vertices = m_vertices;
+    const Eigen::MatrixXi &F = m_F;
+    const Eigen::MatrixXi &E = m_E;
+    const Eigen::Matrix<DataType, 4, Eigen::Dynamic> &planes = m_planes;
+    const Eigen::MatrixXx<DataType> &X0 = m_X;
+
+    //anything closer than this at a coplanarity time counts as an impact
+    const DataType tol = static_cast<DataType>(1e-3)*m_sceneDHat;
+
+    //end of step positions
+    Eigen::MatrixXx<DataType> X1 = X0;
+
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel for
+    #endif
+    for(int ii=0; ii<vertices.rows(); ++ii) {
+        X1.row(vertices[ii]) += dq.template segment<3>(dof(vertices[ii])->getGlobalId()).transpose();
+    }
+
+    Eigen::MatrixXx<DataType> triMin(F.rows(), 3), triMax(F.rows(), 3);
+    Eigen::MatrixXx<DataType> edgeMin(E.rows(), 3), edgeMax(E.rows(), 3);
+
+    //swept boxes
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<F.rows(); ++ii) {
+            triMin.row(ii) = X0.row(F(ii,0)).cwiseMin(X0.row(F(ii,1))).cwiseMin(X0.row(F(ii,2))).cwiseMin(
+                             X1.row(F(ii,0)).cwiseMin(X1.row(F(ii,1))).cwiseMin(X1.row(F(ii,2)))).array() - tol;
+            triMax.row(ii) = X0.row(F(ii,0)).cwiseMax(X0.row(F(ii,1))).cwiseMax(X0.row(F(ii,2))).cwiseMax(
+                             X1.row(F(ii,0)).cwiseMax(X1.row(F(ii,1))).cwiseMax(X1.row(F(ii,2)))).array() + tol;
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<E.rows(); ++ii) {
+            edgeMin.row(ii) = X0.row(E(ii,0)).cwiseMin(X0.row(E(ii,1))).cwiseMin(X1.row(E(ii,0)).cwiseMin(X1.row(E(ii,1)))).array() - tol;
+            edgeMax.row(ii) = X0.row(E(ii,0)).cwiseMax(X0.row(E(ii,1))).cwiseMax(X1.row(E(ii,0)).cwiseMax(X1.row(E(ii,1)))).array() + tol;
+        }
+    }
+
+    SpatialHash<DataType> &triangleHash = m_triangleHash;
+    SpatialHash<DataType> &edgeHash = m_edgeHash;
+
+    triangleHash.build(triMin, triMax, m_cellSize);
+    edgeHash.build(edgeMin, edgeMax, m_cellSize);
+
+    auto overlap = [](const auto &minA, const auto &maxA, const auto &minB, const auto &maxB) {
+        return (minA.array() <= maxB.array()).all() && (minB.array() <= maxA.array()).all();
+    };
+
+    //impacts after the step don't count
+    DataType toi = 2;
+
+    #ifdef GAUSS_OPENMP
+    #pragma omp parallel reduction(min:toi)
+    #endif
+    {
+        std::vector<int> candidates;
+        std::vector<DataType> times;
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ii=0; ii<vertices.rows(); ++ii) {
+
+            int iv = vertices[ii];
+            Eigen::Vector3x<DataType> x0 = X0.row(iv).transpose();
+            Eigen::Vector3x<DataType> x1 = X1.row(iv).transpose();
+
+            for(int jj=0; jj<planes.cols(); ++jj) {
+
+                DataType d0 = planes.template block<3,1>(0,jj).dot(x0) + planes(3,jj);
+                DataType d1 = planes.template block<3,1>(0,jj).dot(x1) + planes(3,jj);
+
+                if(d1 <= 0) {
+                    toi = std::min(toi, d0/(d0 - d1));
+                }
+            }
+
+            Eigen::Vector3x<DataType> boxMin = x0.cwiseMin(x1).array() - tol;
+            Eigen::Vector3x<DataType> boxMax = x0.cwiseMax(x1).array() + tol;
+
+            triangleHash.query(boxMin, boxMax, candidates);
+
+            for(int it : candidates) {
+
+                if(F(it,0) == iv || F(it,1) == iv || F(it,2) == iv || !overlap(boxMin.transpose(), boxMax.transpose(), triMin.row(it), triMax.row(it))) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> a0 = X0.row(F(it,0)).transpose(), a1 = X1.row(F(it,0)).transpose();
+                Eigen::Vector3x<DataType> b0 = X0.row(F(it,1)).transpose(), b1 = X1.row(F(it,1)).transpose();
+                Eigen::Vector3x<DataType> c0 = X0.row(F(it,2)).transpose(), c1 = X1.row(F(it,2)).transpose();
+
+                coplanarityTimes<DataType>(a0, b0, c0, x0, a1, b1, c1, x1, times);
+                times.push_back(1);
+
+                for(DataType t : times) {
+
+                    if(t >= toi) {
+                        break;
+                    }
+
+                    Eigen::Vector3x<DataType> w;
+                    Eigen::Vector3x<DataType> x = x0 + t*(x1 - x0);
+                    Eigen::Vector3x<DataType> p = closestPointTriangle<DataType>(x, a0 + t*(a1 - a0), b0 + t*(b1 - b0), c0 + t*(c1 - c0), w);
+
+                    if((x - p).norm() < tol) {
+                        toi = t;
+                        break;
+                    }
+                }
+            }
+        }
+
+        #ifdef GAUSS_OPENMP
+        #pragma omp for
+        #endif
+        for(int ie=0; ie<E.rows(); ++ie) {
+
+            Eigen::Vector3x<DataType> p00 = X0.row(E(ie,0)).transpose(), p01 = X1.row(E(ie,0)).transpose();
+            Eigen::Vector3x<DataType> p10 = X0.row(E(ie,1)).transpose(), p11 = X1.row(E(ie,1)).transpose();
+
+            edgeHash.query(edgeMin.row(ie).transpose(), edgeMax.row(ie).transpose(), candidates);
+
+            for(int je : candidates) {
+
+                if(je <= ie || E(je,0) == E(ie,0) || E(je,0) == E(ie,1) || E(je,1) == E(ie,0) || E(je,1) == E(ie,1) ||
+                   !overlap(edgeMin.row(ie), edgeMax.row(ie), edgeMin.row(je), edgeMax.row(je))) {
+                    continue;
+                }
+
+                Eigen::Vector3x<DataType> q00 = X0.row(E(je,0)).transpose(), q01 = X1.row(E(je,0)).transpose();
+                Eigen::Vector3x<DataType> q10 = X0.row(E(je,1)).transpose(), q11 = X1.row(E(je,1)).transpose();
+
+                coplanarityTimes<DataType>(p00, p10, q00, q10, p01, p11, q01, q11, times);
+                times.push_back(1);
+
+                for(DataType t : times) {
+
+                    if(t >= toi) {
+                        break;
+                    }
+
+                    DataType s, r;
+                    DataType distance2 = closestPointsSegments<DataType>(p00 + t*(p01 - p00), p10 + t*(p11 - p10), q00 + t*(q01 - q00), q10 + t*(q11 - q10), s, r);
+
+                    if(distance2 < tol*tol) {
+                        toi = t;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    //the hashes now hold swept boxes, the next update has to rebuild them
+    m_X.resize(0,3);
+
+    return (toi <= 1 ? static_cast<DataType>(0.8)*toi : static_cast<DataType>(1));
+}
+
+#endif /* ForceBarrier_h */
@@ -0,0 +1,207 @@
+//
+//  SolverContactQP.h
+//  Gauss
+//
+//  Native sparse QP solver for contact that only needs solves with an already factored system matrix.
+//
+//
+
+#ifndef SolverContactQP_h
+#define SolverContactQP_h
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <UtilitiesEigen.h>
+
+namespace Gauss {
+    namespace Collisions {
+
+        //Solves  min 0.5*x'*A*x - b'*x  s.t.  J(0:numEq)*x = d(0:numEq),  J(numEq:end)*x >= d(numEq:end)
+        //through its dual. With x0 = inv(A)*b and x = x0 + inv(A)*J'*lambda the dual is the bound constrained QP
+        //  min 0.5*lambda'*S*lambda + q'*lambda,  S = J*inv(A)*J',  q = J*x0 - d,  lambda(numEq:end) >= 0
+        //whose gradient w = S*lambda + q is the constraint residual (same problem as solveSchurComplementLCP).
+        //S is never formed, every iteration costs one solve with the factors of A plus two sparse products with J, so this
+        //scales to many contacts where the dense Schur complement does not.
+        //The dual is solved by accelerated projected gradient descent (Nesterov with gradient restart and backtracking on the
+        //step size, Mazhar et al. 2015) in the metric of an approximate diagonal of S, J*diag(A)^-1*J'. lambda is used as the
+        //initial guess (warm start) and the step size estimate carries over between calls.
+        template<typename DataType>
+        class SolverContactQP {
+        public:
+
+            //tol - largest allowed constraint residual (violation, or separation of a row with a nonzero multiplier),
+            //      same units as J*x
+            SolverContactQP(unsigned int maxIter = 1000, DataType tol = 1e-6) {
+                m_maxIter = maxIter;
+                m_tol = tol;
+                m_L = 1;
+                m_numIterations = 0;
+                m_residual = 0;
+            }
+
+            //solveA(rhs) returns inv(A)*rhs using the existing factorization, diagA is the diagonal of A
+            //lambda is the initial guess on entry and the multipliers on exit, x gets the constrained solution
+            template<typename SolveA>
+            unsigned int solve(Eigen::VectorXx<DataType> &x, Eigen::VectorXx<DataType> &lambda, SolveA solveA, const Eigen::VectorXx<DataType> &x0,
+                               const Eigen::SparseMatrix<DataType, Eigen::RowMajor> &J, const Eigen::VectorXx<DataType> &d, unsigned int numEq,
+                               const Eigen::VectorXx<DataType> &diagA);
+
+            inline void setMaxIterations(unsigned int maxIter) { m_maxIter = maxIter; }
+            inline unsigned int getMaxIterations() const { return m_maxIter; }
+
+            inline void setTolerance(DataType tol) { m_tol = tol; }
+            inline DataType getTolerance() const { return m_tol; }
+
+            //iterations and final residual of the last solve
+            inline unsigned int getNumIterations() const { return m_numIterations; }
+            inline DataType getResidual() const { return m_residual; }
+
+        protected:
+
+            //lambda(numEq:end) >= 0
+            inline void project(Eigen::VectorXx<DataType> &lambda, unsigned int numEq) const {
+                lambda.tail(lambda.rows() - numEq) = lambda.tail(lambda.rows() - numEq).cwiseMax(static_cast<DataType>(0));
+            }
+
+            unsigned int m_maxIter, m_numIterations;
+            DataType m_tol, m_L, m_residual;
+
+        private:
+        };
+
+        template<typename DataType>
+        template<typename SolveA>
+        unsigned int SolverContactQP<DataType>::solve(Eigen::VectorXx<DataType> &x, Eigen::VectorXx<DataType> &lambda, SolveA solveA, const Eigen::VectorXx<DataType> &x0,
+                                                      const Eigen::SparseMatrix<DataType, Eigen::RowMajor> &J, const Eigen::VectorXx<DataType> &d, unsigned int numEq,
+                                                      const Eigen::VectorXx<DataType> &diagA) {
+
+            unsigned int m = J.rows();
+
+            m_numIterations = 0;
+            m_residual = 0;
+
+            if(m == 0) {
+                x = x0;
+                lambda.resize(0);
+                return 0;
+            }
+
+            if(lambda.rows() != m) {
+                lambda.resize(m);
+                lambda.setZero();
+            }
+
+            project(lambda, numEq);
+
+            //metric, D(i) = J(i,:)*diag(A)^-1*J(i,:)'
+            Eigen::VectorXx<DataType> D(m);
+            for(unsigned int ii=0; ii<m; ++ii) {
+                DataType Dii = 0;
+                for(typename Eigen::SparseMatrix<DataType, Eigen::RowMajor>::InnerIterator it(J, ii); it; ++it) {
+                    Dii += it.value()*it.value()/diagA[it.col()];
+                }
+
+                D[ii] = (Dii > std::numeric_limits<DataType>::epsilon() ? Dii : static_cast<DataType>(1));
+            }
+
+            Eigen::VectorXx<DataType> q = J*x0 - d;
+
+            //u = inv(A)*J'*lambda (the primal correction) and S*lambda = J*u
+            auto applyS = [&J, &solveA](const Eigen::VectorXx<DataType> &l, Eigen::VectorXx<DataType> &u, Eigen::VectorXx<DataType> &Sl) {
+                Eigen::VectorXx<DataType> Jtl = J.transpose()*l;
+                u = solveA(Jtl);
+                Sl = J*u;
+            };
+
+            //current iterate
+            Eigen::VectorXx<DataType> l = lambda, ul, Sl;
+            applyS(l, ul, Sl);
+
+            //extrapolated point, S is linear so its products are extrapolated along with it
+            Eigen::VectorXx<DataType> y = l, Sy = Sl;
+
+            //candidate
+            Eigen::VectorXx<DataType> ln, un, Sn, gy, gn, dl;
+
+            //best iterate so far (the accelerated method is not monotone)
+            Eigen::VectorXx<DataType> lBest = l, uBest = ul;
+            DataType rBest = std::numeric_limits<DataType>::infinity();
+
+            DataType L = m_L;
+            DataType theta = 1;
+
+            for(m_numIterations = 0; m_numIterations < m_maxIter; ++m_numIterations) {
+
+                gy = Sy + q;
+                DataType fy = y.dot(static_cast<DataType>(0.5)*Sy + q);
+
+                //projected step, double L until the quadratic model bounds the objective
+                for(unsigned int jj=0; jj<60; ++jj) {
+                    ln = y - gy.cwiseQuotient(L*D);
+                    project(ln, numEq);
+                    applyS(ln, un, Sn);
+
+                    dl = ln - y;
+                    DataType fn = ln.dot(static_cast<DataType>(0.5)*Sn + q);
+                    DataType model = fy + gy.dot(dl) + static_cast<DataType>(0.5)*L*dl.dot(D.cwiseProduct(dl));
+
+                    if(fn <= model + std::numeric_limits<DataType>::epsilon()*(std::abs(fy) + static_cast<DataType>(1))) {
+                        break;
+                    }
+
+                    L *= 2;
+                }
+
+                //projected gradient residual at the candidate, contact rows are converged when they are not violated and
+                //rows that still carry a multiplier are not separating
+                gn = Sn + q;
+                DataType residual = 0;
+                for(unsigned int ii=0; ii<m; ++ii) {
+                    DataType ri = (ii < numEq ? gn[ii] : std::min(gn[ii], L*D[ii]*ln[ii]));
+                    residual = std::max(residual, std::abs(ri));
+                }
+
+                if(residual < rBest) {
+                    rBest = residual;
+                    lBest = ln;
+                    uBest = un;
+                }
+
+                if(residual <= m_tol) {
+                    ++m_numIterations;
+                    break;
+                }
+
+                //Nesterov momentum, restart when the step goes uphill
+                DataType thetaN = static_cast<DataType>(0.5)*(-theta*theta + theta*std::sqrt(theta*theta + 4));
+                DataType beta = theta*(1 - theta)/(theta*theta + thetaN);
+
+                if(gy.dot(ln - l) > 0) {
+                    thetaN = 1;
+                    beta = 0;
+                }
+
+                y = ln + beta*(ln - l);
+                Sy = Sn + beta*(Sn - Sl);
+
+                l = ln;
+                Sl = Sn;
+
+                theta = thetaN;
+                L *= static_cast<DataType>(0.9);
+            }
+
+            m_L = L;
+            m_residual = rBest;
+
+            lambda = lBest;
+            x = x0 + uBest;
+
+            return m_numIterations;
+        }
+    }
+}
+
+#endif /* SolverContactQP_h */
@@ -24,9 +24,9 @@
 #include <UtilitiesMATLAB.h>
 #include <Eigen/SparseCholesky>
 #include <SolverPardiso.h>
-
-//solver
-#include <igl/active_set.h>
+#include <SolverMultiRHS.h>
+#include <UtilitiesContact.h>
+#include <SolverContactQP.h>
 
 namespace Gauss {
     namespace Collisions {
@@ -36,15 +36,40 @@ namespace Gauss {
         {
         public:
             
-            TimeStepperImplEulerImplicitLinearCollisions() {
-                
+            //refactor - rebuild and refactor M - dt*dt*K every step (set to false for linear materials)
+            //schurContacts - keep the factorization of M - dt*dt*K and handle contacts using the Schur complement of
+            //                the (small) set of constraint rows instead of handing the full system to a QP solver
+            //                (contact multipliers are warm started from the collision detectors' contact caches)
+            //iterativeContacts - (schurContacts only) never form the Schur complement, solve the contact QP with SolverContactQP
+            //                    instead of the dense active set method, use this when there are many contacts
+            //Without GAUSS_GUROBI the full QP (schurContacts = false) is also solved with SolverContactQP.
+            TimeStepperImplEulerImplicitLinearCollisions(bool refactor = true, bool schurContacts = false, bool iterativeContacts = false) {
+                m_factored = false;
+                m_refactor = refactor;
+                m_schurContacts = schurContacts;
+                m_iterativeContacts = iterativeContacts;
+                m_numContactIterations = 0;
+                m_warmStart = true;
+                m_dt = 0;
             }
             
-            TimeStepperImplEulerImplicitLinearCollisions(const TimeStepperImplEulerImplicitLinearCollisions &toCopy) {
-                
+            TimeStepperImplEulerImplicitLinearCollisions(const TimeStepperImplEulerImplicitLinearCollisions &toCopy) : m_contactSolver(toCopy.m_contactSolver) {
+                m_factored = false;
+                m_refactor = toCopy.m_refactor;
+                m_schurContacts = toCopy.m_schurContacts;
+                m_iterativeContacts = toCopy.m_iterativeContacts;
+                m_numContactIterations = 0;
+                m_warmStart = true;
+                m_dt = 0;
             }
             
-            ~TimeStepperImplEulerImplicitLinearCollisions() { }
+            ~TimeStepperImplEulerImplicitLinearCollisions() {
+                #ifdef GAUSS_PARDISO
+                    if(m_factored) {
+                        m_pardiso.cleanup();
+                    }
+                #endif
+            }
             
             //Methods
             //init() //initial conditions will be set at the begining
@@ -53,13 +78,46 @@ namespace Gauss {
             
             inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
             
+            //active set (or SolverContactQP) iterations of the last contact solve
+            inline unsigned int getNumContactIterations() const { return m_numContactIterations; }
+            
+            //tolerance and iteration limit of the native contact solver
+            inline SolverContactQP<DataType> & getContactSolver() { return m_contactSolver; }
+            
+            //don't warm start the next step from the multipliers of the last one (i.e after TimeStepperAdaptive rejects a step),
+            //the contact caches are overwritten by the next solve
+            inline void resetHistory() { m_warmStart = false; m_lagrangeMultipliers.resize(0); }
+            
         protected:
             
+            //contact solve using the cached factorization of the system matrix
+            template<typename World>
+            void stepSchur(World &world, double dt, double t);
+            
+            //run the collision detectors for a step of size dt with the unconstrained end of step velocity x0 in the state,
+            //continuous detectors then sweep the motion the contact rows actually constrain (the velocities are restored afterwards)
+            template<typename World>
+            void detectCollisions(World &world, const Eigen::VectorXd &x0, double dt);
+            
+            //equality rows stacked on top of the contact rows, J*x = d for the first numEq rows and J*x >= d for the rest,
+            //the contact rhs comes from the detectors (getDbDt)
+            void stackConstraints(Eigen::SparseMatrix<DataType, Eigen::RowMajor> &J, Eigen::VectorXd &d);
+            
+            //initial multipliers, equality multipliers from the last step and contact multipliers from the contact caches
+            //(persistent contacts start active so resting contact usually needs a single active set iteration)
+            template<typename World>
+            void warmStart(World &world, Eigen::VectorXd &lambda, unsigned int numEq);
+            
+            //hand the contact multipliers back to the contact caches
+            template<typename World>
+            void storeMultipliers(World &world, Eigen::VectorXd &lambda, unsigned int numEq);
+            
             MatrixAssembler m_massMatrix;
             MatrixAssembler m_stiffnessMatrix;
             MatrixAssembler m_collisionConstraints;
             MatrixAssembler m_equalityConstraints;
             VectorAssembler m_dBdT;
+            VectorAssembler m_contactBounds;
             VectorAssembler m_forceVector;
 #ifdef GAUSS_GUROBI
             Eigen::GurobiSparse qp;
@@ -74,6 +132,13 @@ namespace Gauss {
             //storage for lagrange multipliers
             typename VectorAssembler::MatrixType m_lagrangeMultipliers;
             
+            SolverContactQP<DataType> m_contactSolver;
+            Eigen::VectorXd m_systemDiagonal;
+            
+            bool m_factored, m_refactor, m_schurContacts, m_iterativeContacts, m_warmStart;
+            unsigned int m_numContactIterations;
+            double m_dt;
+            
         private:
         };
     
@@ -81,6 +146,11 @@ namespace Gauss {
     template<typename World>
     void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::step(World &world, double dt, double t) {
         
+        if(m_schurContacts) {
+            stepSchur(world, dt, t);
+            return;
+        }
+        
         //First two lines work around the fact that C++11 lambda can't directly capture a member variable.
         MatrixAssembler &massMatrix = m_massMatrix;
         MatrixAssembler &collisions = m_collisionConstraints;
@@ -88,6 +158,7 @@ namespace Gauss {
         MatrixAssembler &stiffnessMatrix = m_stiffnessMatrix;
         VectorAssembler &forceVector = m_forceVector;
         VectorAssembler &dbdt = m_dBdT;
+        VectorAssembler &contactBounds = m_contactBounds;
         
         //get mass matrix
         ASSEMBLEMATINIT(massMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
@@ -106,14 +177,59 @@ namespace Gauss {
         ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
         ASSEMBLEEND(forceVector);
         
+        //Grab the state
+        Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+        Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
+        
+        //setup RHS
+        (*forceVector) = ((*massMatrix)*qDot + dt*(*forceVector));
+        
+        //unconstrained solution
+        Eigen::VectorXd x0;
+        
+#ifdef GAUSS_PARDISO
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
+        
+        m_pardiso.symbolicFactorization(systemMatrix);
+        m_pardiso.numericalFactorization();
+        
+        m_pardiso.solve(*forceVector);
+        x0 = m_pardiso.getX();
+        
+        auto solveA = [this](Eigen::VectorXd &rhs) -> Eigen::VectorXd {
+            m_pardiso.solve(rhs);
+            return m_pardiso.getX();
+        };
+#else
+        //solve system (Need interface for solvers but for now just use Eigen LLt)
+        Eigen::SparseMatrix<DataType> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > solver;
+        solver.compute(systemMatrix);
+        
+        if(solver.info()!=Eigen::Success) {
+            // decomposition failed
+            assert(1 == 0);
+            std::cout<<"Decomposition Failed \n";
+            exit(1);
+        }
+        
+        x0 = solver.solve((*forceVector));
+        
+        auto solveA = [&solver](const Eigen::VectorXd &rhs) -> Eigen::VectorXd { return solver.solve(rhs); };
+#endif
+        
         //collision constraints
         
         //make sure collisions have been detected by running the constraint update function
-        world.updateInequalityConstraints();
+        detectCollisions(world, x0, dt);
         ASSEMBLEMATINIT(collisions, world.getNumInequalityConstraints(), world.getNumQDotDOFs());
         ASSEMBLELISTCONSTRAINT(collisions, world.getInequalityConstraintList(), getGradient);
         ASSEMBLEEND(collisions);
         
+        ASSEMBLEVECINIT(contactBounds, world.getNumInequalityConstraints());
+        ASSEMBLELISTCONSTRAINT(contactBounds, world.getInequalityConstraintList(), getDbDt);
+        ASSEMBLEEND(contactBounds);
+        
         ASSEMBLEMATINIT(equality, world.getNumConstraints(), world.getNumQDotDOFs());
         ASSEMBLELISTCONSTRAINT(equality, world.getConstraintList(), getGradient);
         ASSEMBLEEND(equality);
@@ -122,73 +238,38 @@ namespace Gauss {
         ASSEMBLELISTCONSTRAINT(dbdt, world.getConstraintList(), getDbDt);
         ASSEMBLEEND(dbdt);
         
-        //Grab the state
-        Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
-        Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
-        
-        //setup RHS
-        (*forceVector) = ((*massMatrix)*qDot + dt*(*forceVector));
-        
-        Eigen::VectorXd x0;
-        //Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
-        
-        
-        //solve using libigl active set solver
-        Eigen::VectorXi known;
-        Eigen::VectorXd bKnown;
-        Eigen::SparseMatrix<DataType> Aeq = (*equality);
-        Eigen::VectorXd beq = (*dbdt);
-        Eigen::VectorXd b;
-        Eigen::SparseMatrix<DataType> Aineq = -(*collisions);
-        b.resize((*collisions).rows(),1);
-        b.setZero();
-        Eigen::VectorXd lx;
-        Eigen::VectorXd ux;
-        
-        if(Aineq.rows() == 0 && Aeq.rows() == 0) {
-            Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
-            
-#ifdef GAUSS_PARDISO
-            m_pardiso.symbolicFactorization(systemMatrix);
-            m_pardiso.numericalFactorization();
-            
-            m_pardiso.solve(*forceVector);
-            x0 = m_pardiso.getX();
-            //m_pardiso.cleanup();
-#else
-            //solve system (Need interface for solvers but for now just use Eigen LLt)
-            Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
-            solver.compute(systemMatrix);
+        if((*collisions).rows() == 0 && (*equality).rows() == 0) {
+            qDot = x0;
+        } else {
+#ifndef GAUSS_GUROBI
+            //native QP, dual solve against the factorization of the system matrix
+            Eigen::SparseMatrix<DataType, Eigen::RowMajor> J;
+            Eigen::VectorXd d;
+            stackConstraints(J, d);
             
+            unsigned int numEq = (*equality).rows();
+            Eigen::VectorXd lambda = Eigen::VectorXd::Zero(J.rows());
+            Eigen::VectorXd qDotTmp;
             
-            if(solver.info()!=Eigen::Success) {
-                // decomposition failed
-                assert(1 == 0);
-                std::cout<<"Decomposition Failed \n";
-                exit(1);
-            }
+            warmStart(world, lambda, numEq);
             
-            if(solver.info()!=Eigen::Success) {
-                // solving failed
-                assert(1 == 0);
-                std::cout<<"Solve Failed \n";
-                exit(1);
-            }
+            m_numContactIterations = m_contactSolver.solve(qDotTmp, lambda, solveA, x0, J, d, numEq, systemMatrix.diagonal());
             
+            storeMultipliers(world, lambda, numEq);
             
-            x0 = solver.solve((*forceVector));
-#endif
-            qDot = x0;
-        } else {
-            Eigen::SparseMatrix<DataType> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
-            (*forceVector) *= -1.0;
-#ifndef GAUSS_GUROBI
-            igl::active_set_params params;
-            //params.max_iter = 0;
-            Eigen::VectorXd qDotTmp = qDot;
-            active_set(systemMatrix, (*forceVector), known, bKnown, Aeq, beq, Aineq, b, lx, ux, params, qDotTmp);
             qDot = qDotTmp;
+            m_lagrangeMultipliers = lambda;
 #else
+            //solve using gurobi, Aineq*x <= b
+            Eigen::SparseMatrix<DataType> Aeq = (*equality);
+            Eigen::VectorXd beq = (*dbdt);
+            Eigen::SparseMatrix<DataType> Aineq = -(*collisions);
+            Eigen::VectorXd b = -(*contactBounds);
+            Eigen::VectorXd lx;
+            Eigen::VectorXd ux;
+            
+            (*forceVector) *= -1.0;
+            
             lx.resize(qDot.rows());
             ux.resize(qDot.rows());
             lx.setConstant(-100000);
@@ -197,7 +278,7 @@ namespace Gauss {
             qp.displayOutput(false);
             qp.warmStart(Eigen::GurobiCommon::WarmStatus::PRIMAL);
             qp.problem(qDot.rows(), Aeq.rows(), Aineq.rows());
-            qp.solve(systemMatrix, (*forceVector).sparseView(), Aeq, beq.sparseView(), Aineq, b.sparseView(), lx.sparseView(), ux.sparseView());
+            qp.solve(Eigen::SparseMatrix<DataType>(systemMatrix), (*forceVector).sparseView(), Aeq, beq.sparseView(), Aineq, b.sparseView(), lx.sparseView(), ux.sparseView());
             
             qDot = qp.result();
 #endif
@@ -208,6 +289,222 @@ namespace Gauss {
         
     }
     
+    //Only the constraint rows change from step to step so keep A = M - dt*dt*K factored and solve
+    //  [A  -J'][x     ]   [f]
+    //  [J   0 ][lambda] = [d]   (with complementarity on the contact rows)
+    //via the Schur complement S = J*inv(A)*J'. This costs one multiple right hand side solve with the existing
+    //factors plus a small dense solve per step instead of a full refactorization.
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    template<typename World>
+    void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::stepSchur(World &world, double dt, double t) {
+        
+        //First two lines work around the fact that C++11 lambda can't directly capture a member variable.
+        MatrixAssembler &massMatrix = m_massMatrix;
+        MatrixAssembler &collisions = m_collisionConstraints;
+        MatrixAssembler &equality = m_equalityConstraints;
+        MatrixAssembler &stiffnessMatrix = m_stiffnessMatrix;
+        VectorAssembler &forceVector = m_forceVector;
+        VectorAssembler &dbdt = m_dBdT;
+        VectorAssembler &contactBounds = m_contactBounds;
+        
+        //the cached factorization is M - dt*dt*K for the dt it was built with
+        if(m_refactor || !m_factored || dt != m_dt) {
+            
+            //get mass matrix
+            ASSEMBLEMATINIT(massMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+            ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+            ASSEMBLEEND(massMatrix);
+            
+            //get stiffness matrix
+            ASSEMBLEMATINIT(stiffnessMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+            ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
+            ASSEMBLELIST(stiffnessMatrix, world.getForceList(), getStiffnessMatrix);
+            ASSEMBLEEND(stiffnessMatrix);
+            
+#ifdef GAUSS_PARDISO
+            Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
+            
+            if(m_factored) {
+                m_pardiso.cleanup();
+            }
+            
+            m_pardiso.symbolicFactorization(systemMatrix);
+            m_pardiso.numericalFactorization();
+#else
+            Eigen::SparseMatrix<DataType> systemMatrix = (*m_massMatrix)- dt*dt*(*m_stiffnessMatrix);
+            m_eigensolver.compute(systemMatrix);
+            
+            if(m_eigensolver.info()!=Eigen::Success) {
+                // decomposition failed
+                assert(1 == 0);
+                std::cout<<"Decomposition Failed \n";
+                exit(1);
+            }
+#endif
+            m_systemDiagonal = systemMatrix.diagonal();
+            m_factored = true;
+            m_dt = dt;
+        }
+        
+        ASSEMBLEVECINIT(forceVector, world.getNumQDotDOFs());
+        ASSEMBLELIST(forceVector, world.getForceList(), getForce);
+        ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+        ASSEMBLEEND(forceVector);
+        
+        //Grab the state
+        Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+        Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
+        
+        //setup RHS
+        (*forceVector) = ((*massMatrix)*qDot + dt*(*forceVector));
+        
+        //unconstrained solution
+        Eigen::VectorXd x0;
+#ifdef GAUSS_PARDISO
+        m_pardiso.solve(*forceVector);
+        x0 = m_pardiso.getX();
+#else
+        x0 = m_eigensolver.solve((*forceVector));
+#endif
+        
+        //make sure collisions have been detected by running the constraint update function
+        detectCollisions(world, x0, dt);
+        ASSEMBLEMATINIT(collisions, world.getNumInequalityConstraints(), world.getNumQDotDOFs());
+        ASSEMBLELISTCONSTRAINT(collisions, world.getInequalityConstraintList(), getGradient);
+        ASSEMBLEEND(collisions);
+        
+        ASSEMBLEVECINIT(contactBounds, world.getNumInequalityConstraints());
+        ASSEMBLELISTCONSTRAINT(contactBounds, world.getInequalityConstraintList(), getDbDt);
+        ASSEMBLEEND(contactBounds);
+        
+        ASSEMBLEMATINIT(equality, world.getNumConstraints(), world.getNumQDotDOFs());
+        ASSEMBLELISTCONSTRAINT(equality, world.getConstraintList(), getGradient);
+        ASSEMBLEEND(equality);
+        
+        ASSEMBLEVECINIT(dbdt, world.getNumConstraints());
+        ASSEMBLELISTCONSTRAINT(dbdt, world.getConstraintList(), getDbDt);
+        ASSEMBLEEND(dbdt);
+        
+        unsigned int numEq = (*equality).rows();
+        unsigned int numConstraints = numEq + (*collisions).rows();
+        
+        if(numConstraints == 0) {
+            qDot = x0;
+            m_lagrangeMultipliers.resize(0);
+            q = q + dt*qDot;
+            return;
+        }
+        
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> J;
+        Eigen::VectorXd d;
+        stackConstraints(J, d);
+        
+        Eigen::VectorXd lambda = Eigen::VectorXd::Zero(numConstraints);
+        warmStart(world, lambda, numEq);
+        
+        if(m_iterativeContacts) {
+            
+            //matrix free, every iteration is a solve with the cached factors
+            Eigen::VectorXd x;
+#ifdef GAUSS_PARDISO
+            auto solveA = [this](Eigen::VectorXd &rhs) -> Eigen::VectorXd {
+                m_pardiso.solve(rhs);
+                return m_pardiso.getX();
+            };
+#else
+            auto solveA = [this](const Eigen::VectorXd &rhs) -> Eigen::VectorXd { return m_eigensolver.solve(rhs); };
+#endif
+            m_numContactIterations = m_contactSolver.solve(x, lambda, solveA, x0, J, d, numEq, m_systemDiagonal);
+            
+            storeMultipliers(world, lambda, numEq);
+            
+            qDot = x;
+            m_lagrangeMultipliers = lambda;
+            
+            q = q + dt*qDot;
+            return;
+        }
+        
+        //Y = inv(A)*J', one multiple right hand side solve against the cached factors
+        Eigen::MatrixXd Jt = Eigen::MatrixXd(J.transpose());
+#ifdef GAUSS_PARDISO
+        Eigen::MatrixXd Y = solveMultipleRHS(m_pardiso, Jt);
+#else
+        Eigen::MatrixXd Y = solveMultipleRHS(m_eigensolver, Jt);
+#endif
+        
+        Eigen::MatrixXd S = J*Y;
+        Eigen::VectorXd qLCP = J*x0 - d;
+        
+        m_numContactIterations = solveSchurComplementLCP(lambda, S, qLCP, numEq);
+        
+        storeMultipliers(world, lambda, numEq);
+        
+        qDot = x0 + Y*lambda;
+        m_lagrangeMultipliers = lambda;
+        
+        q = q + dt*qDot;
+    }
+    
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::stackConstraints(Eigen::SparseMatrix<DataType, Eigen::RowMajor> &J, Eigen::VectorXd &d) {
+        
+        unsigned int numEq = (*m_equalityConstraints).rows();
+        unsigned int numConstraints = numEq + (*m_collisionConstraints).rows();
+        
+        J.resize(numConstraints, (*m_equalityConstraints).cols());
+        J.topRows(numEq) = (*m_equalityConstraints);
+        J.bottomRows(numConstraints - numEq) = (*m_collisionConstraints);
+        
+        d.resize(numConstraints);
+        d.head(numEq) = (*m_dBdT);
+        d.tail(numConstraints - numEq) = (*m_contactBounds);
+    }
+    
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    template<typename World>
+    void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::detectCollisions(World &world, const Eigen::VectorXd &x0, double dt) {
+        
+        //the step size can change from step to step (i.e TimeStepperAdaptive)
+        forEach(world.getInequalityConstraintList(), [dt](auto a) {
+            callSetTimeStep(a->getImpl(), dt, 0);
+        });
+        
+        Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
+        Eigen::VectorXd qDotStart = qDot;
+        
+        qDot = x0;
+        world.updateInequalityConstraints();
+        qDot = qDotStart;
+    }
+    
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    template<typename World>
+    void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::warmStart(World &world, Eigen::VectorXd &lambda, unsigned int numEq) {
+        
+        if(!m_warmStart) {
+            m_warmStart = true;
+            return;
+        }
+        
+        if(m_lagrangeMultipliers.rows() >= numEq) {
+            lambda.head(numEq) = m_lagrangeMultipliers.head(numEq);
+        }
+        
+        forEach(world.getInequalityConstraintList(), [&lambda, numEq](auto a) {
+            callGetWarmStart(a->getImpl(), lambda, numEq + a->getIndex().getGlobalId(), 0);
+        });
+    }
+    
+    template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
+    template<typename World>
+    void TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler>::storeMultipliers(World &world, Eigen::VectorXd &lambda, unsigned int numEq) {
+        
+        forEach(world.getInequalityConstraintList(), [&lambda, numEq](auto a) {
+            callSetMultipliers(a->getImpl(), lambda, numEq + a->getIndex().getGlobalId(), 0);
+        });
+    }
+    
     template<typename DataType, typename MatrixAssembler, typename VectorAssembler>
     using TimeStepperEulerImplicitLinearCollisions = TimeStepper<DataType, TimeStepperImplEulerImplicitLinearCollisions<DataType, MatrixAssembler, VectorAssembler> >;
     }
@@ -10,6 +10,14 @@
 #define ConstraintContact_h
 
 #include <UtilitiesEigen.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
 namespace Gauss {
     namespace Collisions {
@@ -83,6 +91,602 @@ namespace Gauss {
             
         };
         
+        //identifies a contact row across time steps, (system type, system index, primitive) for both objects
+        //(type -1 = fixed object, the primitive then names the obstacle i.e the plane)
+        struct ContactKey {
+            
+            std::array<int, 6> m_ids;
+            
+            inline bool operator==(const ContactKey &key) const { return m_ids == key.m_ids; }
+        };
+        
+        struct ContactKeyHash {
+            inline std::size_t operator()(const ContactKey &key) const {
+                std::size_t h = 0;
+                for(unsigned int ii=0; ii<6; ++ii) {
+                    h ^= std::hash<int>()(key.m_ids[ii]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                }
+                return h;
+            }
+        };
+        
+        //Shrinks vertex contact lists (ObjectCollisionInfo<DataType, 0>) before constraint assembly:
+        //  1. rows with the same contact key (same vertices on both objects) are merged, normals are averaged
+        //  2. radius > 0: per object pair, contacts within radius of a deeper contact whose normal is within maxAngle of
+        //     theirs are dropped (the deeper one represents the cluster)
+        //  3. maxPerPair > 0: per object pair, at most maxPerPair contacts are kept, picked by farthest point sampling
+        //     starting from the deepest contact so the survivors cover the contact region
+        //In 2. and 3. a contact is a contact point, rows with the same position and normal (i.e the three vertex rows of an FCL
+        //triangle contact) are kept or dropped together. Survivors keep their original order. maxPerPair = 0 and radius = 0 only
+        //merge duplicates.
+        template<typename DataType>
+        class ContactReduction {
+        public:
+            
+            ContactReduction(unsigned int maxPerPair = 0, DataType radius = 0, DataType maxAngle = 0.26) {
+                m_maxPerPair = maxPerPair;
+                m_radius = radius;
+                m_cosAngle = std::cos(maxAngle);
+            }
+            
+            inline void setMaxPerPair(unsigned int maxPerPair) { m_maxPerPair = maxPerPair; }
+            inline unsigned int getMaxPerPair() const { return m_maxPerPair; }
+            
+            inline void setRadius(DataType radius) { m_radius = radius; }
+            inline DataType getRadius() const { return m_radius; }
+            
+            inline void setMaxAngle(DataType maxAngle) { m_cosAngle = std::cos(maxAngle); }
+            inline DataType getMaxAngle() const { return std::acos(m_cosAngle); }
+            
+            template<typename ObjectList>
+            void reduce(ObjectList &objAList, ObjectList &objBList, std::vector<SharedCollisionInfo<DataType> > &sharedList) {
+                
+                auto &rowsA = objAList.template get<0>();
+                auto &rowsB = objBList.template get<0>();
+                
+                assert(rowsA.size() == rowsB.size());
+                
+                unsigned int numRows = rowsA.size();
+                
+                if(numRows == 0) {
+                    return;
+                }
+                
+                std::vector<Eigen::Vector3x<DataType> > normals(numRows);
+                std::vector<DataType> depths(numRows);
+                std::vector<bool> keep(numRows, false);
+                
+                //1. duplicates
+                std::unordered_map<ContactKey, unsigned int, ContactKeyHash> rowOfKey;
+                
+                for(unsigned int ii=0; ii<numRows; ++ii) {
+                    
+                    ContactKey key{{{rowsA[ii].getObject().type(), rowsA[ii].getObject().index(), rowsA[ii].getData(0),
+                                     rowsB[ii].getObject().type(), rowsB[ii].getObject().index(), rowsB[ii].getData(0)}}};
+                    
+                    const SharedCollisionInfo<DataType> &info = sharedList[rowsA[ii].getShared()];
+                    auto inserted = rowOfKey.insert(std::make_pair(key, ii));
+                    
+                    if(inserted.second) {
+                        keep[ii] = true;
+                        normals[ii] = info.getNormal();
+                        depths[ii] = info.getDepth();
+                    } else {
+                        unsigned int first = inserted.first->second;
+                        normals[first] += info.getNormal();
+                        depths[first] = std::max(depths[first], info.getDepth());
+                    }
+                }
+                
+                for(unsigned int ii=0; ii<numRows; ++ii) {
+                    if(keep[ii] && normals[ii].norm() > 0) {
+                        normals[ii].normalize();
+                    }
+                }
+                
+                //group by object pair
+                if(m_radius > 0 || m_maxPerPair > 0) {
+                    
+                    std::map<std::array<int, 4>, std::vector<unsigned int> > pairs;
+                    
+                    for(unsigned int ii=0; ii<numRows; ++ii) {
+                        if(keep[ii]) {
+                            pairs[std::array<int, 4>{{rowsA[ii].getObject().type(), rowsA[ii].getObject().index(),
+                                                      rowsB[ii].getObject().type(), rowsB[ii].getObject().index()}}].push_back(ii);
+                        }
+                    }
+                    
+                    for(auto &pair : pairs) {
+                        reducePair(pair.second, rowsA, sharedList, normals, depths, keep);
+                    }
+                }
+                
+                //compact, shared info is rebuilt in row order
+                std::vector<SharedCollisionInfo<DataType> > reducedShared;
+                unsigned int numKept = 0;
+                
+                for(unsigned int ii=0; ii<numRows; ++ii) {
+                    
+                    if(!keep[ii]) {
+                        continue;
+                    }
+                    
+                    const SharedCollisionInfo<DataType> &info = sharedList[rowsA[ii].getShared()];
+                    reducedShared.push_back(SharedCollisionInfo<DataType>(normals[ii], info.getPosition(), depths[ii]));
+                    
+                    rowsA[numKept] = rowsA[ii];
+                    rowsB[numKept] = rowsB[ii];
+                    rowsA[numKept].m_infoIndex = numKept;
+                    rowsB[numKept].m_infoIndex = numKept;
+                    ++numKept;
+                }
+                
+                rowsA.resize(numKept);
+                rowsB.resize(numKept);
+                sharedList.swap(reducedShared);
+            }
+            
+        protected:
+            
+            template<typename Rows>
+            void reducePair(std::vector<unsigned int> &rows, const Rows &rowsA, const std::vector<SharedCollisionInfo<DataType> > &sharedList,
+                            const std::vector<Eigen::Vector3x<DataType> > &normals, const std::vector<DataType> &depths, std::vector<bool> &keep) {
+                
+                auto position = [&](unsigned int row) -> const Eigen::Vector3x<DataType> & { return sharedList[rowsA[row].getShared()].getPosition(); };
+                
+                //deepest first
+                std::stable_sort(rows.begin(), rows.end(), [&depths](unsigned int a, unsigned int b) { return depths[a] > depths[b]; });
+                
+                //one group per contact point, led by its deepest row
+                std::map<std::array<DataType, 6>, unsigned int> groupOf;
+                std::vector<std::vector<unsigned int> > groups;
+                std::vector<unsigned int> leaders;
+                
+                for(unsigned int row : rows) {
+                    
+                    const Eigen::Vector3x<DataType> &x = position(row), &n = normals[row];
+                    auto inserted = groupOf.insert(std::make_pair(std::array<DataType, 6>{{x[0], x[1], x[2], n[0], n[1], n[2]}}, groups.size()));
+                    
+                    if(inserted.second) {
+                        groups.push_back(std::vector<unsigned int>());
+                        leaders.push_back(row);
+                    }
+                    
+                    groups[inserted.first->second].push_back(row);
+                }
+                
+                reduceContacts(leaders, position, normals, keep);
+                
+                for(auto &group : groups) {
+                    for(unsigned int row : group) {
+                        keep[row] = keep[group.front()];
+                    }
+                }
+            }
+            
+            //steps 2. and 3. on one row per contact point, deepest first
+            template<typename Position>
+            void reduceContacts(std::vector<unsigned int> &rows, Position &position, const std::vector<Eigen::Vector3x<DataType> > &normals,
+                                std::vector<bool> &keep) {
+                
+                //2. clusters, representatives are hashed into cells of size radius
+                if(m_radius > 0) {
+                    
+                    std::unordered_map<ContactKey, std::vector<unsigned int>, ContactKeyHash> cells;
+                    std::vector<unsigned int> representatives;
+                    
+                    auto cellOf = [this](const Eigen::Vector3x<DataType> &x, int di, int dj, int dk) {
+                        return ContactKey{{{static_cast<int>(std::floor(x[0]/m_radius)) + di, static_cast<int>(std::floor(x[1]/m_radius)) + dj,
+                                            static_cast<int>(std::floor(x[2]/m_radius)) + dk, 0, 0, 0}}};
+                    };
+                    
+                    for(unsigned int row : rows) {
+                        
+                        bool covered = false;
+                        
+                        for(int di=-1; di<=1 && !covered; ++di) {
+                            for(int dj=-1; dj<=1 && !covered; ++dj) {
+                                for(int dk=-1; dk<=1 && !covered; ++dk) {
+                                    
+                                    auto cell = cells.find(cellOf(position(row), di, dj, dk));
+                                    
+                                    if(cell == cells.end()) {
+                                        continue;
+                                    }
+                                    
+                                    for(unsigned int rep : cell->second) {
+                                        if((position(rep) - position(row)).norm() < m_radius && normals[rep].dot(normals[row]) >= m_cosAngle) {
+                                            covered = true;
+                                            break;
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                        
+                        if(covered) {
+                            keep[row] = false;
+                        } else {
+                            cells[cellOf(position(row), 0, 0, 0)].push_back(row);
+                            representatives.push_back(row);
+                        }
+                    }
+                    
+                    rows.swap(representatives);
+                }
+                
+                //3. cap, farthest point sampling (distance plus a normal term so differently oriented contacts survive)
+                if(m_maxPerPair == 0 || rows.size() <= m_maxPerPair) {
+                    return;
+                }
+                
+                Eigen::Vector3x<DataType> boxMin = position(rows[0]), boxMax = position(rows[0]);
+                
+                for(unsigned int row : rows) {
+                    boxMin = boxMin.cwiseMin(position(row));
+                    boxMax = boxMax.cwiseMax(position(row));
+                }
+                
+                DataType scale = (boxMax - boxMin).norm();
+                std::vector<DataType> distance(rows.size(), std::numeric_limits<DataType>::infinity());
+                std::vector<bool> chosen(rows.size(), false);
+                
+                unsigned int next = 0;
+                
+                for(unsigned int ii=0; ii<m_maxPerPair; ++ii) {
+                    
+                    chosen[next] = true;
+                    
+                    unsigned int farthest = next;
+                    DataType farthestDistance = -1;
+                    
+                    for(unsigned int jj=0; jj<rows.size(); ++jj) {
+                        
+                        if(chosen[jj]) {
+                            continue;
+                        }
+                        
+                        DataType d = (position(rows[jj]) - position(rows[next])).norm() + scale*(1 - normals[rows[jj]].dot(normals[rows[next]]));
+                        distance[jj] = std::min(distance[jj], d);
+                        
+                        if(distance[jj] > farthestDistance) {
+                            farthestDistance = distance[jj];
+                            farthest = jj;
+                        }
+                    }
+                    
+                    next = farthest;
+                }
+                
+                for(unsigned int jj=0; jj<rows.size(); ++jj) {
+                    keep[rows[jj]] = chosen[jj];
+                }
+            }
+            
+            unsigned int m_maxPerPair;
+            DataType m_radius, m_cosAngle;
+        };
+        
+        //Solve the mixed linear complementarity problem that arises from projecting contact onto a factored system matrix A
+        //Given the Schur complement S = J*inv(A)*J' and q = J*x0 - d (x0 = unconstrained solution) find lambda s.t
+        //  w = S*lambda + q
+        //  w(0:numEq) = 0 (equality constraints, lambda free)
+        //  w(numEq:end) >= 0, lambda(numEq:end) >= 0, w'*lambda = 0 (contact constraints)
+        //S is small and dense (one row per constraint) so this is a simple active set method on dense matrices.
+        //lambda is used as the initial guess for the active set, returns the number of active set iterations taken
+        template<typename DataType>
+        unsigned int solveSchurComplementLCP(Eigen::VectorXx<DataType> &lambda, const Eigen::MatrixXx<DataType> &S, const Eigen::VectorXx<DataType> &q,
+                                             unsigned int numEq, unsigned int maxIter = 100, DataType tol = 1e-8) {
+            
+            unsigned int m = S.rows();
+            
+            if(lambda.rows() != m) {
+                lambda.resize(m);
+                lambda.setZero();
+            }
+            
+            //start with the equality constraints plus anything that is currently active or violated
+            std::vector<bool> active(m, false);
+            Eigen::VectorXx<DataType> w = S*lambda + q;
+            for(unsigned int ii=0; ii<m; ++ii) {
+                active[ii] = (ii < numEq) || (lambda[ii] > 0) || (w[ii] < -tol);
+            }
+            
+            //tiny regularization takes care of duplicate contacts (S is only semi-definite then)
+            DataType reg = std::numeric_limits<DataType>::epsilon()*(S.diagonal().cwiseAbs().maxCoeff() + static_cast<DataType>(1));
+            
+            std::vector<unsigned int> indices;
+            unsigned int iter = 0;
+            for(iter = 0; iter < maxIter; ++iter) {
+                
+                indices.clear();
+                for(unsigned int ii=0; ii<m; ++ii) {
+                    if(active[ii]) {
+                        indices.push_back(ii);
+                    }
+                }
+                
+                //solve the reduced system for the active multipliers
+                Eigen::MatrixXx<DataType> Saa(indices.size(), indices.size());
+                Eigen::VectorXx<DataType> qa(indices.size());
+                for(unsigned int ii=0; ii<indices.size(); ++ii) {
+                    qa[ii] = -q[indices[ii]];
+                    for(unsigned int jj=0; jj<indices.size(); ++jj) {
+                        Saa(ii,jj) = S(indices[ii], indices[jj]);
+                    }
+                    Saa(ii,ii) += reg;
+                }
+                
+                Eigen::VectorXx<DataType> lambdaA = Saa.ldlt().solve(qa);
+                
+                lambda.setZero();
+                for(unsigned int ii=0; ii<indices.size(); ++ii) {
+                    lambda[indices[ii]] = lambdaA[ii];
+                }
+                
+                //drop the most negative contact multiplier
+                int toRemove = -1;
+                DataType minLambda = -tol;
+                for(unsigned int ii=numEq; ii<m; ++ii) {
+                    if(active[ii] && lambda[ii] < minLambda) {
+                        minLambda = lambda[ii];
+                        toRemove = ii;
+                    }
+                }
+                
+                if(toRemove >= 0) {
+                    active[toRemove] = false;
+                    continue;
+                }
+                
+                //add the most violated inactive contact
+                w = S*lambda + q;
+                int toAdd = -1;
+                DataType minW = -tol;
+                for(unsigned int ii=numEq; ii<m; ++ii) {
+                    if(!active[ii] && w[ii] < minW) {
+                        minW = w[ii];
+                        toAdd = ii;
+                    }
+                }
+                
+                if(toAdd < 0) {
+                    break;
+                }
+                
+                active[toAdd] = true;
+            }
+            
+            //clamp anything left over from hitting the iteration limit
+            lambda.tail(m-numEq) = lambda.tail(m-numEq).cwiseMax(static_cast<DataType>(0));
+            
+            return iter;
+        }
+        
+        //closest point to p on triangle (a, b, c), w gets the barycentric weights of the closest point (Ericson, Real-Time Collision Detection 5.1.5)
+        template<typename DataType>
+        inline Eigen::Vector3x<DataType> closestPointTriangle(const Eigen::Vector3x<DataType> &p, const Eigen::Vector3x<DataType> &a,
+                                                              const Eigen::Vector3x<DataType> &b, const Eigen::Vector3x<DataType> &c,
+                                                              Eigen::Vector3x<DataType> &w) {
+            
+            Eigen::Vector3x<DataType> ab = b - a;
+            Eigen::Vector3x<DataType> ac = c - a;
+            Eigen::Vector3x<DataType> ap = p - a;
+            
+            DataType d1 = ab.dot(ap);
+            DataType d2 = ac.dot(ap);
+            
+            if(d1 <= 0 && d2 <= 0) {
+                w << 1, 0, 0;
+                return a;
+            }
+            
+            Eigen::Vector3x<DataType> bp = p - b;
+            DataType d3 = ab.dot(bp);
+            DataType d4 = ac.dot(bp);
+            
+            if(d3 >= 0 && d4 <= d3) {
+                w << 0, 1, 0;
+                return b;
+            }
+            
+            DataType vc = d1*d4 - d3*d2;
+            
+            if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+                DataType v = d1/(d1 - d3);
+                w << 1 - v, v, 0;
+                return a + v*ab;
+            }
+            
+            Eigen::Vector3x<DataType> cp = p - c;
+            DataType d5 = ab.dot(cp);
+            DataType d6 = ac.dot(cp);
+            
+            if(d6 >= 0 && d5 <= d6) {
+                w << 0, 0, 1;
+                return c;
+            }
+            
+            DataType vb = d5*d2 - d1*d6;
+            
+            if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+                DataType v = d2/(d2 - d6);
+                w << 1 - v, 0, v;
+                return a + v*ac;
+            }
+            
+            DataType va = d3*d6 - d5*d4;
+            
+            if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+                DataType v = (d4 - d3)/((d4 - d3) + (d5 - d6));
+                w << 0, 1 - v, v;
+                return b + v*(c - b);
+            }
+            
+            DataType denom = 1/(va + vb + vc);
+            DataType v = vb*denom;
+            DataType u = vc*denom;
+            w << 1 - v - u, v, u;
+            
+            return a + v*ab + u*ac;
+        }
+        
+        //closest points p0 + s*(p1 - p0) and q0 + t*(q1 - q0) between two segments, returns the squared distance
+        //(Ericson, Real-Time Collision Detection 5.1.9), degenerate segments are treated as points
+        template<typename DataType>
+        inline DataType closestPointsSegments(const Eigen::Vector3x<DataType> &p0, const Eigen::Vector3x<DataType> &p1,
+                                              const Eigen::Vector3x<DataType> &q0, const Eigen::Vector3x<DataType> &q1,
+                                              DataType &s, DataType &t) {
+            
+            const DataType eps = std::numeric_limits<DataType>::epsilon();
+            
+            Eigen::Vector3x<DataType> d1 = p1 - p0;
+            Eigen::Vector3x<DataType> d2 = q1 - q0;
+            Eigen::Vector3x<DataType> r = p0 - q0;
+            
+            DataType a = d1.squaredNorm();
+            DataType e = d2.squaredNorm();
+            DataType f = d2.dot(r);
+            
+            if(a <= eps && e <= eps) {
+                s = t = 0;
+                return r.squaredNorm();
+            }
+            
+            if(a <= eps) {
+                s = 0;
+                t = std::min<DataType>(std::max<DataType>(f/e, 0), 1);
+            } else {
+                
+                DataType c = d1.dot(r);
+                
+                if(e <= eps) {
+                    t = 0;
+                    s = std::min<DataType>(std::max<DataType>(-c/a, 0), 1);
+                } else {
+                    
+                    DataType b = d1.dot(d2);
+                    DataType denom = a*e - b*b;
+                    
+                    //parallel segments pick s = 0
+                    s = (denom > eps*a*e ? std::min<DataType>(std::max<DataType>((b*f - c*e)/denom, 0), 1) : 0);
+                    t = (b*s + f)/e;
+                    
+                    if(t < 0) {
+                        t = 0;
+                        s = std::min<DataType>(std::max<DataType>(-c/a, 0), 1);
+                    } else if(t > 1) {
+                        t = 1;
+                        s = std::min<DataType>(std::max<DataType>((b - c)/a, 0), 1);
+                    }
+                }
+            }
+            
+            return (p0 + s*d1 - q0 - t*d2).squaredNorm();
+        }
+        
+        //Times in [0,1] (ascending) at which four linearly moving points (x = x0 + t*(x1 - x0)) are coplanar, the candidate
+        //impact times of a vertex-triangle (a, b, c = triangle, p = vertex) or edge-edge (a-b, c-p) pair. The coplanarity
+        //condition is a cubic in t, it is split into monotone pieces at the roots of its derivative and each sign change
+        //is bisected. Pairs that stay coplanar return no times.
+        template<typename DataType>
+        inline void coplanarityTimes(const Eigen::Vector3x<DataType> &a0, const Eigen::Vector3x<DataType> &b0,
+                                     const Eigen::Vector3x<DataType> &c0, const Eigen::Vector3x<DataType> &p0,
+                                     const Eigen::Vector3x<DataType> &a1, const Eigen::Vector3x<DataType> &b1,
+                                     const Eigen::Vector3x<DataType> &c1, const Eigen::Vector3x<DataType> &p1,
+                                     std::vector<DataType> &times) {
+            
+            times.clear();
+            
+            Eigen::Vector3x<DataType> B = b0 - a0, C = c0 - a0, P = p0 - a0;
+            Eigen::Vector3x<DataType> dB = (b1 - a1) - B, dC = (c1 - a1) - C, dP = (p1 - a1) - P;
+            
+            Eigen::Vector3x<DataType> n0 = B.cross(C);
+            Eigen::Vector3x<DataType> n1 = B.cross(dC) + dB.cross(C);
+            Eigen::Vector3x<DataType> n2 = dB.cross(dC);
+            
+            //f(t) = k0 + k1*t + k2*t^2 + k3*t^3
+            DataType k[4] = {n0.dot(P), n0.dot(dP) + n1.dot(P), n1.dot(dP) + n2.dot(P), n2.dot(dP)};
+            
+            auto f = [&k](DataType t) { return ((k[3]*t + k[2])*t + k[1])*t + k[0]; };
+            
+            DataType scale = std::abs(k[0]) + std::abs(k[1]) + std::abs(k[2]) + std::abs(k[3]);
+            
+            if(scale <= std::numeric_limits<DataType>::min()) {
+                return;
+            }
+            
+            //interval end points, 0, roots of f' in (0,1), 1
+            DataType ends[4];
+            unsigned int numEnds = 0;
+            ends[numEnds++] = 0;
+            
+            DataType qa = 3*k[3], qb = 2*k[2], qc = k[1];
+            
+            if(std::abs(qa) > std::numeric_limits<DataType>::epsilon()*scale) {
+                
+                DataType disc = qb*qb - 4*qa*qc;
+                
+                if(disc >= 0) {
+                    DataType r0 = (-qb - std::sqrt(disc))/(2*qa);
+                    DataType r1 = (-qb + std::sqrt(disc))/(2*qa);
+                    
+                    if(r0 > r1) {
+                        std::swap(r0, r1);
+                    }
+                    
+                    if(r0 > 0 && r0 < 1) { ends[numEnds++] = r0; }
+                    if(r1 > 0 && r1 < 1 && r1 != r0) { ends[numEnds++] = r1; }
+                }
+                
+            } else if(std::abs(qb) > std::numeric_limits<DataType>::epsilon()*scale) {
+                
+                DataType r = -qc/qb;
+                
+                if(r > 0 && r < 1) { ends[numEnds++] = r; }
+            }
+            
+            ends[numEnds++] = 1;
+            
+            for(unsigned int ii=0; ii+1<numEnds; ++ii) {
+                
+                DataType lo = ends[ii], hi = ends[ii+1];
+                DataType flo = f(lo), fhi = f(hi);
+                
+                if(flo == 0) {
+                    if(times.size() == 0 || times.back() != lo) {
+                        times.push_back(lo);
+                    }
+                    continue;
+                }
+                
+                if(fhi == 0) {
+                    times.push_back(hi);
+                    continue;
+                }
+                
+                if((flo < 0) == (fhi < 0)) {
+                    continue;
+                }
+                
+                for(unsigned int iter=0; iter<60 && hi - lo > std::numeric_limits<DataType>::epsilon(); ++iter) {
+                    
+                    DataType mid = 0.5*(lo + hi);
+                    DataType fmid = f(mid);
+                    
+                    if((fmid < 0) == (flo < 0)) {
+                        lo = mid;
+                        flo = fmid;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                
+                //report the early side of the bracket, impacts should never be late
+                times.push_back(lo);
+            }
+        }
+        
     }
 }
 
@@ -7,6 +7,10 @@
 //
 
 #include <stdio.h>
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <vector>
 #include <UtilitiesEigen.h>
 #include <UtilitiesGeometry.h>
 
@@ -59,3 +63,264 @@ void Gauss::elementsFromGrid(Eigen::RowVector3i res, Eigen::MatrixXd &V, Eigen::
     }
     
 }
+
+//spread the lower 21 bits of x so there are two zero bits between each one
+static inline uint64_t spreadBits(uint64_t x) {
+    
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    
+    return x;
+}
+
+Eigen::Matrix<uint64_t, Eigen::Dynamic, 1> Gauss::mortonCodes(const Eigen::MatrixXd &P) {
+    
+    Eigen::Matrix<uint64_t, Eigen::Dynamic, 1> codes(P.rows());
+    
+    if(P.rows() == 0) {
+        return codes;
+    }
+    
+    Eigen::RowVectorXd minP = P.colwise().minCoeff();
+    Eigen::RowVectorXd extent = P.colwise().maxCoeff() - minP;
+    
+    //uniform scale so the curve isn't stretched along thin directions
+    double scale = (extent.maxCoeff() > 0 ? static_cast<double>((1 << 21) - 1)/extent.maxCoeff() : 0.0);
+    
+    for(unsigned int ii=0; ii<P.rows(); ++ii) {
+        
+        uint64_t code = 0;
+        
+        for(unsigned int jj=0; jj<std::min<unsigned int>(P.cols(), 3); ++jj) {
+            code |= spreadBits(static_cast<uint64_t>((P(ii,jj) - minP(jj))*scale)) << jj;
+        }
+        
+        codes[ii] = code;
+    }
+    
+    return codes;
+}
+
+//order of the indices sorting codes, ties keep their original order
+static std::vector<int> sortByCode(const Eigen::Matrix<uint64_t, Eigen::Dynamic, 1> &codes) {
+    
+    std::vector<int> order(codes.rows());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&codes](int a, int b) { return codes[a] < codes[b]; });
+    
+    return order;
+}
+
+//reverse Cuthill-McKee, each connected component starts from a pseudo-peripheral vertex (George-Liu)
+static std::vector<int> reverseCuthillMcKee(unsigned int numVertices, const Eigen::MatrixXi &F) {
+    
+    //vertex graph in compressed row format
+    std::vector<std::vector<int> > neighbours(numVertices);
+    
+    for(unsigned int iel=0; iel<F.rows(); ++iel) {
+        for(unsigned int ii=0; ii<F.cols(); ++ii) {
+            for(unsigned int jj=0; jj<F.cols(); ++jj) {
+                if(ii != jj) {
+                    neighbours[F(iel,ii)].push_back(F(iel,jj));
+                }
+            }
+        }
+    }
+    
+    for(auto &n : neighbours) {
+        std::sort(n.begin(), n.end());
+        n.erase(std::unique(n.begin(), n.end()), n.end());
+    }
+    
+    std::vector<int> order, level(numVertices, -1);
+    std::vector<bool> visited(numVertices, false);
+    order.reserve(numVertices);
+    
+    //breadth first search from root over unvisited vertices, returns the vertices of the last level
+    auto levels = [&](int root, std::vector<int> &last) {
+        
+        std::vector<int> touched, front(1, root), next;
+        level[root] = 0;
+        touched.push_back(root);
+        
+        int depth = 0;
+        
+        while(front.size() > 0) {
+            
+            last = front;
+            next.clear();
+            
+            for(auto v : front) {
+                for(auto n : neighbours[v]) {
+                    if(!visited[n] && level[n] < 0) {
+                        level[n] = depth+1;
+                        next.push_back(n);
+                        touched.push_back(n);
+                    }
+                }
+            }
+            
+            front.swap(next);
+            ++depth;
+        }
+        
+        for(auto v : touched) {
+            level[v] = -1;
+        }
+        
+        return depth;
+    };
+    
+    for(unsigned int start=0; start<numVertices; ++start) {
+        
+        if(visited[start]) {
+            continue;
+        }
+        
+        //pseudo-peripheral root, move to the lowest degree vertex of the last level while the eccentricity grows
+        int root = start;
+        std::vector<int> last;
+        int depth = levels(root, last);
+        
+        while(true) {
+            
+            int candidate = *std::min_element(last.begin(), last.end(), [&neighbours](int a, int b) { return neighbours[a].size() < neighbours[b].size(); });
+            int candidateDepth = levels(candidate, last);
+            
+            if(candidateDepth <= depth) {
+                break;
+            }
+            
+            root = candidate;
+            depth = candidateDepth;
+        }
+        
+        //Cuthill-McKee, neighbours visited in order of increasing degree
+        std::queue<int> queue;
+        queue.push(root);
+        visited[root] = true;
+        
+        std::vector<int> next;
+        
+        while(!queue.empty()) {
+            
+            int v = queue.front();
+            queue.pop();
+            order.push_back(v);
+            
+            next.clear();
+            
+            for(auto n : neighbours[v]) {
+                if(!visited[n]) {
+                    visited[n] = true;
+                    next.push_back(n);
+                }
+            }
+            
+            std::sort(next.begin(), next.end(), [&neighbours](int a, int b) { return neighbours[a].size() < neighbours[b].size(); });
+            
+            for(auto n : next) {
+                queue.push(n);
+            }
+        }
+    }
+    
+    std::reverse(order.begin(), order.end());
+    
+    return order;
+}
+
+Gauss::MeshPermutation Gauss::reorderMesh(Eigen::MatrixXd &V, Eigen::MatrixXi &F, MeshOrdering ordering) {
+    
+    MeshPermutation perm;
+    
+    //vertices
+    std::vector<int> vertexOrder;
+    
+    if(ordering == MeshOrdering::Morton) {
+        vertexOrder = sortByCode(mortonCodes(V));
+    } else if(ordering == MeshOrdering::RCM) {
+        vertexOrder = reverseCuthillMcKee(V.rows(), F);
+    } else {
+        vertexOrder.resize(V.rows());
+        std::iota(vertexOrder.begin(), vertexOrder.end(), 0);
+    }
+    
+    perm.vertexNewToOld = Eigen::Map<Eigen::VectorXi>(vertexOrder.data(), vertexOrder.size());
+    perm.vertexOldToNew.resize(V.rows());
+    
+    for(unsigned int ii=0; ii<perm.vertexNewToOld.rows(); ++ii) {
+        perm.vertexOldToNew[perm.vertexNewToOld[ii]] = ii;
+    }
+    
+    Eigen::MatrixXd newV(V.rows(), V.cols());
+    
+    for(unsigned int ii=0; ii<newV.rows(); ++ii) {
+        newV.row(ii) = V.row(perm.vertexNewToOld[ii]);
+    }
+    
+    V = newV;
+    
+    //elements by centroid, vertex order within an element is kept so orientation doesn't change
+    Eigen::MatrixXd centroids = Eigen::MatrixXd::Zero(F.rows(), V.cols());
+    
+    for(unsigned int iel=0; iel<F.rows(); ++iel) {
+        for(unsigned int ii=0; ii<F.cols(); ++ii) {
+            F(iel,ii) = perm.vertexOldToNew[F(iel,ii)];
+            centroids.row(iel) += V.row(F(iel,ii));
+        }
+    }
+    
+    std::vector<int> elementOrder = sortByCode(mortonCodes(centroids));
+    
+    perm.elementNewToOld = Eigen::Map<Eigen::VectorXi>(elementOrder.data(), elementOrder.size());
+    perm.elementOldToNew.resize(F.rows());
+    
+    Eigen::MatrixXi newF(F.rows(), F.cols());
+    
+    for(unsigned int iel=0; iel<newF.rows(); ++iel) {
+        newF.row(iel) = F.row(perm.elementNewToOld[iel]);
+        perm.elementOldToNew[perm.elementNewToOld[iel]] = iel;
+    }
+    
+    F = newF;
+    
+    return perm;
+}
+
+Eigen::MatrixXd Gauss::MeshPermutation::toOriginalVertexOrder(const Eigen::MatrixXd &data) const {
+    
+    Eigen::MatrixXd original(data.rows(), data.cols());
+    
+    for(unsigned int ii=0; ii<data.rows(); ++ii) {
+        original.row(vertexNewToOld[ii]) = data.row(ii);
+    }
+    
+    return original;
+}
+
+Eigen::VectorXd Gauss::MeshPermutation::toOriginalDOFOrder(const Eigen::VectorXd &data, unsigned int dofsPerVertex) const {
+    
+    Eigen::VectorXd original(data.rows());
+    
+    for(unsigned int ii=0; ii<vertexNewToOld.rows(); ++ii) {
+        original.segment(dofsPerVertex*vertexNewToOld[ii], dofsPerVertex) = data.segment(dofsPerVertex*ii, dofsPerVertex);
+    }
+    
+    return original;
+}
+
+Eigen::MatrixXd Gauss::MeshPermutation::toOriginalElementOrder(const Eigen::MatrixXd &data) const {
+    
+    Eigen::MatrixXd original(data.rows(), data.cols());
+    
+    for(unsigned int iel=0; iel<data.rows(); ++iel) {
+        original.row(elementNewToOld[iel]) = data.row(iel);
+    }
+    
+    return original;
+}
@@ -23,8 +23,10 @@
 #include <MatOp/SparseGenMatProd.h>
 #include <MatOp/SparseCholesky.h>
 #include <MatOp/SparseSymShiftSolve.h>
+#include <SymEigsSolver.h>
 #include <SymGEigsSolver.h>
 #include <stdexcept>
+#include <limits>
 
 //some useful types
 namespace Eigen {
@@ -197,25 +199,82 @@ namespace Spectra {
     ///
     /// \ingroup MatOp
     ///
-    /// This class defines the shift-solve operation on a sparse real symmetric matrix \f$A\f$,
-    /// i.e., calculating \f$y=(A-\sigma I)^{-1}x\f$ for any real \f$\sigma\f$ and
-    /// vector \f$x\f$. It is mainly used in the SymEigsShiftSolver eigen solver.
+    /// This class defines the shift-invert operation for the generalized problem \f$Kx=\lambda Mx\f$ with
+    /// \f$K\f$ symmetric positive semi-definite and \f$M\f$ symmetric positive definite.
+    /// \f$K+\sigma M = G^T G\f$ is factored once (\f$G = D^{1/2}L^TP\f$ from a sparse LDLT) and the operator
+    /// \f$y = G^{-T}MG^{-1}x\f$ is symmetric so it can be used with SymEigsSolver. Its eigenvalues are
+    /// \f$\mu = 1/(\lambda+\sigma)\f$ and its eigenvectors are \f$Gx\f$.
+    ///
+    /// The symbolic factorization is kept as long as the sparsity pattern doesn't change and the numeric
+    /// factorization is skipped altogether when the matrices and shift are the same as in the last call.
     ///
     template <typename Scalar, int Uplo = Eigen::Lower, int Flags = 0, typename StorageIndex = int>
     class SparseSymMassShiftSolve
     {
     private:
         typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+        typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> Matrix;
         typedef Eigen::Map<const Vector> MapConstVec;
         typedef Eigen::Map<Vector> MapVec;
         typedef Eigen::SparseMatrix<Scalar, Flags, StorageIndex> SparseMatrix;
         
-        const SparseMatrix m_stiffnessMat, m_massMat;
-        const int m_n;
+        SparseMatrix m_stiffnessMat, m_massMat, m_shiftedMat;
+        int m_n;
+        Scalar m_shift;
+        bool m_analyzed, m_factored;
         Eigen::SimplicialLDLT<SparseMatrix, Uplo> m_solver;
+        Vector m_sqrtD;
+        
+        //same nonzero structure as the last factored matrix ?
+        bool samePattern(const SparseMatrix &A) const {
+            if(!m_analyzed || A.rows() != m_shiftedMat.rows() || A.nonZeros() != m_shiftedMat.nonZeros()) {
+                return false;
+            }
+            
+            return std::equal(A.outerIndexPtr(), A.outerIndexPtr() + A.outerSize() + 1, m_shiftedMat.outerIndexPtr()) &&
+                   std::equal(A.innerIndexPtr(), A.innerIndexPtr() + A.nonZeros(), m_shiftedMat.innerIndexPtr());
+        }
         
+        void checkSizes(const SparseMatrix& stiffnessMat_, const SparseMatrix &massMat_) const {
+            if(stiffnessMat_.rows() != stiffnessMat_.cols() || massMat_.rows() != massMat_.cols())
+                throw std::invalid_argument("SparseSymMassShiftSolve: matrices must be square");
+            
+            if(stiffnessMat_.rows() != massMat_.rows()) {
+                throw std::invalid_argument("SparseSymMassShiftSolve: matrices must be the same size");
+            }
+        }
+        
+        void factor() {
+            
+            SparseMatrix shifted = m_stiffnessMat + m_shift*m_massMat;
+            shifted.makeCompressed();
+            
+            if(m_factored && samePattern(shifted) &&
+               std::equal(shifted.valuePtr(), shifted.valuePtr() + shifted.nonZeros(), m_shiftedMat.valuePtr())) {
+                return;
+            }
+            
+            if(!samePattern(shifted)) {
+                m_solver.analyzePattern(shifted);
+                m_analyzed = true;
+            }
+            
+            m_solver.factorize(shifted);
+            m_shiftedMat = shifted;
+            
+            if(m_solver.info()!=Eigen::Success || (m_solver.vectorD().array() <= 0).any()) {
+                std::cout<<"Mass Shift: decomposition failed, K + shift*M must be positive definite \n";
+                exit(1);
+            }
+            
+            m_sqrtD = m_solver.vectorD().array().sqrt();
+            m_factored = true;
+        }
         
     public:
+        
+        SparseSymMassShiftSolve() : m_n(0), m_shift(0), m_analyzed(false), m_factored(false) { }
+        
         ///
         /// Constructor to create the matrix operation object.
         ///
@@ -224,14 +283,22 @@ namespace Spectra {
         ///
         SparseSymMassShiftSolve(const SparseMatrix& stiffnessMat_, const SparseMatrix &massMat_) :
         m_stiffnessMat(stiffnessMat_), m_massMat(massMat_),
-        m_n(massMat_.rows())
+        m_n(massMat_.rows()), m_shift(0), m_analyzed(false), m_factored(false)
         {
-            if(stiffnessMat_.rows() != stiffnessMat_.cols() || massMat_.rows() != massMat_.cols())
-                throw std::invalid_argument("SparseSymMassShiftSolve: matrices must be square");
-            
-            if(stiffnessMat_.rows() != massMat_.rows()) {
-                throw std::invalid_argument("SparseSymMassShiftSolve: matrices must be the same size");
-            }
+            checkSizes(stiffnessMat_, massMat_);
+        }
+        
+        ///
+        /// Replace the matrices and shift and refactor, reusing whatever is still valid from the last factorization.
+        ///
+        void compute(const SparseMatrix& stiffnessMat_, const SparseMatrix &massMat_, Scalar sigma)
+        {
+            checkSizes(stiffnessMat_, massMat_);
+            m_stiffnessMat = stiffnessMat_;
+            m_massMat = massMat_;
+            m_n = massMat_.rows();
+            m_shift = sigma;
+            factor();
         }
         
         ///
@@ -243,38 +310,259 @@ namespace Spectra {
         ///
         int cols() const { return m_n; }
         
+        inline const SparseMatrix & stiffness() const { return m_stiffnessMat; }
+        inline const SparseMatrix & mass() const { return m_massMat; }
+        inline Scalar shift() const { return m_shift; }
+        
         ///
         /// Set the real shift \f$\sigma\f$.
         ///
         void set_shift(Scalar sigma)
         {
-            //sadly there's no simple setShit here
-            m_solver.compute(m_stiffnessMat+sigma*m_massMat);
+            m_shift = sigma;
+            factor();
+        }
+        
+        ///
+        /// Map from the operator's eigenvectors back to generalized eigenvectors, \f$x = G^{-1}y\f$ (columnwise).
+        ///
+        Matrix fromOperatorSpace(const Matrix &Y) const
+        {
+            Matrix X = m_sqrtD.cwiseInverse().asDiagonal()*Y;
+            m_solver.matrixU().solveInPlace(X);
             
-            if(m_solver.info()!=Eigen::Success) {
-                std::cout<<"Mass Shift: decomposition failed \n";
-                exit(1);
+            if(m_solver.permutationPinv().size() > 0) {
+                X = m_solver.permutationPinv()*X;
+            }
+            
+            return X;
+        }
+        
+        ///
+        /// Map generalized eigenvectors to the operator's space, \f$y = Gx\f$ (columnwise).
+        ///
+        Matrix toOperatorSpace(const Matrix &X) const
+        {
+            Matrix Y = X;
+            
+            if(m_solver.permutationP().size() > 0) {
+                Y = m_solver.permutationP()*X;
             }
+            
+            //L is unit lower triangular, only the strictly lower part is stored
+            Y += m_solver.matrixL().nestedExpression().transpose()*Y;
+            return m_sqrtD.asDiagonal()*Y;
+        }
+        
+        ///
+        /// Block shift-invert step \f$(K+\sigma M)^{-1}MX\f$, all columns against the cached factors.
+        ///
+        Matrix solveShifted(const Matrix &X) const
+        {
+            return m_solver.solve(m_massMat*X);
         }
         
         ///
-        /// Perform the shift-solve operation \f$y=(A-\sigma I)^{-1}x\f$.
+        /// Perform the shift-solve operation \f$y=G^{-T}MG^{-1}x\f$.
         ///
         /// \param x_in  Pointer to the \f$x\f$ vector.
         /// \param y_out Pointer to the \f$y\f$ vector.
         ///
-        // y_out = inv(A - sigma * I) * x_in
         void perform_op(const Scalar* x_in, Scalar* y_out) const
         {
             MapConstVec x(x_in,  m_n);
             MapVec      y(y_out, m_n);
-            y.noalias() = m_solver.solve(m_massMat*x);
+            
+            Vector t = x.cwiseQuotient(m_sqrtD);
+            m_solver.matrixU().solveInPlace(t);
+            
+            if(m_solver.permutationPinv().size() > 0) {
+                t = m_solver.permutationPinv()*t;
+            }
+            
+            t = m_massMat*t;
+            
+            if(m_solver.permutationP().size() > 0) {
+                t = m_solver.permutationP()*t;
+            }
+            
+            m_solver.matrixL().solveInPlace(t);
+            y.noalias() = t.cwiseQuotient(m_sqrtD);
         }
     };
     
     
 } // namespace Spectra
 
+namespace Gauss {
+    
+    //Shift-invert solver for the generalized eigenvalue problem A x = lambda B x that is meant to be called repeatedly
+    //(i.e every time step). Same conventions as generalizedEigenvalueProblem(A, B, numVecs, shift): A is the (negative semi-definite)
+    //stiffness matrix, B the mass matrix, eigenvalues are returned smallest magnitude first and eigenvectors are B-normalized.
+    //Between calls it keeps
+    //1. The factorization of -A + shift*B (symbolic part reused if the pattern is unchanged, numeric part if the values are too)
+    //2. The previous eigenvectors (plus a few guard vectors), which warm start a block shift-invert iteration. Only if that
+    //   doesn't converge in a few steps does it fall back to Lanczos (Spectra), started from the previous eigenvectors.
+    template<typename DataType>
+    class GeneralizedEigenSolverShiftInvert
+    {
+    public:
+        
+        //tol is the relative residual of the warm started eigenpairs, the Ritz values are accurate to roughly tol^2
+        GeneralizedEigenSolverShiftInvert(unsigned int maxWarmIterations = 10, DataType tol = 1e-6) {
+            m_maxWarmIterations = maxWarmIterations;
+            m_tol = tol;
+            m_numWarmIterations = 0;
+            m_normK = 0;
+        }
+        
+        template<int Flags, typename Indices>
+        std::pair<Eigen::MatrixXx<DataType>, Eigen::VectorXx<DataType> > compute(const Eigen::SparseMatrix<DataType, Flags, Indices> &A,
+                                                                                 const Eigen::SparseMatrix<DataType, Flags,Indices> &B,
+                                                                                 unsigned int numVecs, DataType shift);
+        
+        //forget the previous eigenvectors
+        inline void reset() { m_X.resize(0,0); }
+        
+        //number of block iterations used by the last call (0 means Lanczos was used)
+        inline unsigned int getNumWarmIterations() const { return m_numWarmIterations; }
+        
+    protected:
+        
+        //Rayleigh-Ritz on the columns of X, returns true if the first numVecs Ritz pairs have converged
+        bool rayleighRitz(Eigen::MatrixXx<DataType> &X, Eigen::VectorXx<DataType> &lambda, unsigned int numVecs);
+        
+        unsigned int m_maxWarmIterations, m_numWarmIterations;
+        DataType m_tol, m_normK;
+        
+        Spectra::SparseSymMassShiftSolve<DataType> m_op;
+        Eigen::MatrixXx<DataType> m_X; //previous eigenvectors including guard vectors, B-orthonormal
+        
+    private:
+    };
+    
+    template<typename DataType>
+    bool GeneralizedEigenSolverShiftInvert<DataType>::rayleighRitz(Eigen::MatrixXx<DataType> &X, Eigen::VectorXx<DataType> &lambda, unsigned int numVecs) {
+        
+        Eigen::MatrixXx<DataType> KX = m_op.stiffness()*X;
+        Eigen::MatrixXx<DataType> MX = m_op.mass()*X;
+        Eigen::MatrixXx<DataType> Kr = X.transpose()*KX;
+        Eigen::MatrixXx<DataType> Mr = X.transpose()*MX;
+        
+        Kr = 0.5*(Kr + Kr.transpose()).eval();
+        Mr = 0.5*(Mr + Mr.transpose()).eval();
+        
+        Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXx<DataType> > ritz(Kr, Mr);
+        
+        if(ritz.info() != Eigen::Success) {
+            return false;
+        }
+        
+        //ascending order, smallest eigenvalues first which is what the shift targets
+        X = X*ritz.eigenvectors();
+        KX = KX*ritz.eigenvectors();
+        MX = MX*ritz.eigenvectors();
+        lambda = ritz.eigenvalues();
+        
+        for(unsigned int ii=0; ii<numVecs; ++ii) {
+            //relative to the eigenvalue + shift, with a floor at round off in K*x for (near) zero modes
+            DataType scale = m_tol*(std::fabs(lambda[ii]) + std::fabs(m_op.shift()))*MX.col(ii).norm() +
+                             100*std::numeric_limits<DataType>::epsilon()*m_normK*X.col(ii).norm();
+            
+            if((KX.col(ii) - lambda[ii]*MX.col(ii)).norm() > scale) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    template<typename DataType>
+    template<int Flags, typename Indices>
+    std::pair<Eigen::MatrixXx<DataType>, Eigen::VectorXx<DataType> > GeneralizedEigenSolverShiftInvert<DataType>::compute(const Eigen::SparseMatrix<DataType, Flags, Indices> &A,
+                                                                                                                             const Eigen::SparseMatrix<DataType, Flags,Indices> &B,
+                                                                                                                             unsigned int numVecs, DataType shift) {
+        
+        //Spectra seems to freak out if you use row storage, this copy just ensures everything is setup the way the solver likes
+        Eigen::SparseMatrix<DataType> K = -A;
+        Eigen::SparseMatrix<DataType> M = B;
+        
+        m_op.compute(K, M, shift);
+        
+        //infinity norm of K (symmetric so max column sum works too)
+        m_normK = 0;
+        for(unsigned int ii=0; ii<K.outerSize(); ++ii) {
+            DataType colSum = 0;
+            for(typename Eigen::SparseMatrix<DataType>::InnerIterator it(K, ii); it; ++it) {
+                colSum += std::fabs(it.value());
+            }
+            m_normK = std::max(m_normK, colSum);
+        }
+        
+        unsigned int n = M.rows();
+        
+        //guard vectors speed up convergence of the last requested modes (block size min(2m, m+8) as in classic subspace iteration)
+        unsigned int numGuard = std::min(std::min(numVecs, 8u), n - std::min(n, numVecs + 1));
+        unsigned int blockSize = numVecs + numGuard;
+        
+        Eigen::VectorXx<DataType> lambda;
+        bool converged = false;
+        
+        m_numWarmIterations = 0;
+        
+        //warm start, block shift-invert iteration from the previous eigenvectors
+        if(m_X.rows() == n && m_X.cols() == blockSize) {
+            
+            Eigen::MatrixXx<DataType> X = m_X;
+            converged = rayleighRitz(X, lambda, numVecs);
+            
+            while(!converged && m_numWarmIterations < m_maxWarmIterations) {
+                X = m_op.solveShifted(X);
+                converged = rayleighRitz(X, lambda, numVecs);
+                ++m_numWarmIterations;
+            }
+            
+            if(converged) {
+                m_X = X;
+            }
+        }
+        
+        if(!converged) {
+            
+            m_numWarmIterations = 0;
+            
+            unsigned int ncv = std::min(n, std::max(2*blockSize+1, 5*numVecs));
+            Spectra::SymEigsSolver<DataType, Spectra::LARGEST_ALGE, Spectra::SparseSymMassShiftSolve<DataType> > eigs(&m_op, blockSize, ncv);
+            
+            //start Lanczos from the span of the previous eigenvectors if we have them
+            if(m_X.rows() == n && m_X.cols() > 0) {
+                Eigen::VectorXx<DataType> resid = m_op.toOperatorSpace(m_X).rowwise().sum();
+                eigs.init(resid.data());
+            } else {
+                eigs.init();
+            }
+            
+            eigs.compute();
+            
+            if(eigs.info() != Spectra::SUCCESSFUL) {
+                std::cout<<"Failure: "<<eigs.info()<<"\n";
+                exit(1);
+            }
+            
+            m_X = m_op.fromOperatorSpace(eigs.eigenvectors());
+            lambda.resize(m_X.cols());
+            
+            //mu = 1/(lambda + shift), magnitude of eigenvectors is wrong in operator space
+            for(unsigned int ii=0; ii<m_X.cols(); ++ii) {
+                lambda[ii] = static_cast<DataType>(1)/eigs.eigenvalues()[ii] - shift;
+                m_X.col(ii) /= std::sqrt(m_X.col(ii).dot(M*m_X.col(ii)));
+            }
+        }
+        
+        return std::make_pair(Eigen::MatrixXx<DataType>(m_X.leftCols(numVecs)), Eigen::VectorXx<DataType>(-lambda.head(numVecs)));
+    }
+}
+
 //solve sparse generalized eigenvalue problem using spectra
 //solve the gevp Ax = lambda*Bx
 template<typename DataType, int Flags, typename Indices>
@@ -315,52 +603,14 @@ auto generalizedEigenvalueProblem(const Eigen::SparseMatrix<DataType, Flags, Ind
 }
 
 //use shift and invert to find Eigenvalues near the shift
+//for repeated solves keep a Gauss::GeneralizedEigenSolverShiftInvert around instead, it reuses the factorization and warm starts
 template<typename DataType, int Flags, typename Indices>
 auto generalizedEigenvalueProblem(const Eigen::SparseMatrix<DataType, Flags, Indices> &A,
                                   const Eigen::SparseMatrix<DataType, Flags,Indices> &B,
                                   unsigned int numVecs, DataType shift) {
     
-    //Spectra seems to freak out if you use row storage, this copy just ensures everything is setup the way the solver likes
-    Eigen::SparseMatrix<DataType> K = -A + shift*B;
-    Eigen::SparseMatrix<DataType> M = B;
-    
-    //Spectra::SparseSymMassShiftSolve<DataType> Aop(K, M);
-    //Aop.set_shift(shift);
-    Spectra::SparseSymMatProd<DataType> Aop(M);
-    Spectra::SparseCholesky<DataType> Bop(K);
-    
-    // Construct eigen solver object, requesting the smallest three eigenvalues
-    Spectra::SymGEigsSolver<DataType, Spectra::LARGEST_MAGN, Spectra::SparseSymMatProd<DataType>, Spectra::SparseCholesky<DataType>, Spectra::GEIGS_CHOLESKY > eigs(&Aop, &Bop, numVecs, 5*numVecs);
-    
-    
-    //Spectra::GenEigsShiftSolver<double, Spectra::LARGEST_MAGN,  Spectra::SparseSymMassShiftSolve<DataType> > eigs(&Aop, numVecs, 5*numVecs, shift);
-    
-    // Initialize and compute
-    eigs.init();
-    eigs.compute();
-    Eigen::VectorXx<DataType> eigsCorrected;
-    Eigen::MatrixXx<DataType> evsCorrected; //magnitude of eigenvectors can be wrong in this formulation
-    eigsCorrected.resize(eigs.eigenvalues().rows());
-    evsCorrected.resize(eigs.eigenvectors().rows(), eigs.eigenvectors().cols());
-
-    
-    // Retrieve results
-    evsCorrected = eigs.eigenvectors();
-    
-    if(eigs.info() == Spectra::SUCCESSFUL) {
-        //correct eigenvalues
-        for(unsigned int ii=0; ii<eigs.eigenvalues().rows(); ++ii) {
-            eigsCorrected[ii] = -(static_cast<DataType>(1)/(eigs.eigenvalues()[ii]) + shift);
-            evsCorrected.col(ii) /= sqrt(eigs.eigenvectors().col(ii).transpose()*M*eigs.eigenvectors().col(ii));
-        }
-        
-        return std::make_pair(evsCorrected, eigsCorrected);
-    } else {
-        std::cout<<"Failure: "<<eigs.info()<<"\n";
-        exit(1);
-        return std::make_pair(eigs.eigenvectors(), eigs.eigenvalues());
-    }
-    
+    Gauss::GeneralizedEigenSolverShiftInvert<DataType> solver;
+    return solver.compute(A, B, numVecs, shift);
 }
 
 #endif /* UtilitiesEigen_h */
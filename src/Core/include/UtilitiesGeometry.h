@@ -9,6 +9,7 @@
 #ifndef UtilitiesGeometry_h
 #define UtilitiesGeometry_h
 
+#include <cstdint>
 #include <UtilitiesEigen.h>
 #include <igl/grid.h>
 
@@ -16,6 +17,33 @@ namespace Gauss {
 
     void elementsFromGrid(Eigen::RowVector3i res, Eigen::MatrixXd &V, Eigen::MatrixXi &F);
     
+    //Mesh reordering for cache locality and matrix bandwidth, apply before building the physical system
+    //Morton : vertices sorted along a z-order curve through the bounding box
+    //RCM    : reverse Cuthill-McKee on the vertex graph (vertices sharing an element), lowest bandwidth
+    enum class MeshOrdering { None, Morton, RCM };
+    
+    //new to old and old to new maps, newV.row(i) = oldV.row(vertexNewToOld[i]), newF.row(e) = oldF.row(elementNewToOld[e]) relabeled
+    struct MeshPermutation {
+        
+        Eigen::VectorXi vertexNewToOld, vertexOldToNew;
+        Eigen::VectorXi elementNewToOld, elementOldToNew;
+        
+        //per vertex data (one row per vertex) back in the order of the file
+        Eigen::MatrixXd toOriginalVertexOrder(const Eigen::MatrixXd &data) const;
+        
+        //stacked per vertex vectors (i.e. q or qDot of the FEM system) back in the order of the file
+        Eigen::VectorXd toOriginalDOFOrder(const Eigen::VectorXd &data, unsigned int dofsPerVertex = 3) const;
+        
+        //per element data (one row per element) back in the order of the file
+        Eigen::MatrixXd toOriginalElementOrder(const Eigen::MatrixXd &data) const;
+    };
+    
+    //reorders V and F in place, elements are always sorted by the Morton code of their centroid
+    MeshPermutation reorderMesh(Eigen::MatrixXd &V, Eigen::MatrixXi &F, MeshOrdering ordering = MeshOrdering::RCM);
+    
+    //sort keys along a z-order curve for a set of points (one per row)
+    Eigen::Matrix<uint64_t, Eigen::Dynamic, 1> mortonCodes(const Eigen::MatrixXd &P);
+    
 }
 
 #endif /* UtilitiesGeometry_h */
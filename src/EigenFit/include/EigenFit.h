@@ -269,7 +269,7 @@ public:
 
         // matrices passed in already eliminated the constraints
         // Eigendecomposition for the coarse mesh
-        m_coarseUs = generalizedEigenvalueProblem((*coarseStiffnessMatrix), (*coarseMassMatrix), m_numModes, 1e-3);
+        m_coarseUs = m_coarseEigenSolver.compute((*coarseStiffnessMatrix), (*coarseMassMatrix), m_numModes, 1e-3);
         
         unsigned int mode = 0;
         unsigned int idx = 0;
@@ -344,7 +344,7 @@ public:
             
             //Eigendecomposition for the embedded fine mesh
             std::pair<Eigen::MatrixXx<double>, Eigen::VectorXx<double> > m_Us;
-            m_Us = generalizedEigenvalueProblem((*fineStiffnessMatrix), (*m_fineMassMatrix), m_numModes, 1e-3);
+            m_Us = m_fineEigenSolver.compute((*fineStiffnessMatrix), (*m_fineMassMatrix), m_numModes, 1e-3);
             
             mode = 0;
             name = "fine_eigen_mode";
@@ -582,6 +582,10 @@ protected:
     
     //num modes to correct
     unsigned int m_numModes;
+    
+    //eigensolvers keep their factorization and last modes around so per step solves are warm started
+    GeneralizedEigenSolverShiftInvert<double> m_coarseEigenSolver;
+    GeneralizedEigenSolverShiftInvert<double> m_fineEigenSolver;
     //    unsigned int m_numToCorrect;
     
     //Ratios diagonal matrix, stored as vector
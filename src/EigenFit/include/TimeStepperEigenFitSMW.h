@@ -20,6 +20,7 @@
 #include <UtilitiesMATLAB.h>
 #include <Eigen/SparseCholesky>
 #include <SolverPardiso.h>
+#include <SolverMultiRHS.h>
 #include <EigenFit.h>
 
 //TODO Solver Interface
@@ -194,12 +195,12 @@ void TimeStepperImplEigenFitSMWImpl<DataType, MatrixAssembler, VectorAssembler>:
     
 #ifdef GAUSS_PARDISO
 
-    m_pardiso.solve(Y);
-    Eigen::VectorXd bPrime = Y*(Eigen::MatrixXd::Identity(m_numModes,m_numModes) + Z*m_pardiso.getX()).ldlt().solve(Z*x0);
+    //all modes in one batched solve against the factors
+    Eigen::VectorXd bPrime = Y*(Eigen::MatrixXd::Identity(m_numModes,m_numModes) + Z*solveMultipleRHS(m_pardiso, Y)).ldlt().solve(Z*x0);
     
     
 #else
-    Eigen::VectorXd bPrime = Y*(Eigen::MatrixXd::Identity(m_numModes,m_numModes) + Z*solver.solve(Y)).ldlt().solve(Z*x0);
+    Eigen::VectorXd bPrime = Y*(Eigen::MatrixXd::Identity(m_numModes,m_numModes) + Z*solveMultipleRHS(solver, Y)).ldlt().solve(Z*x0);
     
 #endif
 
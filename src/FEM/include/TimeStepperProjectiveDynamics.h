@@ -0,0 +1,403 @@
+//
+//  TimeStepperProjectiveDynamics.h
+//  Gauss
+//
+//  Projective Dynamics (Bouaziz et al. 2014) for tetrahedral FEM systems
+//
+//
+
+#ifndef TimeStepperProjectiveDynamics_h
+#define TimeStepperProjectiveDynamics_h
+
+#include <array>
+#include <vector>
+#include <World.h>
+#include <Assembler.h>
+#include <TimeStepper.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <UtilitiesEigen.h>
+#include <SolverPardiso.h>
+
+namespace Gauss {
+
+    //Lame mu of an element's material, neohookean type energies store C = mu/2, linear elasticity stores E and nu (as getMu())
+    template<typename Element>
+    inline auto lameMu(Element &element, int i) -> decltype(2.0*element.getC()) { return 2.0*element.getC(); }
+
+    template<typename Element>
+    inline auto lameMu(Element &element, long i) -> decltype(element.getE()/(2.0*(1.0 + element.getMu()))) { return element.getE()/(2.0*(1.0 + element.getMu())); }
+
+    //Each iteration projects the deformation gradient of every tet onto the closest rotation (local step, embarassingly parallel)
+    //and then solves (M/dt^2 + L) q = M*y/dt^2 + sum w*G'*(R - I) (global step) where L = sum w*G'*G only depends on the rest shape.
+    //L is built from the tet connectivity and inverse rest shape matrices already stored in the FEM system so the global matrix
+    //is factored once and reused by every iteration of every step. It is rebuilt when dt, the number of DOFs or the constraints change.
+    //ConstraintFixedPoint constraints are enforced exactly by eliminating the fixed DOFs from the global solve.
+    //Elastic energy is ARAP with w = 2*mu*volume where mu is the Lame parameter of each element's material, so this is meant for
+    //worlds containing tet FEM systems of type FEMSystem (and external forces), the element energy itself is ignored.
+    //Every system in the world is simulated, all of them have to be FEMSystems.
+    template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+    class TimeStepperImplProjectiveDynamics
+    {
+    public:
+
+        TimeStepperImplProjectiveDynamics(unsigned int iterations = 10) {
+            m_iterations = iterations;
+            m_factored = false;
+            m_dt = 0;
+        }
+
+        TimeStepperImplProjectiveDynamics(const TimeStepperImplProjectiveDynamics &toCopy) {
+            m_iterations = toCopy.m_iterations;
+            m_factored = false;
+            m_dt = 0;
+        }
+
+        ~TimeStepperImplProjectiveDynamics() {
+            #ifdef GAUSS_PARDISO
+                if(m_factored) {
+                    m_pardiso.cleanup();
+                }
+            #endif
+        }
+
+        //Methods
+        template<typename World>
+        void step(World &world, double dt, double t);
+
+        //force the global matrix to be rebuilt on the next step (i.e after changing the mesh or the constraints)
+        inline void reset() { m_factored = false; }
+
+        inline void setNumIterations(unsigned int iterations) { m_iterations = iterations; }
+
+        inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
+
+    protected:
+
+        //build per tet data, the body forces, the fixed DOF elimination and factor the global matrix
+        template<typename World>
+        void factor(World &world, DataType dt);
+
+        //append the per tet data of a system
+        void addElements(FEMSystem *system);
+
+        template<typename System>
+        void addElements(System *system) {
+            std::cout<<"TimeStepperProjectiveDynamics only supports FEM systems \n";
+            exit(1);
+        }
+
+        DataType m_dt;
+        unsigned int m_iterations;
+        bool m_factored;
+        unsigned int m_numDOFs, m_numConstraints;
+
+        //per tet (of all systems): ARAP weight, shape function gradients (one per row) and global index of each vertex's first DOF
+        std::vector<DataType> m_weights;
+        std::vector<Eigen::Matrix<DataType, 4, 3>, Eigen::aligned_allocator<Eigen::Matrix<DataType, 4, 3> > > m_dphi;
+        std::vector<std::array<unsigned int, 4> > m_dofs;
+
+        //per tet w*(R - I)*dphi' from the last local step
+        std::vector<Eigen::Matrix<DataType, 3, 4>, Eigen::aligned_allocator<Eigen::Matrix<DataType, 3, 4> > > m_projections;
+
+        MatrixAssembler m_massMatrix;
+        MatrixAssembler m_constraintGradient;
+        VectorAssembler m_forceVector;
+        VectorAssembler m_constraintVelocity;
+
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_A; //M/dt^2 + L over all DOFs
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_P; //selects the free DOFs
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_J; //constraint gradient
+        Eigen::VectorXx<DataType> m_fBody;
+        Eigen::VectorXi m_isFixed;
+
+        //storage for lagrange multipliers
+        typename VectorAssembler::MatrixType m_lagrangeMultipliers;
+
+#ifdef GAUSS_PARDISO
+
+        SolverPardiso<Eigen::SparseMatrix<DataType, Eigen::RowMajor> > m_pardiso;
+
+#else
+
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > m_solver;
+
+#endif
+
+    private:
+    };
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void Gauss::TimeStepperImplProjectiveDynamics<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::factor(World &world, DataType dt) {
+
+    m_numDOFs = world.getNumQDotDOFs();
+    m_numConstraints = world.getNumConstraints();
+
+    //per tet data from the rest shape
+    m_weights.clear();
+    m_dphi.clear();
+    m_dofs.clear();
+
+    forEach(world.getSystemList(), [this](auto a) {
+        this->addElements(a);
+    });
+
+    m_projections.resize(m_weights.size());
+
+    std::vector<Eigen::Triplet<DataType> > triplets;
+    triplets.reserve(48*m_weights.size());
+
+    //L = w*G'*G, block (i,j) is w*(dphi_i.dphi_j)*I
+    for(unsigned int iel = 0; iel < m_weights.size(); ++iel) {
+        for(unsigned int ii=0; ii<4; ++ii) {
+            for(unsigned int jj=0; jj<4; ++jj) {
+                DataType lij = m_weights[iel]*m_dphi[iel].row(ii).dot(m_dphi[iel].row(jj));
+
+                for(unsigned int kk=0; kk<3; ++kk) {
+                    triplets.push_back(Eigen::Triplet<DataType>(m_dofs[iel][ii]+kk, m_dofs[iel][jj]+kk, lij));
+                }
+            }
+        }
+    }
+
+    Eigen::SparseMatrix<DataType, Eigen::RowMajor> L(m_numDOFs, m_numDOFs);
+    L.setFromTriplets(triplets.begin(), triplets.end());
+
+    MatrixAssembler &massMatrix = m_massMatrix;
+
+    ASSEMBLEMATINIT(massMatrix, m_numDOFs, m_numDOFs);
+    ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+    ASSEMBLEEND(massMatrix);
+
+    m_A = (1.0/(dt*dt))*(*m_massMatrix) + L;
+
+    //body forces are constant for linear tets, system forces at zero displacement leave only them (elastic forces vanish at rest)
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::VectorXx<DataType> qSaved = q;
+    q.setZero();
+
+    VectorAssembler &forceVector = m_forceVector;
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fBody = (*forceVector);
+    q = qSaved;
+
+    //every constraint row has to touch a single DOF (i.e fixed points), those DOFs are eliminated
+    m_isFixed.setZero(m_numDOFs);
+
+    if(m_numConstraints > 0) {
+
+        MatrixAssembler &constraintGradient = m_constraintGradient;
+
+        ASSEMBLEMATINIT(constraintGradient, m_numConstraints, m_numDOFs);
+        ASSEMBLELISTOFFSET(constraintGradient, world.getConstraintList(), getGradient, 0, 0);
+        ASSEMBLEEND(constraintGradient);
+
+        m_J = (*m_constraintGradient);
+
+        for(unsigned int ii=0; ii<m_J.outerSize(); ++ii) {
+
+            unsigned int nnz = 0;
+
+            for(typename Eigen::SparseMatrix<DataType, Eigen::RowMajor>::InnerIterator it(m_J, ii); it; ++it) {
+                if(it.value() != 0) {
+                    m_isFixed[it.col()] = 1;
+                    ++nnz;
+                }
+            }
+
+            if(nnz != 1) {
+                std::cout<<"TimeStepperProjectiveDynamics only supports fixed point constraints \n";
+                exit(1);
+            }
+        }
+    }
+
+    std::vector<Eigen::Triplet<DataType> > pTriplets;
+    unsigned int numFree = 0;
+
+    for(unsigned int ii=0; ii<m_numDOFs; ++ii) {
+        if(!m_isFixed[ii]) {
+            pTriplets.push_back(Eigen::Triplet<DataType>(numFree, ii, 1));
+            ++numFree;
+        }
+    }
+
+    m_P.resize(numFree, m_numDOFs);
+    m_P.setFromTriplets(pTriplets.begin(), pTriplets.end());
+
+    Eigen::SparseMatrix<DataType, Eigen::RowMajor> systemMatrix = m_P*m_A*m_P.transpose();
+
+#ifdef GAUSS_PARDISO
+    if(m_factored) {
+        m_pardiso.cleanup();
+    }
+
+    m_pardiso.symbolicFactorization(systemMatrix);
+    m_pardiso.numericalFactorization();
+#else
+    m_solver.compute(systemMatrix);
+
+    if(m_solver.info()!=Eigen::Success) {
+        // decomposition failed
+        assert(1 == 0);
+        std::cout<<"Decomposition Failed \n";
+        exit(1);
+    }
+#endif
+
+    m_dt = dt;
+    m_factored = true;
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+void Gauss::TimeStepperImplProjectiveDynamics<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::addElements(FEMSystem *system) {
+
+    auto &elements = system->getImpl().getElements();
+
+    for(unsigned int iel = 0; iel < elements.size(); ++iel) {
+
+        Eigen::Matrix<DataType, 3, 3> T = elements[iel]->getInvRefShapeMatrix();
+        Eigen::Matrix<DataType, 4, 3> dphi;
+
+        dphi.row(0) = -T.colwise().sum();
+        dphi.template bottomRows<3>() = T;
+
+        std::array<unsigned int, 4> dofs;
+
+        for(unsigned int ii=0; ii<4; ++ii) {
+            dofs[ii] = elements[iel]->q()[ii]->getGlobalId();
+        }
+
+        m_weights.push_back(2.0*lameMu(*elements[iel], 0)*elements[iel]->volume());
+        m_dphi.push_back(dphi);
+        m_dofs.push_back(dofs);
+    }
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void Gauss::TimeStepperImplProjectiveDynamics<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::step(World &world, double dt, double t) {
+
+    if(!m_factored || m_dt != dt || m_numDOFs != world.getNumQDotDOFs() || m_numConstraints != world.getNumConstraints()) {
+        factor(world, dt);
+    }
+
+    //Grab the state
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::Map<Eigen::VectorXx<DataType> > qDot = mapStateEigen<1>(world);
+
+    //external forces
+    VectorAssembler &forceVector = m_forceVector;
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getForceList(), getForce);
+    ASSEMBLEEND(forceVector);
+
+    //inertial term and initial guess
+    Eigen::VectorXx<DataType> qNew = q + dt*qDot;
+    Eigen::VectorXx<DataType> rhsInertia = (1.0/(dt*dt))*((*m_massMatrix)*qNew) + (*forceVector) + m_fBody;
+
+    //fixed DOFs move with the prescribed constraint velocity
+    Eigen::VectorXx<DataType> qFixed = Eigen::VectorXx<DataType>::Zero(m_numDOFs);
+
+    if(m_numConstraints > 0) {
+
+        VectorAssembler &constraintVelocity = m_constraintVelocity;
+
+        ASSEMBLEVECINIT(constraintVelocity, m_numConstraints);
+        ASSEMBLELISTOFFSET(constraintVelocity, world.getConstraintList(), getDbDt, 0, 0);
+        ASSEMBLEEND(constraintVelocity);
+
+        Eigen::VectorXx<DataType> vFixed = m_J.transpose()*(*m_constraintVelocity);
+
+        for(unsigned int ii=0; ii<m_numDOFs; ++ii) {
+            if(m_isFixed[ii]) {
+                qFixed[ii] = q[ii] + dt*vFixed[ii];
+            }
+        }
+    }
+
+    rhsInertia -= m_A*qFixed;
+    qNew = m_P.transpose()*(m_P*qNew) + qFixed;
+
+    Eigen::VectorXx<DataType> rhs, x0;
+
+    for(unsigned int iter = 0; iter < m_iterations; ++iter) {
+
+        //local step
+        #if defined(GAUSS_OPENMP)
+        #pragma omp parallel for
+        #endif
+        for(int iel = 0; iel < static_cast<int>(m_weights.size()); ++iel) {
+
+            Eigen::Matrix<DataType, 3, 4> qe;
+
+            for(unsigned int ii=0; ii<4; ++ii) {
+                qe.col(ii) = qNew.template segment<3>(m_dofs[iel][ii]);
+            }
+
+            Eigen::Matrix<DataType, 3, 3> F = Eigen::Matrix<DataType, 3, 3>::Identity() + qe*m_dphi[iel];
+
+            Eigen::JacobiSVD<Eigen::Matrix<DataType, 3, 3> > svd(F, Eigen::ComputeFullU | Eigen::ComputeFullV);
+            Eigen::Matrix<DataType, 3, 3> U = svd.matrixU();
+
+            //closest rotation, not reflection
+            if((U*svd.matrixV().transpose()).determinant() < 0) {
+                U.col(2) *= -1;
+            }
+
+            Eigen::Matrix<DataType, 3, 3> R = U*svd.matrixV().transpose();
+
+            m_projections[iel] = m_weights[iel]*(R - Eigen::Matrix<DataType, 3, 3>::Identity())*m_dphi[iel].transpose();
+        }
+
+        //global step
+        rhs = rhsInertia;
+
+        for(unsigned int iel = 0; iel < m_weights.size(); ++iel) {
+            for(unsigned int ii=0; ii<4; ++ii) {
+                rhs.template segment<3>(m_dofs[iel][ii]) += m_projections[iel].col(ii);
+            }
+        }
+
+#ifdef GAUSS_PARDISO
+        Eigen::VectorXx<DataType> rhsFree = m_P*rhs;
+        m_pardiso.solve(rhsFree);
+        x0 = m_pardiso.getX();
+#else
+        x0 = m_solver.solve(m_P*rhs);
+
+        if(m_solver.info()!=Eigen::Success) {
+            // solving failed
+            assert(1 == 0);
+            std::cout<<"Solve Failed \n";
+            exit(1);
+        }
+#endif
+
+        qNew = m_P.transpose()*x0 + qFixed;
+    }
+
+    //constraint impulses, consistent with the velocity level multipliers of the other steppers
+    if(m_numConstraints > 0) {
+        m_lagrangeMultipliers = -dt*(m_J*(m_A*qNew - rhs - m_A*qFixed));
+    } else {
+        m_lagrangeMultipliers.resize(0);
+    }
+
+    //update state
+    qDot = (qNew - q)/dt;
+    q = qNew;
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler = AssemblerParallel<DataType, AssemblerEigenSparseMatrix<DataType> >, typename VectorAssembler = AssemblerParallel<DataType, AssemblerEigenVector<DataType> > >
+using TimeStepperProjectiveDynamics = Gauss::TimeStepper<DataType, Gauss::TimeStepperImplProjectiveDynamics<DataType, FEMSystem, MatrixAssembler, VectorAssembler> >;
+
+#endif /* TimeStepperProjectiveDynamics_h */
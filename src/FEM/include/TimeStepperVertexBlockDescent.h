@@ -0,0 +1,442 @@
+//
+//  TimeStepperVertexBlockDescent.h
+//  Gauss
+//
+//  Vertex Block Descent (Chen et al. 2024) for FEM systems
+//
+//
+
+#ifndef TimeStepperVertexBlockDescent_h
+#define TimeStepperVertexBlockDescent_h
+
+#include <vector>
+#include <map>
+#include <World.h>
+#include <Assembler.h>
+#include <TimeStepper.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <UtilitiesEigen.h>
+
+namespace Gauss {
+
+    //Minimizes the implicit Euler incremental potential
+    //  G(x) = 1/(2*dt^2)*(x - y)'*M*(x - y) + E(x) - f_ext'*x,  y = q + dt*qDot
+    //by block coordinate descent: each vertex takes a 3x3 Newton step using the element forces and the diagonal blocks of the
+    //element stiffness matrices of its incident elements (M is lumped). Vertices are greedily colored so that no two vertices of
+    //the same color share an element, each color is updated in parallel. No global matrix is assembled or factored.
+    //Element stiffness matrices are evaluated once per sweep (at the state the sweep starts from) and only their diagonal vertex
+    //blocks are kept, forces are evaluated at the current state so the converged solution is unchanged.
+    //Body forces are precomputed, external forces are evaluated once per step at the start of step state.
+    //ConstraintFixedPoint constraints are enforced exactly by moving the fixed DOFs with their prescribed velocity.
+    //Iterations start from the inertia + external acceleration guess and can be Chebyshev accelerated with an estimate rho < 1 of
+    //the spectral radius of a sweep (rho = 0 turns acceleration off).
+    //sweep() can also be used on its own as a smoother (i.e in a multigrid cycle), it reduces G for the last step's y.
+    template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+    class TimeStepperImplVertexBlockDescent
+    {
+    public:
+
+        TimeStepperImplVertexBlockDescent(FEMSystem *system, unsigned int iterations = 20, DataType rho = 0) {
+            m_system = system;
+            m_iterations = iterations;
+            m_rho = rho;
+            m_initialized = false;
+        }
+
+        TimeStepperImplVertexBlockDescent(const TimeStepperImplVertexBlockDescent &toCopy) {
+            m_system = toCopy.m_system;
+            m_iterations = toCopy.m_iterations;
+            m_rho = toCopy.m_rho;
+            m_initialized = false;
+        }
+
+        ~TimeStepperImplVertexBlockDescent() { }
+
+        //Methods
+        template<typename World>
+        void step(World &world, double dt, double t);
+
+        //one Gauss-Seidel pass over all colors, updates the world positions in place
+        template<typename World>
+        void sweep(World &world, DataType dt);
+
+        //rebuild the coloring, lumped masses and constraints on the next step (i.e after changing the mesh or the constraints)
+        inline void reset() { m_initialized = false; }
+
+        inline void setNumIterations(unsigned int iterations) { m_iterations = iterations; }
+
+        inline unsigned int getNumColors() const { return m_colors.size(); }
+
+        inline typename VectorAssembler::MatrixType & getLagrangeMultipliers() { return m_lagrangeMultipliers; }
+
+    protected:
+
+        template<typename World>
+        void init(World &world);
+
+        FEMSystem *m_system;
+        unsigned int m_iterations;
+        DataType m_rho;
+        bool m_initialized;
+        unsigned int m_numDOFs, m_numConstraints;
+
+        //global index of the first DOF of each vertex, incident (element, local vertex) pairs in compressed row format
+        std::vector<unsigned int> m_vertexDOF;
+        std::vector<unsigned int> m_incidentStart;
+        std::vector<std::pair<unsigned int, unsigned int> > m_incident;
+
+        //position in m_incident of every (element, local vertex) pair, in element order, and the matching stiffness blocks
+        std::vector<unsigned int> m_elementStart;
+        std::vector<unsigned int> m_elementIncident;
+        std::vector<Eigen::Matrix<DataType, 3, 3> > m_blocks;
+
+        //vertex ids grouped by color
+        std::vector<std::vector<unsigned int> > m_colors;
+
+        Eigen::VectorXx<DataType> m_mass; //lumped, per DOF
+        Eigen::VectorXx<DataType> m_fBody;
+        Eigen::VectorXx<DataType> m_fExt; //body + external forces for this step
+        Eigen::VectorXx<DataType> m_y; //inertial target for this step
+        Eigen::VectorXi m_isFixed;
+        Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_J;
+
+        MatrixAssembler m_massMatrix;
+        MatrixAssembler m_constraintGradient;
+        VectorAssembler m_forceVector;
+        VectorAssembler m_constraintVelocity;
+
+        //storage for lagrange multipliers
+        typename VectorAssembler::MatrixType m_lagrangeMultipliers;
+
+    private:
+    };
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void Gauss::TimeStepperImplVertexBlockDescent<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::init(World &world) {
+
+    m_numDOFs = world.getNumQDotDOFs();
+    m_numConstraints = world.getNumConstraints();
+
+    auto &elements = m_system->getImpl().getElements();
+
+    //vertices and their incident elements
+    std::map<unsigned int, unsigned int> vertexIds;
+    std::vector<std::vector<unsigned int> > elementVertices(elements.size());
+
+    for(unsigned int iel = 0; iel < elements.size(); ++iel) {
+        for(unsigned int ii=0; ii<elements[iel]->q().size(); ++ii) {
+
+            unsigned int dof = elements[iel]->q()[ii]->getGlobalId();
+
+            if(vertexIds.find(dof) == vertexIds.end()) {
+                unsigned int id = vertexIds.size();
+                vertexIds[dof] = id;
+            }
+
+            elementVertices[iel].push_back(vertexIds[dof]);
+        }
+    }
+
+    unsigned int numVertices = vertexIds.size();
+
+    m_vertexDOF.resize(numVertices);
+
+    for(auto &vertex : vertexIds) {
+        m_vertexDOF[vertex.second] = vertex.first;
+    }
+
+    m_incidentStart.assign(numVertices+1, 0);
+
+    for(auto &vertices : elementVertices) {
+        for(auto vertex : vertices) {
+            ++m_incidentStart[vertex+1];
+        }
+    }
+
+    for(unsigned int ii=0; ii<numVertices; ++ii) {
+        m_incidentStart[ii+1] += m_incidentStart[ii];
+    }
+
+    m_incident.resize(m_incidentStart[numVertices]);
+    m_blocks.resize(m_incident.size());
+    m_elementStart.assign(1, 0);
+    m_elementIncident.clear();
+
+    std::vector<unsigned int> fill(m_incidentStart.begin(), m_incidentStart.end()-1);
+
+    for(unsigned int iel = 0; iel < elementVertices.size(); ++iel) {
+        for(unsigned int ii=0; ii<elementVertices[iel].size(); ++ii) {
+            m_elementIncident.push_back(fill[elementVertices[iel][ii]]);
+            m_incident[fill[elementVertices[iel][ii]]++] = std::make_pair(iel, ii);
+        }
+
+        m_elementStart.push_back(m_elementIncident.size());
+    }
+
+    //greedy coloring, vertices sharing an element get different colors
+    std::vector<int> color(numVertices, -1);
+    std::vector<unsigned int> usedBy;
+
+    m_colors.clear();
+
+    for(unsigned int vertex = 0; vertex < numVertices; ++vertex) {
+
+        usedBy.assign(m_colors.size()+1, numVertices);
+
+        for(unsigned int jj = m_incidentStart[vertex]; jj < m_incidentStart[vertex+1]; ++jj) {
+            for(auto neighbour : elementVertices[m_incident[jj].first]) {
+                if(color[neighbour] >= 0) {
+                    usedBy[color[neighbour]] = vertex;
+                }
+            }
+        }
+
+        unsigned int c = 0;
+
+        while(usedBy[c] == vertex) {
+            ++c;
+        }
+
+        if(c == m_colors.size()) {
+            m_colors.push_back(std::vector<unsigned int>());
+        }
+
+        color[vertex] = c;
+        m_colors[c].push_back(vertex);
+    }
+
+    //lumped mass
+    MatrixAssembler &massMatrix = m_massMatrix;
+
+    ASSEMBLEMATINIT(massMatrix, m_numDOFs, m_numDOFs);
+    ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+    ASSEMBLEEND(massMatrix);
+
+    m_mass = (*m_massMatrix)*Eigen::VectorXx<DataType>::Ones(m_numDOFs);
+
+    //body force = total system force - internal force
+    VectorAssembler &forceVector = m_forceVector;
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fBody = (*forceVector);
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getSystemList(), getInternalForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fBody -= (*forceVector);
+
+    //every constraint row has to touch a single DOF (i.e fixed points)
+    m_isFixed.setZero(m_numDOFs);
+
+    if(m_numConstraints > 0) {
+
+        MatrixAssembler &constraintGradient = m_constraintGradient;
+
+        ASSEMBLEMATINIT(constraintGradient, m_numConstraints, m_numDOFs);
+        ASSEMBLELISTOFFSET(constraintGradient, world.getConstraintList(), getGradient, 0, 0);
+        ASSEMBLEEND(constraintGradient);
+
+        m_J = (*m_constraintGradient);
+
+        for(unsigned int ii=0; ii<m_J.outerSize(); ++ii) {
+
+            unsigned int nnz = 0;
+
+            for(typename Eigen::SparseMatrix<DataType, Eigen::RowMajor>::InnerIterator it(m_J, ii); it; ++it) {
+                if(it.value() != 0) {
+                    m_isFixed[it.col()] = 1;
+                    ++nnz;
+                }
+            }
+
+            if(nnz != 1) {
+                std::cout<<"TimeStepperVertexBlockDescent only supports fixed point constraints \n";
+                exit(1);
+            }
+        }
+    }
+
+    m_initialized = true;
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void Gauss::TimeStepperImplVertexBlockDescent<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::sweep(World &world, DataType dt) {
+
+    auto &elements = m_system->getImpl().getElements();
+    auto &state = world.getState();
+
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+
+    DataType invDt2 = 1.0/(dt*dt);
+
+    //diagonal stiffness blocks, each element once per sweep rather than once per incident vertex
+    #if defined(GAUSS_OPENMP)
+    #pragma omp parallel for
+    #endif
+    for(int iel = 0; iel < static_cast<int>(elements.size()); ++iel) {
+
+        Eigen::MatrixXx<DataType> Ke;
+
+        elements[iel]->getStiffnessMatrix(Ke, state);
+
+        for(unsigned int jj = m_elementStart[iel]; jj < m_elementStart[iel+1]; ++jj) {
+            unsigned int local = 3*(jj - m_elementStart[iel]);
+            m_blocks[m_elementIncident[jj]] = Ke.template block<3,3>(local, local);
+        }
+    }
+
+    for(auto &vertices : m_colors) {
+
+        #if defined(GAUSS_OPENMP)
+        #pragma omp parallel for
+        #endif
+        for(int iv = 0; iv < static_cast<int>(vertices.size()); ++iv) {
+
+            unsigned int vertex = vertices[iv];
+            unsigned int dof = m_vertexDOF[vertex];
+
+            Eigen::VectorXx<DataType> fe;
+
+            //negative gradient and hessian of G restricted to this vertex
+            Eigen::Vector3x<DataType> f = m_fExt.template segment<3>(dof) -
+                                          invDt2*m_mass.template segment<3>(dof).cwiseProduct(q.template segment<3>(dof) - m_y.template segment<3>(dof));
+            Eigen::Matrix<DataType, 3, 3> H = (invDt2*m_mass.template segment<3>(dof)).asDiagonal();
+
+            for(unsigned int jj = m_incidentStart[vertex]; jj < m_incidentStart[vertex+1]; ++jj) {
+
+                auto element = elements[m_incident[jj].first];
+                unsigned int local = 3*m_incident[jj].second;
+
+                element->getInternalForce(fe, state);
+
+                f += fe.template segment<3>(local);
+                H -= m_blocks[jj];
+            }
+
+            //fixed DOFs don't move
+            for(unsigned int ii=0; ii<3; ++ii) {
+                if(m_isFixed[dof+ii]) {
+                    f[ii] = 0;
+                    H.row(ii).setZero();
+                    H.col(ii).setZero();
+                    H(ii,ii) = 1;
+                }
+            }
+
+            //the element hessians can be indefinite far from rest, fall back to the (always positive) inertial term
+            Eigen::LLT<Eigen::Matrix<DataType, 3, 3> > llt(H);
+
+            if(llt.info() == Eigen::Success) {
+                q.template segment<3>(dof) += llt.solve(f);
+            } else {
+                for(unsigned int ii=0; ii<3; ++ii) {
+                    if(!m_isFixed[dof+ii]) {
+                        q[dof+ii] += f[ii]/(invDt2*m_mass[dof+ii]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler, typename VectorAssembler>
+template<typename World>
+void Gauss::TimeStepperImplVertexBlockDescent<DataType, FEMSystem, MatrixAssembler, VectorAssembler>::step(World &world, double dt, double t) {
+
+    if(!m_initialized || m_numDOFs != world.getNumQDotDOFs() || m_numConstraints != world.getNumConstraints()) {
+        init(world);
+    }
+
+    //Grab the state
+    Eigen::Map<Eigen::VectorXx<DataType> > q = mapStateEigen<0>(world);
+    Eigen::Map<Eigen::VectorXx<DataType> > qDot = mapStateEigen<1>(world);
+
+    Eigen::VectorXx<DataType> qStart = q;
+
+    //external forces
+    VectorAssembler &forceVector = m_forceVector;
+
+    ASSEMBLEVECINIT(forceVector, m_numDOFs);
+    ASSEMBLELIST(forceVector, world.getForceList(), getForce);
+    ASSEMBLEEND(forceVector);
+
+    m_fExt = (*forceVector) + m_fBody;
+
+    //inertial target and initial guess, fixed DOFs move with the prescribed constraint velocity
+    m_y = q + dt*qDot;
+
+    if(m_numConstraints > 0) {
+
+        VectorAssembler &constraintVelocity = m_constraintVelocity;
+
+        ASSEMBLEVECINIT(constraintVelocity, m_numConstraints);
+        ASSEMBLELISTOFFSET(constraintVelocity, world.getConstraintList(), getDbDt, 0, 0);
+        ASSEMBLEEND(constraintVelocity);
+
+        Eigen::VectorXx<DataType> vFixed = m_J.transpose()*(*m_constraintVelocity);
+
+        for(unsigned int ii=0; ii<m_numDOFs; ++ii) {
+            if(m_isFixed[ii]) {
+                m_y[ii] = q[ii] + dt*vFixed[ii];
+            }
+        }
+    }
+
+    q = m_y;
+
+    for(unsigned int ii=0; ii<m_numDOFs; ++ii) {
+        if(!m_isFixed[ii]) {
+            q[ii] += dt*dt*m_fExt[ii]/m_mass[ii];
+        }
+    }
+
+    //Chebyshev semi-iterative acceleration, x_k = omega_k*(sweep(x_k-1) - x_k-2) + x_k-2
+    Eigen::VectorXx<DataType> qPrev = q, qPrev2;
+    DataType omega = 1;
+
+    for(unsigned int iter = 0; iter < m_iterations; ++iter) {
+
+        sweep(world, dt);
+
+        if(m_rho > 0) {
+
+            omega = (iter == 0 ? 1.0 : (iter == 1 ? 2.0/(2.0 - m_rho*m_rho) : 4.0/(4.0 - m_rho*m_rho*omega)));
+
+            if(iter > 0) {
+                q = omega*(q - qPrev2) + qPrev2;
+            }
+
+            qPrev2 = qPrev;
+            qPrev = q;
+        }
+    }
+
+    //constraint impulses from the residual of the fixed DOFs, consistent with the velocity level multipliers of the other steppers
+    if(m_numConstraints > 0) {
+
+        ASSEMBLEVECINIT(forceVector, m_numDOFs);
+        ASSEMBLELIST(forceVector, world.getSystemList(), getInternalForce);
+        ASSEMBLEEND(forceVector);
+
+        Eigen::VectorXx<DataType> gradient = (1.0/(dt*dt))*m_mass.cwiseProduct(q - m_y) - (*forceVector) - m_fExt;
+        m_lagrangeMultipliers = -dt*(m_J*gradient);
+    } else {
+        m_lagrangeMultipliers.resize(0);
+    }
+
+    //update state
+    qDot = (q - qStart)/dt;
+}
+
+template<typename DataType, typename FEMSystem, typename MatrixAssembler = AssemblerParallel<DataType, AssemblerEigenSparseMatrix<DataType> >, typename VectorAssembler = AssemblerParallel<DataType, AssemblerEigenVector<DataType> > >
+using TimeStepperVertexBlockDescent = Gauss::TimeStepper<DataType, Gauss::TimeStepperImplVertexBlockDescent<DataType, FEMSystem, MatrixAssembler, VectorAssembler> >;
+
+#endif /* TimeStepperVertexBlockDescent_h */
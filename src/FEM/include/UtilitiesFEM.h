@@ -15,6 +15,8 @@
 #include <UtilitiesEigen.h>
 #include <complex>
 #include <Constraint.h>
+#include <SolverLOBPCG.h>
+#include <PreconditionerBlockJacobi.h>
 
 //A collection of useful FEM utilities
 
@@ -23,8 +25,9 @@ namespace Gauss {
         
         //linear modal analysis
         //returns a pair wherein the first value is a matrix of eigenvectors and the second is vector of corresponding vibrational frequencies
+        //pass the same solver in on repeated calls to reuse its factorization and warm start from the previous modes
         template<typename World>
-        auto linearModalAnalysis(World &world, unsigned int numModes) {
+        auto linearModalAnalysis(World &world, unsigned int numModes, GeneralizedEigenSolverShiftInvert<double> &solver) {
             
             //build mass and stiffness matrices
             AssemblerParallel<double, AssemblerEigenSparseMatrix<double> > mass;
@@ -33,7 +36,7 @@ namespace Gauss {
             getMassMatrix(mass, world);
             getStiffnessMatrix(stiffness, world);
             
-            auto eigs = generalizedEigenvalueProblem((*stiffness), (*mass), numModes,   1e-6);
+            auto eigs = solver.compute((*stiffness), (*mass), numModes,   1e-6);
             
             //convert to vibrational frequencies
             //hack because generalised eignvalue solver only returns real values
@@ -44,6 +47,49 @@ namespace Gauss {
             return eigs;
         }
         
+        template<typename World>
+        auto linearModalAnalysis(World &world, unsigned int numModes) {
+            GeneralizedEigenSolverShiftInvert<double> solver;
+            return linearModalAnalysis(world, numModes, solver);
+        }
+        
+        //factorization free modal analysis for very large meshes, block Jacobi preconditioned LOBPCG
+        //the solver keeps the last modes so repeated calls are warm started
+        template<typename World>
+        auto linearModalAnalysis(World &world, unsigned int numModes, SolverLOBPCG<double> &solver) {
+            
+            //build mass and stiffness matrices
+            AssemblerParallel<double, AssemblerEigenSparseMatrix<double> > mass;
+            AssemblerParallel<double, AssemblerEigenSparseMatrix<double> > stiffness;
+            
+            getMassMatrix(mass, world);
+            getStiffnessMatrix(stiffness, world);
+            
+            //stiffness matrices are negative semi-definite in Gauss
+            Eigen::SparseMatrix<double, Eigen::RowMajor> K = -(*stiffness);
+            Eigen::SparseMatrix<double, Eigen::RowMajor> &M = (*mass);
+            
+            //same small shift as the shift-invert version so rigid modes don't make the preconditioner singular
+            Eigen::SparseMatrix<double, Eigen::RowMajor> Kshift = K + 1e-6*M;
+            PreconditionerBlockJacobi<double> pc(Kshift);
+            
+            if(!solver.compute([&K](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return K*x; },
+                               [&M](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return M*x; },
+                               [&pc](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return pc(x); },
+                               K.rows(), numModes)) {
+                std::cout<<"LOBPCG did not converge in "<<solver.getNumIterations()<<" iterations \n";
+            }
+            
+            std::pair<Eigen::MatrixXd, Eigen::VectorXd> eigs = std::make_pair(solver.eigenvectors(), solver.eigenvalues());
+            
+            //convert to vibrational frequencies
+            for(unsigned int ii=0; ii<eigs.second.rows(); ++ii) {
+                eigs.second[ii] = std::sqrt(std::fabs(eigs.second[ii]));
+            }
+            
+            return eigs;
+        }
+        
         //functor for getting position of a DOF
         template <typename DataType, typename DOF>
         class PositionFEMEigen {
@@ -9,9 +9,15 @@
 #define GaussOptimizationAdapters_h
 
 #include <igl/cat.h>
+#include <chrono>
 #include <climits>
+#include <cmath>
+#include <deque>
+#include <limits>
 #include <Newton.h>
 #include <UtilitiesEigen.h>
+#include <SolverCGDeflated.h>
+#include <PreconditionerBlockJacobi.h>
 
 namespace Gauss {
     namespace Optimization {
@@ -127,7 +133,7 @@ namespace Gauss {
                 
                 //Solve and return the newton search direction
                 #ifdef GAUSS_PARDISO
-                    return m_solver.solve(m_KKTt, m_b);
+                    m_p = m_solver.solve(m_KKTt, m_b);
                 #else
                     m_solver.compute(m_KKTt);
             
@@ -138,10 +144,14 @@ namespace Gauss {
                         exit(1);
                     }
             
-                    return m_solver.solve(m_b);
+                    m_p = m_solver.solve(m_b);
                 
                 #endif
                 
+                //the KKT solve gives the multipliers themselves, step the dual part of x0 towards them
+                m_p.segment((*H).rows(), (*Jeq).rows()) -= x0.segment((*H).rows(), (*Jeq).rows());
+                
+                return m_p;
             }
             
         protected:
@@ -153,9 +163,343 @@ namespace Gauss {
             #endif
 
             Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_KKT, m_KKTt;
-            Eigen::VectorXx<DataType> m_b;
+            Eigen::VectorXx<DataType> m_b, m_p;
         };
-        
+
+        //How the Newton direction treats the Hessian
+        //Full       : assemble and factor the KKT system every iteration
+        //Lagged     : reuse the last factorization across iterations and time steps until convergence slows down
+        //LaggedLBFGS: lagged factorization as the initial inverse Hessian of an L-BFGS update
+        enum class HessianMode { Full, Lagged, LaggedLBFGS };
+
+        //Newton direction that holds on to its KKT factorization. The factorization is refreshed when
+        //1. the ratio of successive step lengths exceeds rate (i.e linear convergence slower than rate)
+        //2. it has been used for maxAge directions
+        //3. a direction fails to be a descent direction or the system size changes
+        //Since the decision is made before the next direction is needed, callers can skip assembling the Hessian whenever
+        //needsHessian() is false. Call beginSolve() at the start of every minimization (i.e every time step).
+        template<typename DataType>
+        class DirectionLaggedNewtonAssembler {
+
+        public:
+            inline DirectionLaggedNewtonAssembler(HessianMode mode = HessianMode::Lagged, unsigned int maxAge = 20, DataType rate = 0.5, unsigned int numPairs = 5)
+            #ifdef GAUSS_PARDISO
+            : m_solver(11)
+            #endif
+            {
+                m_mode = mode;
+                m_maxAge = maxAge;
+                m_rate = rate;
+                m_numPairs = numPairs;
+                m_age = 0;
+                m_size = 0;
+                m_numFactorizations = 0;
+                m_factored = false;
+                m_refresh = true;
+                m_hasPrevious = false;
+            }
+
+            ~DirectionLaggedNewtonAssembler() {
+                #ifdef GAUSS_PARDISO
+                    if(m_factored) {
+                        m_solver.cleanup();
+                    }
+                #endif
+            }
+
+            //does the next call need an up to date Hessian, n is the size of the KKT system
+            inline bool needsHessian(unsigned int n) const {
+                return m_mode == HessianMode::Full || !m_factored || m_refresh || n != m_size;
+            }
+
+            //secant pairs are only valid for a single objective
+            inline void beginSolve() {
+                m_s.clear();
+                m_y.clear();
+                m_hasPrevious = false;
+                m_lastStep = 0;
+            }
+
+            inline void refresh() { m_refresh = true; }
+            inline unsigned int getNumFactorizations() const { return m_numFactorizations; }
+            inline HessianMode getMode() const { return m_mode; }
+
+            //takes in assembled matrices and returns the search direction, H is only read if needsHessian() was true
+            template<typename Hessian, typename Gradient, typename Ceq, typename JacobianEq, typename Vector>
+            inline decltype(auto) operator()(Hessian &H, Gradient &g, Ceq &ceq, JacobianEq &Jeq, Vector &x0) {
+
+                unsigned int numPrimal = g.rows();
+
+                if(needsHessian(numPrimal + (*Jeq).rows())) {
+                    factor(H, Jeq);
+                    m_s.clear();
+                    m_y.clear();
+                }
+
+                //secant pair from the previous iterate
+                if(m_mode == HessianMode::LaggedLBFGS && m_hasPrevious) {
+
+                    Eigen::VectorXx<DataType> s = x0.head(numPrimal) - m_xPrev;
+                    Eigen::VectorXx<DataType> y = g - m_gPrev;
+
+                    if(s.dot(y) > 1e-10*s.norm()*y.norm()) {
+                        m_s.push_front(s);
+                        m_y.push_front(y);
+
+                        if(m_s.size() > m_numPairs) {
+                            m_s.pop_back();
+                            m_y.pop_back();
+                        }
+                    }
+                }
+
+                m_xPrev = x0.head(numPrimal);
+                m_gPrev = g;
+
+                if(m_s.empty()) {
+                    //Full and Lagged modes (or no secant pairs yet), plain Newton direction from a single KKT solve
+                    m_b.setZero(m_size);
+                    m_b.head(numPrimal) = -g;
+                    m_b.segment(numPrimal, (*Jeq).rows()) = (*ceq) - (*Jeq)*x0.head(numPrimal);
+                    m_p = kktSolve(m_b);
+                } else {
+                    //constraint correction (gradient free part of the KKT solve)
+                    m_b.setZero(m_size);
+                    m_b.segment(numPrimal, (*Jeq).rows()) = (*ceq) - (*Jeq)*x0.head(numPrimal);
+                    m_p = kktSolve(m_b);
+
+                    //two loop recursion, the lagged KKT solve plays the role of the initial inverse Hessian
+                    //iterates are feasible so the secant steps lie in the constraint null space and so does the update
+                    std::vector<DataType> alpha(m_s.size());
+                    Eigen::VectorXx<DataType> q = -g;
+
+                    for(unsigned int ii=0; ii<m_s.size(); ++ii) {
+                        alpha[ii] = m_s[ii].dot(q)/m_s[ii].dot(m_y[ii]);
+                        q -= alpha[ii]*m_y[ii];
+                    }
+
+                    m_b.setZero(m_size);
+                    m_b.head(numPrimal) = q;
+                    m_p += kktSolve(m_b);
+
+                    for(int ii=static_cast<int>(m_s.size())-1; ii>=0; --ii) {
+                        DataType beta = m_y[ii].dot(m_p.head(numPrimal))/m_s[ii].dot(m_y[ii]);
+                        m_p.head(numPrimal) += (alpha[ii] - beta)*m_s[ii];
+                    }
+
+                    //stale Hessians can produce uphill directions, fall back to the plain lagged direction and refresh for the next one
+                    if(g.dot(m_p.head(numPrimal)) > 0) {
+                        m_s.clear();
+                        m_y.clear();
+                        m_b.setZero(m_size);
+                        m_b.head(numPrimal) = -g;
+                        m_b.segment(numPrimal, (*Jeq).rows()) = (*ceq) - (*Jeq)*x0.head(numPrimal);
+                        m_p = kktSolve(m_b);
+                    }
+                }
+
+                //multipliers to increments, as in DirectionNewtonAssembler
+                m_p.segment(numPrimal, (*Jeq).rows()) -= x0.segment(numPrimal, (*Jeq).rows());
+
+                DataType stepNorm = m_p.head(numPrimal).norm();
+
+                if(g.dot(m_p.head(numPrimal)) > 0 || ++m_age >= m_maxAge || (m_hasPrevious && stepNorm > m_rate*m_lastStep)) {
+                    m_refresh = true;
+                }
+
+                m_lastStep = stepNorm;
+                m_hasPrevious = true;
+
+                return m_p;
+            }
+
+        protected:
+
+            template<typename Hessian, typename JacobianEq>
+            void factor(Hessian &H, JacobianEq &Jeq) {
+
+                //same KKT layout as DirectionNewtonAssembler
+                unsigned int nnzH, nnzJ;
+                nnzH = (*H).nonZeros();
+                nnzJ = (*Jeq).outerIndexPtr()[(*Jeq).rows()];
+
+                m_KKT.resize((*H).rows(), (*H).cols());
+                m_KKT.reserve(nnzH + 2*nnzJ);
+                m_KKT = (*H);
+
+                m_KKT.conservativeResize((*H).rows()+(*Jeq).rows(), (*H).cols());
+                m_KKT.middleRows((*H).rows(), (*Jeq).rows()) = (*Jeq);
+                m_KKT.conservativeResize((*H).rows()+(*Jeq).rows(), (*H).rows()+(*Jeq).rows());
+
+                m_KKTt = m_KKT.transpose();
+                m_KKTt.middleRows((*H).rows(), (*Jeq).rows()) = (*Jeq);
+
+                #ifdef GAUSS_PARDISO
+                    if(m_factored) {
+                        m_solver.cleanup();
+                    }
+
+                    m_solver.symbolicFactorization(m_KKTt);
+                    m_solver.numericalFactorization();
+                #else
+                    m_solver.compute(m_KKTt);
+
+                    if(m_solver.info()!=Eigen::Success) {
+                        // decomposition failed
+                        assert(1 == 0);
+                        std::cout<<"Decomposition Failed \n";
+                        exit(1);
+                    }
+                #endif
+
+                m_size = m_KKTt.rows();
+                m_factored = true;
+                m_refresh = false;
+                m_age = 0;
+                ++m_numFactorizations;
+            }
+
+            inline Eigen::VectorXx<DataType> kktSolve(Eigen::VectorXx<DataType> &b) {
+                return m_solver.solve(b);
+            }
+
+            HessianMode m_mode;
+            unsigned int m_maxAge, m_age, m_numPairs, m_size, m_numFactorizations;
+            DataType m_rate, m_lastStep;
+            bool m_factored, m_refresh, m_hasPrevious;
+
+            #ifdef GAUSS_PARDISO
+                SolverPardiso<Eigen::SparseMatrix<DataType, Eigen::RowMajor> > m_solver;
+            #else
+                Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > m_solver;
+            #endif
+
+            Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_KKT, m_KKTt;
+            Eigen::VectorXx<DataType> m_b, m_p, m_xPrev, m_gPrev;
+            std::deque<Eigen::VectorXx<DataType> > m_s, m_y; //most recent first
+        };
+
+        //Inexact Newton direction for Hessians that are only available as matrix vector products (i.e AssemblerMVPEigen)
+        //The equality constrained Newton system is solved by preconditioned CG in the null space of the constraint Jacobian,
+        //the particular solution and the multipliers come from the (small) normal equations J*J'.
+        //The CG tolerance follows Eisenstat-Walker (choice 2) so early Newton iterations are solved loosely and later ones tightly.
+        //Call beginSolve() at the start of every minimization (i.e every time step).
+        template<typename DataType>
+        class DirectionNewtonKrylov {
+
+        public:
+
+            using VectorType = Eigen::VectorXx<DataType>;
+
+            inline DirectionNewtonKrylov(unsigned int maxCGIterations = 1000, DataType etaMax = 0.9, DataType gamma = 0.9, DataType alpha = 2.0) : m_cg(1e-8, 0, false) {
+                m_maxCGIterations = maxCGIterations;
+                m_etaMax = etaMax;
+                m_gamma = gamma;
+                m_alpha = alpha;
+                m_numCGIterations = 0;
+                beginSolve();
+            }
+
+            inline void beginSolve() {
+                m_hasPrevious = false;
+                m_eta = 0.5;
+                m_lastNorm = 0;
+            }
+
+            //block Jacobi preconditioner for the Newton system, identity if it hasn't been computed or the size doesn't match
+            inline PreconditionerBlockJacobi<DataType> & getPreconditioner() { return m_pc; }
+
+            //CG iterations since construction
+            inline unsigned int getNumCGIterations() const { return m_numCGIterations; }
+            inline DataType getForcingTerm() const { return m_eta; }
+
+            //H is a functor returning H*v
+            template<typename Hessian, typename Gradient, typename Ceq, typename JacobianEq, typename Vector>
+            inline decltype(auto) operator()(Hessian &H, Gradient &g, Ceq &ceq, JacobianEq &Jeq, Vector &x0) {
+
+                unsigned int n = g.rows();
+                unsigned int m = (*Jeq).rows();
+
+                m_J = (*Jeq);
+
+                if(m > 0) {
+                    m_JJt.compute(m_J*m_J.transpose());
+                }
+
+                auto project = [this, m](const VectorType &v) -> VectorType {
+                    if(m == 0) {
+                        return v;
+                    }
+
+                    return v - m_J.transpose()*m_JJt.solve(m_J*v);
+                };
+
+                //minimum norm step onto the constraints
+                VectorType p0 = VectorType::Zero(n);
+                VectorType rhs = -g;
+
+                if(m > 0) {
+                    p0 = m_J.transpose()*m_JJt.solve((*ceq) - m_J*x0.head(n));
+
+                    if(p0.norm() > 0) {
+                        rhs -= H(p0);
+                    }
+                }
+
+                rhs = project(rhs);
+
+                //Eisenstat-Walker forcing term from the reduced gradient
+                DataType fNorm = project(g).norm();
+
+                if(m_hasPrevious && m_lastNorm > 0) {
+                    DataType eta = m_gamma*std::pow(fNorm/m_lastNorm, m_alpha);
+                    DataType safeguard = m_gamma*std::pow(m_eta, m_alpha);
+
+                    if(safeguard > 0.1) {
+                        eta = std::max(eta, safeguard);
+                    }
+
+                    m_eta = std::min(eta, m_etaMax);
+                }
+
+                m_lastNorm = fNorm;
+                m_hasPrevious = true;
+
+                auto mvp = [&H, &project](VectorType &v) -> VectorType { return project(H(v)); };
+                auto pc = [this, &project, n](VectorType &r) -> VectorType & {
+                    m_z = (m_pc.rows() == n ? project(m_pc(r)) : project(r));
+                    return m_z;
+                };
+
+                VectorType d = VectorType::Zero(n);
+                m_cg.setTolerance(std::max(m_eta*rhs.norm(), std::numeric_limits<DataType>::min()));
+                m_numCGIterations += m_cg.solve(d, mvp, rhs, m_maxCGIterations, pc);
+
+                m_p.resize(n + m);
+                m_p.head(n) = p0 + d;
+
+                //least squares multipliers from H*p + J'*lambda = -g, returned as increments like DirectionNewtonAssembler
+                if(m > 0) {
+                    VectorType p = m_p.head(n);
+                    m_p.tail(m) = m_JJt.solve(m_J*(-g - H(p))) - x0.segment(n, m);
+                }
+
+                return m_p;
+            }
+
+        protected:
+
+            unsigned int m_maxCGIterations, m_numCGIterations;
+            DataType m_etaMax, m_gamma, m_alpha, m_eta, m_lastNorm;
+            bool m_hasPrevious;
+
+            Eigen::SparseMatrix<DataType, Eigen::RowMajor> m_J;
+            Eigen::SimplicialLDLT<Eigen::SparseMatrix<DataType> > m_JJt;
+            PreconditionerBlockJacobi<DataType> m_pc;
+            SolverCGDeflated<DataType, VectorType> m_cg;
+            VectorType m_p, m_z;
+        };
+
         //Equality constrained newtons method using Gauss
         template <typename Energy, typename Gradient, typename Hessian, typename ConstraintEq,
                   typename JacobianEq, typename Solver, typename PostStepCallback, typename Vector>
@@ -168,25 +512,135 @@ namespace Gauss {
             return optimizeWithLineSearch(x0, f, g, H, ceq, Aeq, linesearch, tol1, numIterations);
         }
         
+        //norm of the KKT residual [g + J'*lambda; J*x - b] at x = [primal; lambda], the world is moved to x first
+        template <typename Gradient, typename ConstraintEq, typename JacobianEq, typename PostStepCallback, typename Vector>
+        inline double kktResidual(Vector &x, Gradient &g, ConstraintEq &ceq, JacobianEq &Aeq, PostStepCallback &pscallback) {
+
+            pscallback(x);
+
+            Vector gradient;
+            assign(gradient, g(x));
+
+            auto J = *Aeq(x);
+            auto b = *ceq(x);
+
+            Vector rPrimal = gradient + J.transpose()*x.tail(J.rows());
+            Vector rDual = J*x.head(gradient.rows()) - b;
+
+            return std::sqrt(rPrimal.squaredNorm() + rDual.squaredNorm());
+        }
+
+        //what happened during the last call to NewtonSearchWithBackTracking
+        //residuals are only evaluated when a time budget is set (it costs an extra gradient assembly per iteration), NaN otherwise
+        struct NewtonReport {
+            unsigned int iterations = 0;
+            double initialResidual = std::numeric_limits<double>::quiet_NaN();
+            double residual = std::numeric_limits<double>::quiet_NaN();
+            double seconds = 0;
+            bool converged = false;
+            bool outOfTime = false;
+        };
+
         //functors are annoying but when I have solvers that require initialization they seem to be a necessary evil to avoid reinitilization
-        template<typename DataType>
+        template<typename DataType, typename Direction = DirectionNewtonAssembler<DataType> >
         class NewtonSearchWithBackTracking {
         public:
-            
-            
-            inline NewtonSearchWithBackTracking() { };
-            
+
+
+            inline NewtonSearchWithBackTracking() { m_budget = 0; };
+
+            template<typename ...Params>
+            inline NewtonSearchWithBackTracking(Params ...params) : m_solver(params...) { m_budget = 0; };
+
+            inline Direction & getDirection() { return m_solver; }
+            inline const Direction & getDirection() const { return m_solver; }
+
+            //wall clock budget in seconds for a single solve (0 = no budget). With a budget the solve stops before an iteration
+            //that is predicted (from the slowest iteration so far) to overrun the deadline and the iterate with the smallest
+            //KKT residual is returned. At least one iteration is always taken.
+            inline void setTimeBudget(double seconds) { m_budget = seconds; }
+            inline double getTimeBudget() const { return m_budget; }
+
+            inline const NewtonReport & getReport() const { return m_report; }
+
+            //maxStep bounds every line search (see backTrackingLinesearch)
             template <typename Energy, typename Gradient, typename Hessian, typename ConstraintEq,
-            typename JacobianEq, typename PostStepCallback, typename Vector>
+            typename JacobianEq, typename PostStepCallback, typename Vector, typename StepBound = FullStep>
             inline bool operator()(Vector &x0, Energy &f, Gradient &g, Hessian &H, ConstraintEq &ceq,
-                                   JacobianEq &Aeq, PostStepCallback &pscallback, double tol1=1e-5, unsigned int numIterations= 10000) {
+                                   JacobianEq &Aeq, PostStepCallback &pscallback, double tol1=1e-5, unsigned int numIterations= 10000,
+                                   StepBound maxStep = StepBound()) {
                 
-                return minimizeBacktracking(x0, f, g, H, ceq, Aeq, m_solver, pscallback, tol1, numIterations);
+                using Clock = std::chrono::steady_clock;
+
+                auto start = Clock::now();
+                auto seconds = [&start]() { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+                m_report = NewtonReport();
+
+                //diverged iterates (non-finite residual) never become the best one, if there is no finite residual at all
+                //the starting point is kept
+                Vector xBest;
+                double rBest = std::numeric_limits<double>::infinity(), slowest = 0;
+
+                if(m_budget > 0) {
+                    m_report.initialResidual = kktResidual(x0, g, ceq, Aeq, pscallback);
+                    xBest = x0;
+
+                    if(std::isfinite(m_report.initialResidual)) {
+                        rBest = m_report.initialResidual;
+                    }
+                }
+
+                while(m_report.iterations < numIterations) {
+
+                    double iterStart = seconds();
+
+                    m_report.converged = backTrackingLinesearch(x0, f, g, H, ceq, Aeq, m_solver, pscallback, tol1, maxStep);
+                    ++m_report.iterations;
+
+                    if(m_budget > 0) {
+
+                        double r = kktResidual(x0, g, ceq, Aeq, pscallback);
+
+                        if(std::isfinite(r) && r <= rBest) {
+                            rBest = r;
+                            xBest = x0;
+                        }
+
+                        slowest = std::max(slowest, seconds() - iterStart);
+                    }
+
+                    if(m_report.converged) {
+                        break;
+                    }
+
+                    if(m_budget > 0 && seconds() + slowest > m_budget) {
+                        m_report.outOfTime = true;
+                        break;
+                    }
+                }
+
+                if(m_budget > 0) {
+
+                    //the last iterate isn't always the best one, put the world back where the best one was
+                    if(xBest.rows() == x0.rows() && !(x0 == xBest)) {
+                        x0 = xBest;
+                        pscallback(x0);
+                    }
+
+                    m_report.residual = rBest;
+                }
+
+                m_report.seconds = seconds();
+
+                return m_report.converged;
             }
         protected:
         private:
             
-            DirectionNewtonAssembler<DataType> m_solver;
+            Direction m_solver;
+            double m_budget;
+            NewtonReport m_report;
         };
     }
     
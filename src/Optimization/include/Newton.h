@@ -2,10 +2,17 @@
 #define NEWTON_HPP
 #include <vector>
 #include <climits>
+#include <algorithm>
 
 namespace Gauss {
     namespace Optimization {
         
+        //default step bound for backTrackingLinesearch, the full step is always allowed
+        struct FullStep {
+            template<typename Vector>
+            inline double operator()(const Vector &x, const Vector &p) const { return 1.0; }
+        };
+        
         //Implementation of backtracking linesearch. Parameter values chosen based on Numerical Optimization by Nocedal and Wright
         //Inputs:
         //  Energy - a function/functor of the form f(x) that returns the energy associated with the  iterate x
@@ -15,11 +22,13 @@ namespace Gauss {
         // Direction - a function/functor of the form solveR(H, g, Aeq, ceq) that produces a direction for the current line search
         // x0 - initial point for the solver. For constrained solves, x0 is the stacked vector of primal and dual variables. Must be of size #primal + #constraints
         // scallback - a callback function/functor of the form s(x) that is called every time the iterate, x, is updated.
+        // maxStep - a function/functor of the form maxStep(x, p) that returns the largest allowed fraction of the step p from x (i.e continuous
+        //           collision detection for barrier energies that are infinite past contact), it's called after scallback(x)
         template <typename Energy, typename Gradient, typename Hessian,
                   typename ConstraintEq, typename JacobianEq,
-                  typename Direction, typename StepCallback, typename Vector>
+                  typename Direction, typename StepCallback, typename Vector, typename StepBound = FullStep>
         inline bool backTrackingLinesearch(Vector &x0, Energy &f, Gradient &g, Hessian &H, ConstraintEq &ceq, JacobianEq &Aeq,
-                                 Direction &solver, StepCallback &scallback, double tol1 = 1e-5) {
+                                 Direction &solver, StepCallback &scallback, double tol1 = 1e-5, StepBound maxStep = StepBound()) {
             
             scallback(x0);
             
@@ -39,7 +48,7 @@ namespace Gauss {
             double gStep = gradient.transpose()*p.head(gradient.rows());
             
             //back tracking line search
-            double alpha = 1;
+            double alpha = std::min(1.0, static_cast<double>(maxStep(x0, p)));
             double c = 1e-8; //from Nocedal and Wright pg 31
             double rho = 0.5;
             
@@ -0,0 +1,109 @@
+//
+//  PreconditionerBlockJacobi.h
+//  Gauss
+//
+//  Block diagonal (i.e per vertex) inverse of a sparse matrix, applied to vectors or blocks of vectors
+//
+//
+
+#ifndef PreconditionerBlockJacobi_h
+#define PreconditionerBlockJacobi_h
+
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+namespace Gauss {
+
+    template<typename DataType, unsigned int BlockSize = 3>
+    class PreconditionerBlockJacobi
+    {
+    public:
+
+        using Block = Eigen::Matrix<DataType, BlockSize, BlockSize>;
+        using MatrixType = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic>;
+
+        PreconditionerBlockJacobi() { m_n = 0; }
+
+        template<typename SparseMatrix>
+        PreconditionerBlockJacobi(const SparseMatrix &A) { compute(A); }
+
+        //extract and invert the diagonal blocks, a trailing partial block (rows % BlockSize) is inverted as a diagonal
+        template<typename SparseMatrix>
+        void compute(const SparseMatrix &A) {
+
+            m_n = A.rows();
+            unsigned int numBlocks = m_n/BlockSize;
+
+            m_blocks.assign(numBlocks, Block::Zero());
+            m_tail.setOnes(m_n - numBlocks*BlockSize);
+
+            for(unsigned int ii=0; ii<A.outerSize(); ++ii) {
+                for(typename SparseMatrix::InnerIterator it(A, ii); it; ++it) {
+
+                    unsigned int row = it.row();
+                    unsigned int col = it.col();
+
+                    if(row/BlockSize == col/BlockSize && row/BlockSize < numBlocks) {
+                        m_blocks[row/BlockSize](row%BlockSize, col%BlockSize) = it.value();
+                    } else if(row == col) {
+                        m_tail[row - numBlocks*BlockSize] = it.value();
+                    }
+                }
+            }
+
+            //pseudo-inverse keeps singular blocks (i.e unconstrained rigid motion) from blowing up
+            for(unsigned int ii=0; ii<numBlocks; ++ii) {
+                Eigen::SelfAdjointEigenSolver<Block> es(m_blocks[ii]);
+                Eigen::Matrix<DataType, BlockSize, 1> invD = es.eigenvalues();
+                DataType cutoff = 1e-12*invD.cwiseAbs().maxCoeff();
+
+                for(unsigned int jj=0; jj<BlockSize; ++jj) {
+                    invD[jj] = (std::abs(invD[jj]) > cutoff ? static_cast<DataType>(1)/invD[jj] : 0);
+                }
+
+                m_blocks[ii] = es.eigenvectors()*invD.asDiagonal()*es.eigenvectors().transpose();
+            }
+
+            for(unsigned int ii=0; ii<m_tail.rows(); ++ii) {
+                m_tail[ii] = (m_tail[ii] != 0 ? static_cast<DataType>(1)/m_tail[ii] : 0);
+            }
+        }
+
+        //y = inv(blockdiag(A))*x, x can have multiple columns
+        template<typename Derived>
+        MatrixType apply(const Eigen::MatrixBase<Derived> &x) const {
+
+            MatrixType y(x.rows(), x.cols());
+            unsigned int numBlocks = m_blocks.size();
+
+            #if defined(GAUSS_OPENMP)
+            #pragma omp parallel for
+            #endif
+            for(int ii=0; ii<static_cast<int>(numBlocks); ++ii) {
+                y.middleRows(BlockSize*ii, BlockSize) = m_blocks[ii]*x.middleRows(BlockSize*ii, BlockSize);
+            }
+
+            if(m_tail.rows() > 0) {
+                y.bottomRows(m_tail.rows()) = m_tail.asDiagonal()*x.bottomRows(m_tail.rows());
+            }
+
+            return y;
+        }
+
+        template<typename Derived>
+        inline MatrixType operator()(const Eigen::MatrixBase<Derived> &x) const { return apply(x); }
+
+        inline unsigned int rows() const { return m_n; }
+
+    protected:
+
+        unsigned int m_n;
+        std::vector<Block, Eigen::aligned_allocator<Block> > m_blocks;
+        Eigen::Matrix<DataType, Eigen::Dynamic, 1> m_tail;
+
+    private:
+    };
+}
+
+#endif /* PreconditionerBlockJacobi_h */
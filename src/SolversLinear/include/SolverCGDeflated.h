@@ -0,0 +1,187 @@
+//
+//  SolverCGDeflated.h
+//  Gauss
+//
+//  Deflated preconditioned CG that recycles information across a sequence of solves
+//
+//
+
+#ifndef SolverCGDeflated_h
+#define SolverCGDeflated_h
+
+#include <functional>
+#include <deque>
+#include <Eigen/Dense>
+
+namespace Gauss {
+
+    //Consecutive implicit time steps solve nearly the same system over and over. This solver keeps
+    //1. A fixed deflation space set by the user (i.e the lowest modes from linearModalAnalysis)
+    //2. The last few converged solutions (recycled space)
+    //Each solve starts from an extrapolation of the previous solutions, is corrected by a Galerkin projection onto the
+    //deflation + recycled space and then runs CG on the A-orthogonal complement of that space.
+    template<typename DataType, typename VectorType>
+    class SolverCGDeflated
+    {
+    public:
+
+        using MatrixType = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic>;
+
+        SolverCGDeflated(DataType rtol=1e-8, unsigned int numRecycled = 4, bool extrapolate = true) {
+            m_rtol = rtol;
+            m_numRecycled = numRecycled;
+            m_extrapolate = extrapolate;
+            m_iterations = 0;
+        }
+
+        inline void setTolerance(DataType rtol) { m_rtol = rtol; }
+
+        //fixed vectors to deflate, one per column
+        inline void setDeflationSpace(const MatrixType &W) { m_W = W; }
+
+        //forget recycled solutions (i.e after a topology change)
+        inline void clearRecycled() { m_history.clear(); }
+
+        //Matrix-Vector-Product Operation, RHS. x is the initial guess unless extrapolation is on and there are previous solutions,
+        //in which case it is replaced by the extrapolated guess. Returns the number of CG iterations.
+        template<typename MVPFunc, typename PCFunc = const std::function<VectorType&(VectorType &)> >
+        unsigned int solve(VectorType &x, MVPFunc mvp, VectorType &rhs, unsigned int maxIter = 1e8, PCFunc &pc = [](VectorType &x) -> VectorType & {return x;});
+
+        inline unsigned int getNumIterations() const { return m_iterations; }
+
+    protected:
+
+        //build an orthonormal basis for [W, recycled], its image under A and the factored coarse matrix U'AU
+        template<typename MVPFunc>
+        void buildSubspace(MVPFunc &mvp, unsigned int n);
+
+        //r - U*inv(U'AU)*AU'*r, makes r A-orthogonal to the subspace
+        inline VectorType projectAOrthogonal(const VectorType &r) {
+            if(m_U.cols() == 0) {
+                return r;
+            }
+
+            return r - m_U*m_E.solve(m_AU.transpose()*r);
+        }
+
+        DataType m_rtol;
+        unsigned int m_numRecycled, m_iterations;
+        bool m_extrapolate;
+
+        MatrixType m_W;
+        std::deque<VectorType> m_history; //most recent first
+
+        MatrixType m_U, m_AU;
+        Eigen::LDLT<MatrixType> m_E;
+
+        VectorType m_r, m_z, m_p, m_Ap, m_v;
+
+    private:
+    };
+
+    template<typename DataType, typename VectorType>
+    template<typename MVPFunc>
+    void SolverCGDeflated<DataType, VectorType>::buildSubspace(MVPFunc &mvp, unsigned int n) {
+
+        unsigned int numVecs = m_W.cols() + m_history.size();
+
+        m_U.resize(n, numVecs);
+        m_AU.resize(n, 0);
+
+        if(numVecs == 0) {
+            return;
+        }
+
+        if(m_W.cols() > 0) {
+            m_U.leftCols(m_W.cols()) = m_W;
+        }
+
+        for(unsigned int ii=0; ii<m_history.size(); ++ii) {
+            m_U.col(m_W.cols()+ii) = m_history[ii];
+        }
+
+        //drop dependent directions, the solution history becomes nearly collinear once the motion settles
+        Eigen::ColPivHouseholderQR<MatrixType> qr(m_U);
+        qr.setThreshold(1e-8);
+        unsigned int rank = qr.rank();
+
+        m_U = (qr.householderQ()*MatrixType::Identity(n, rank));
+        m_AU.resize(n, rank);
+
+        for(unsigned int ii=0; ii<rank; ++ii) {
+            m_v = m_U.col(ii);
+            m_AU.col(ii) = mvp(m_v);
+        }
+
+        m_E.compute(m_U.transpose()*m_AU);
+    }
+
+    template<typename DataType, typename VectorType>
+    template<typename MVPFunc, typename PCFunc>
+    unsigned int SolverCGDeflated<DataType, VectorType>::solve(VectorType &x, MVPFunc mvp, VectorType &rhs, unsigned int maxIter, PCFunc &pc) {
+
+        m_iterations = 0;
+
+        //warm start from the previous solutions
+        if(m_extrapolate && m_history.size() > 1) {
+            x = 2.0*m_history[0] - m_history[1];
+        } else if(m_extrapolate && m_history.size() == 1) {
+            x = m_history[0];
+        }
+
+        if(x.rows() != rhs.rows()) {
+            x.setZero(rhs.rows());
+        }
+
+        buildSubspace(mvp, rhs.rows());
+
+        //Galerkin correction, afterwards the residual is orthogonal to the subspace
+        m_r = rhs - mvp(x);
+
+        if(m_U.cols() > 0) {
+            x += m_U*m_E.solve(m_U.transpose()*m_r);
+            m_r = rhs - mvp(x);
+        }
+
+        if(m_r.norm() >= m_rtol) {
+
+            m_z = pc(m_r);
+            m_p = projectAOrthogonal(m_z);
+
+            DataType rz = m_r.dot(m_z);
+            DataType alpha, beta, rzNew;
+
+            for(m_iterations = 0; m_iterations<maxIter; ++m_iterations) {
+
+                m_Ap = mvp(m_p);
+                alpha = rz/m_p.dot(m_Ap);
+                x += alpha*m_p;
+                m_r -= alpha*m_Ap;
+
+                if(m_r.norm() < m_rtol) {
+                    ++m_iterations;
+                    break;
+                }
+
+                m_z = pc(m_r);
+                rzNew = m_r.dot(m_z);
+                beta = rzNew/rz;
+                rz = rzNew;
+
+                m_p = beta*m_p + projectAOrthogonal(m_z);
+            }
+        }
+
+        //recycle the converged solution
+        if(m_numRecycled > 0) {
+            m_history.push_front(x);
+
+            if(m_history.size() > m_numRecycled) {
+                m_history.pop_back();
+            }
+        }
+
+        return m_iterations;
+    }
+}
+#endif /* SolverCGDeflated_h */
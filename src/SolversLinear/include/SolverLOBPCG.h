@@ -0,0 +1,259 @@
+//
+//  SolverLOBPCG.h
+//  Gauss
+//
+//  Locally Optimal Block Preconditioned Conjugate Gradient (Knyazev 2001) for K u = lambda M u
+//
+//
+
+#ifndef SolverLOBPCG_h
+#define SolverLOBPCG_h
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <Eigen/Dense>
+
+namespace Gauss {
+
+    //Finds the smallest eigenpairs of K u = lambda M u with K symmetric positive semi-definite and M symmetric positive definite.
+    //K, M and the preconditioner are only ever applied to blocks of vectors so nothing needs to be factored, the cost per iteration is
+    //a few sparse matrix products and dense operations on (n x 3*blockSize) matrices.
+    //The last block of eigenvectors is kept and used as the initial guess for the next call.
+    template<typename DataType>
+    class SolverLOBPCG
+    {
+    public:
+
+        using MatrixType = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic>;
+        using VectorType = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+
+        SolverLOBPCG(unsigned int maxIter = 500, DataType tol = 1e-6) {
+            m_maxIter = maxIter;
+            m_tol = tol;
+            m_iterations = 0;
+            m_numVecs = 0;
+        }
+
+        //KOp, MOp and PCOp take an n x k matrix and return an n x k matrix (i.e [&K](const auto &x) -> MatrixType { return K*x; })
+        //returns true if the first numVecs eigenpairs converged, eigenvalues are ascending, eigenvectors are M-orthonormal
+        template<typename KOp, typename MOp, typename PCOp>
+        bool compute(KOp Kop, MOp Mop, PCOp pc, unsigned int n, unsigned int numVecs);
+
+        //no preconditioner
+        template<typename KOp, typename MOp>
+        bool compute(KOp Kop, MOp Mop, unsigned int n, unsigned int numVecs) {
+            return compute(Kop, Mop, [](const MatrixType &x) -> MatrixType { return x; }, n, numVecs);
+        }
+
+        //fewer than numVecs columns if compute failed on a rank deficient block
+        inline MatrixType eigenvectors() const { return m_X.leftCols(std::min(m_numVecs, static_cast<unsigned int>(m_X.cols()))); }
+        inline VectorType eigenvalues() const { return m_lambda.head(std::min(m_numVecs, static_cast<unsigned int>(m_lambda.rows()))); }
+        inline unsigned int getNumIterations() const { return m_iterations; }
+
+        //forget the previous eigenvectors
+        inline void reset() { m_X.resize(0,0); }
+
+    protected:
+
+        //SVQB: returns T such that (S*T)'M(S*T) = I, directions that are numerically dependent are dropped
+        MatrixType orthonormalizer(const MatrixType &S, const MatrixType &MS) const;
+
+        //Rayleigh-Ritz on the block X, directions that are numerically dependent are replaced by random ones.
+        //Returns false if the block still has fewer than blockSize columns
+        template<typename KOp, typename MOp>
+        bool rayleighRitz(KOp &Kop, MOp &Mop, unsigned int blockSize, MatrixType &KX, MatrixType &MX);
+
+        unsigned int m_maxIter, m_iterations, m_numVecs;
+        DataType m_tol;
+
+        MatrixType m_X;
+        VectorType m_lambda;
+
+    private:
+    };
+
+    template<typename DataType>
+    typename SolverLOBPCG<DataType>::MatrixType SolverLOBPCG<DataType>::orthonormalizer(const MatrixType &S, const MatrixType &MS) const {
+
+        MatrixType G = S.transpose()*MS;
+        G = 0.5*(G + G.transpose()).eval();
+
+        VectorType D = G.diagonal().cwiseAbs().cwiseMax(std::numeric_limits<DataType>::min()).cwiseSqrt().cwiseInverse();
+        G = D.asDiagonal()*G*D.asDiagonal();
+
+        Eigen::SelfAdjointEigenSolver<MatrixType> es(G);
+        //the Gram matrix squares the condition number so anything below ~sqrt(eps) can't be trusted
+        DataType cutoff = 1e-10*es.eigenvalues().cwiseAbs().maxCoeff();
+
+        std::vector<unsigned int> keep;
+        for(unsigned int ii=0; ii<es.eigenvalues().rows(); ++ii) {
+            if(es.eigenvalues()[ii] > cutoff) {
+                keep.push_back(ii);
+            }
+        }
+
+        MatrixType T(S.cols(), keep.size());
+        for(unsigned int ii=0; ii<keep.size(); ++ii) {
+            T.col(ii) = D.asDiagonal()*es.eigenvectors().col(keep[ii])/std::sqrt(es.eigenvalues()[keep[ii]]);
+        }
+
+        return T;
+    }
+
+    template<typename DataType>
+    template<typename KOp, typename MOp>
+    bool SolverLOBPCG<DataType>::rayleighRitz(KOp &Kop, MOp &Mop, unsigned int blockSize, MatrixType &KX, MatrixType &MX) {
+
+        MatrixType T = orthonormalizer(m_X, MX);
+
+        for(unsigned int attempt=0; attempt<3 && T.cols() < blockSize; ++attempt) {
+            MatrixType X(m_X.rows(), blockSize);
+            X << m_X*T, MatrixType::Random(m_X.rows(), blockSize - T.cols());
+            m_X = X;
+            KX = Kop(m_X);
+            MX = Mop(m_X);
+            T = orthonormalizer(m_X, MX);
+        }
+
+        MatrixType Kr = T.transpose()*(m_X.transpose()*KX)*T;
+        Eigen::SelfAdjointEigenSolver<MatrixType> es(0.5*(Kr + Kr.transpose()));
+
+        MatrixType C = T*es.eigenvectors();
+
+        m_X = m_X*C;
+        KX = KX*C;
+        MX = MX*C;
+        m_lambda = es.eigenvalues();
+
+        return m_X.cols() >= blockSize;
+    }
+
+    template<typename DataType>
+    template<typename KOp, typename MOp, typename PCOp>
+    bool SolverLOBPCG<DataType>::compute(KOp Kop, MOp Mop, PCOp pc, unsigned int n, unsigned int numVecs) {
+
+        //guard vectors speed up convergence of the last requested modes
+        unsigned int blockSize = std::min(n, numVecs + std::min(numVecs, 8u));
+
+        m_numVecs = numVecs;
+        m_iterations = 0;
+
+        //warm start from the previous eigenvectors if the problem size hasn't changed
+        if(m_X.rows() != n || m_X.cols() != blockSize) {
+            m_X = MatrixType::Random(n, blockSize);
+        }
+
+        MatrixType KX = Kop(m_X);
+        MatrixType MX = Mop(m_X);
+        MatrixType P(n, 0), KP(n, 0), MP(n, 0), W, KW, MW, R;
+
+        //Rayleigh-Ritz on the initial block (a warm start can be rank deficient)
+        if(!rayleighRitz(Kop, Mop, blockSize, KX, MX)) {
+            std::cout<<"LOBPCG: initial block is rank deficient \n";
+            return false;
+        }
+
+        bool converged = false;
+        DataType normK = 0;
+
+        for(m_iterations = 0; m_iterations < m_maxIter; ++m_iterations) {
+
+            R = KX - MX*m_lambda.asDiagonal();
+
+            //soft locking, converged columns don't get new search directions
+            //residuals of (near) zero modes bottom out at round off in K*x so they're measured against the estimate of |K|
+            std::vector<unsigned int> active;
+
+            for(unsigned int ii=0; ii<m_X.cols(); ++ii) {
+                DataType floor = 100*std::numeric_limits<DataType>::epsilon()*normK*m_X.col(ii).norm();
+                
+                if(R.col(ii).norm() > m_tol*std::abs(m_lambda[ii])*MX.col(ii).norm() + floor) {
+                    active.push_back(ii);
+                }
+            }
+
+            if(active.empty() || active.front() >= numVecs) {
+                converged = true;
+                break;
+            }
+
+            MatrixType Ra(n, active.size());
+            for(unsigned int ii=0; ii<active.size(); ++ii) {
+                Ra.col(ii) = R.col(active[ii]);
+            }
+
+            W = pc(Ra);
+            
+            //X is M-orthonormal, remove its component from W and P before building the basis
+            W -= m_X*(MX.transpose()*W);
+            KW = Kop(W);
+            MW = Mop(W);
+            
+            //preconditioned residuals are rich in high frequencies, good for estimating |K|
+            for(unsigned int ii=0; ii<W.cols(); ++ii) {
+                if(W.col(ii).norm() > 0) {
+                    normK = std::max(normK, KW.col(ii).norm()/W.col(ii).norm());
+                }
+            }
+            
+            if(P.cols() > 0) {
+                MatrixType XMP = MX.transpose()*P;
+                P -= m_X*XMP;
+                KP -= KX*XMP;
+                MP -= MX*XMP;
+            }
+
+            //search space [X W P]
+            unsigned int nx = m_X.cols(), nw = W.cols(), np = P.cols();
+            MatrixType S(n, nx + nw + np), KS(n, nx + nw + np), MS(n, nx + nw + np);
+            S << m_X, W, P;
+            KS << KX, KW, KP;
+            MS << MX, MW, MP;
+
+            MatrixType T = orthonormalizer(S, MS);
+
+            //basis lost directions, restart without P
+            if(T.cols() < S.cols() && np > 0) {
+                P.resize(n, 0); KP.resize(n, 0); MP.resize(n, 0);
+                S.conservativeResize(n, nx + nw); KS.conservativeResize(n, nx + nw); MS.conservativeResize(n, nx + nw);
+                T = orthonormalizer(S, MS);
+                np = 0;
+            }
+
+            MatrixType Kr = T.transpose()*(S.transpose()*KS)*T;
+            Eigen::SelfAdjointEigenSolver<MatrixType> es(0.5*(Kr + Kr.transpose()));
+
+            unsigned int k = std::min(nx, static_cast<unsigned int>(es.eigenvalues().rows()));
+            MatrixType C = T*es.eigenvectors().leftCols(k);
+
+            //new P is the part of the update that doesn't come from the old X
+            P = S.rightCols(nw + np)*C.bottomRows(nw + np);
+            KP = KS.rightCols(nw + np)*C.bottomRows(nw + np);
+            MP = MS.rightCols(nw + np)*C.bottomRows(nw + np);
+
+            //KX and MX are recomputed rather than updated, the recurrence drifts once the residuals reach round off
+            //and the residual is what decides convergence
+            m_X = m_X*C.topRows(nx) + P;
+            KX = Kop(m_X);
+            MX = Mop(m_X);
+            m_lambda = es.eigenvalues().head(k);
+
+            //even [X W] lost directions, refill the block and restart without P
+            if(k < nx) {
+                P.resize(n, 0); KP.resize(n, 0); MP.resize(n, 0);
+
+                if(!rayleighRitz(Kop, Mop, nx, KX, MX)) {
+                    std::cout<<"LOBPCG: block is rank deficient \n";
+                    break;
+                }
+            }
+        }
+
+        return converged;
+    }
+}
+
+#endif /* SolverLOBPCG_h */
@@ -0,0 +1,132 @@
+//
+//  SolverMixedPrecision.h
+//  Gauss
+//
+//  Factor in single precision, recover double precision accuracy with iterative refinement or preconditioned CG
+//
+//
+
+#ifndef SolverMixedPrecision_h
+#define SolverMixedPrecision_h
+
+#include <iostream>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <SolverCGDeflated.h>
+
+namespace Gauss {
+
+    //Precision used by the direct solve in the timesteppers
+    //Double         : factor and solve in DataType (default)
+    //MixedRefinement: factor in float, iterative refinement with DataType residuals
+    //MixedPCG       : factor in float, use it as a preconditioner for CG in DataType (matrix must be SPD, use
+    //                 MixedRefinement for indefinite matrices such as the KKT matrix of a constrained system)
+    enum class SolverPrecision { Double, MixedRefinement, MixedPCG };
+
+    template<typename DataType, typename FactorType = float>
+    class SolverMixedPrecision
+    {
+    public:
+
+        using SparseMatrix = Eigen::SparseMatrix<DataType>;
+        using VectorType = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+
+        SolverMixedPrecision(SolverPrecision mode = SolverPrecision::MixedRefinement, unsigned int maxIter = 10, DataType rtol = 1e-10) : m_cg(rtol, 4, false) {
+            m_mode = mode;
+            m_maxIter = maxIter;
+            m_rtol = rtol;
+            m_info = Eigen::Success;
+            m_iterations = 0;
+            m_lastRows = 0;
+        }
+
+        //keep a DataType copy of A for residuals, the factor itself is stored in FactorType
+        template<typename MatrixType>
+        void compute(const MatrixType &A) {
+            m_A = A;
+            m_factor.compute(m_A.template cast<FactorType>());
+
+            if(m_A.rows() != m_lastRows) {
+                m_cg.clearRecycled();
+                m_lastRows = m_A.rows();
+            }
+            m_info = m_factor.info();
+        }
+
+        template<typename Vector>
+        VectorType solve(const Vector &b) {
+
+            VectorType rhs = b;
+            VectorType x = lowSolve(rhs);
+            DataType bNorm = rhs.norm();
+
+            m_iterations = 0;
+            m_info = Eigen::Success;
+
+            if(bNorm == 0) {
+                return x;
+            }
+
+            if(m_mode == SolverPrecision::MixedPCG) {
+
+                //float factor as preconditioner, CG does the accumulation in DataType
+                //the CG solver persists so previous solutions deflate the next solve, the float solve is a better initial guess than extrapolation
+                auto mvp = [this](VectorType &v) -> VectorType { return m_A*v; };
+                auto pc = [this](VectorType &r) -> VectorType & { m_z = lowSolve(r); return m_z; };
+
+                m_cg.setTolerance(m_rtol*bNorm);
+                m_iterations = m_cg.solve(x, mvp, rhs, m_maxIter, pc);
+
+                //CG stops on its updated residual, report failure based on the true one
+                if((rhs - m_A*x).norm() >= m_rtol*bNorm) {
+                    m_info = Eigen::NoConvergence;
+                }
+
+                return x;
+            }
+
+            //x_k+1 = x_k + inv(A_float)*(b - A*x_k), residual computed in DataType
+            VectorType r = rhs - m_A*x;
+            for(m_iterations = 0; m_iterations < m_maxIter && r.norm() >= m_rtol*bNorm; ++m_iterations) {
+                x += lowSolve(r);
+                r = rhs - m_A*x;
+            }
+
+            if(r.norm() >= m_rtol*bNorm) {
+                m_info = Eigen::NoConvergence;
+            }
+
+            return x;
+        }
+
+        //switch between refinement and PCG, keeps the factorization
+        inline void setMode(SolverPrecision mode) { m_mode = mode; }
+
+        //result of the last compute or solve, NoConvergence if solve did not reach the residual tolerance in maxIter iterations
+        inline Eigen::ComputationInfo info() const { return m_info; }
+        inline unsigned int getNumIterations() const { return m_iterations; }
+        inline SolverPrecision getMode() const { return m_mode; }
+
+    protected:
+
+        inline VectorType lowSolve(const VectorType &r) {
+            return m_factor.solve(r.template cast<FactorType>()).template cast<DataType>();
+        }
+
+        SolverPrecision m_mode;
+        unsigned int m_maxIter, m_iterations;
+        long m_lastRows;
+        DataType m_rtol;
+        Eigen::ComputationInfo m_info;
+
+        SparseMatrix m_A;
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<FactorType> > m_factor;
+        VectorType m_z;
+        SolverCGDeflated<DataType, VectorType> m_cg;
+
+    private:
+    };
+}
+
+#endif /* SolverMixedPrecision_h */
@@ -0,0 +1,111 @@
+//
+//  SolverMultiRHS.h
+//  Gauss
+//
+//  Solve against many right hand sides at once using an already factored matrix.
+//
+//
+
+#ifndef SolverMultiRHS_h
+#define SolverMultiRHS_h
+
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <SolverPardiso.h>
+
+namespace Gauss {
+
+    //Generic fallback, just hand the whole block to the solver
+    template<typename Solver, typename DerivedB>
+    inline Eigen::Matrix<typename DerivedB::Scalar, Eigen::Dynamic, Eigen::Dynamic> solveMultipleRHS(Solver &solver, const Eigen::MatrixBase<DerivedB> &B, unsigned int blockSize = 16) {
+        return solver.solve(B);
+    }
+
+    //Blocked forward/back substitution for Eigen's simplicial LDLT factorization (P*A*P' = L*D*L').
+    //Eigen solves each column of B separately which means the factor is streamed through the cache once per column.
+    //Here a panel of blockSize columns is stored row-major so every nonzero of L updates the whole panel at once and the factor
+    //is traversed once per block instead of once per column.
+    template<typename MatrixType, int UpLo, typename Ordering, typename DerivedB>
+    inline Eigen::Matrix<typename DerivedB::Scalar, Eigen::Dynamic, Eigen::Dynamic> solveMultipleRHS(Eigen::SimplicialLDLT<MatrixType, UpLo, Ordering> &solver, const Eigen::MatrixBase<DerivedB> &B, unsigned int blockSize = 16) {
+
+        using Scalar = typename DerivedB::Scalar;
+        using Panel = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        using Factor = typename std::remove_const<typename std::remove_reference<decltype(solver.matrixL().nestedExpression())>::type>::type;
+
+        const Factor &L = solver.matrixL().nestedExpression();
+        const auto &D = solver.vectorD();
+        const long n = B.rows();
+
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> X(n, B.cols());
+        Panel panel;
+
+        blockSize = std::max(blockSize, 1u);
+
+        for(long col = 0; col < B.cols(); col += blockSize) {
+
+            long numCols = std::min(static_cast<long>(blockSize), static_cast<long>(B.cols()) - col);
+
+            if(solver.permutationP().size() > 0) {
+                panel = solver.permutationP()*B.middleCols(col, numCols);
+            } else {
+                panel = B.middleCols(col, numCols);
+            }
+
+            //L*Y = P*B
+            for(long j = 0; j < n; ++j) {
+                for(typename Factor::InnerIterator it(L, j); it; ++it) {
+                    if(it.index() > j) {
+                        panel.row(it.index()) -= it.value()*panel.row(j);
+                    }
+                }
+            }
+
+            //D*Z = Y
+            for(long j = 0; j < n; ++j) {
+                panel.row(j) /= D[j];
+            }
+
+            //L'*W = Z
+            for(long j = n-1; j >= 0; --j) {
+                for(typename Factor::InnerIterator it(L, j); it; ++it) {
+                    if(it.index() > j) {
+                        panel.row(j) -= it.value()*panel.row(it.index());
+                    }
+                }
+            }
+
+            if(solver.permutationPinv().size() > 0) {
+                X.middleCols(col, numCols) = solver.permutationPinv()*panel;
+            } else {
+                X.middleCols(col, numCols) = panel;
+            }
+        }
+
+        return X;
+    }
+
+#ifdef GAUSS_PARDISO
+    //Pardiso does its own blocked substitution when nrhs > 1, we just feed it column panels of B so the
+    //workspace it allocates stays bounded for very wide right hand sides
+    template<typename DerivedB>
+    inline Eigen::MatrixXd solveMultipleRHS(SolverPardiso<Eigen::SparseMatrix<double, Eigen::RowMajor> > &solver, const Eigen::MatrixBase<DerivedB> &B, unsigned int blockSize = 16) {
+
+        Eigen::MatrixXd X(B.rows(), B.cols());
+        Eigen::MatrixXd panel;
+
+        blockSize = std::max(blockSize, 1u);
+
+        for(long col = 0; col < B.cols(); col += blockSize) {
+            long numCols = std::min(static_cast<long>(blockSize), static_cast<long>(B.cols()) - col);
+            panel = B.middleCols(col, numCols);
+            X.middleCols(col, numCols) = solver.solve(panel);
+        }
+
+        return X;
+    }
+#endif
+}
+
+#endif /* SolverMultiRHS_h */
@@ -120,7 +120,7 @@ public:
     }
     
     int compute(Eigen::SparseMatrix<double, Eigen::RowMajor> &A, unsigned int nrhs = 1) {
-        symbolicFactorization(A,1);
+        symbolicFactorization(A,nrhs);
         numericalFactorization();
         return 0;
     }
@@ -143,6 +143,7 @@ public:
         return 1;
     }
 
+    //rhs can have multiple columns, pardiso then does the forward/back substitution for all of them in one pass
     template<typename Vector>
     const auto &  solve(Vector &rhs) {
         int phase = 33;
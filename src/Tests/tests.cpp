@@ -1,4 +1,5 @@
 #include <iostream>
+#include <set>
 #include <gtest/gtest.h>
 
 //Gauss Includes
@@ -10,9 +11,14 @@
 #include <AssemblerParallel.h>
 #include <Utilities.h>
 #include <UtilitiesEigen.h>
+#include <UtilitiesGeometry.h>
 #include <Assembler.h>
 #include <AssemblerMVP.h>
 #include <TimeStepperEulerImplicitLinear.h>
+#include <TimeStepperEulerImplicit.h>
+#include <TimeStepperEulerImplicitNewtonKrylov.h>
+#include <TimeStepperAdaptive.h>
+#include <TimeStepperEulerIMEX.h>
 #include <ForceSpring.h>
 #include <ConstraintFixedPoint.h>
 
@@ -20,17 +26,61 @@
 #include <Element.h>
 #include <PhysicalSystemFEM.h>
 #include <FEMIncludes.h>
+#include <TimeStepperProjectiveDynamics.h>
+#include <TimeStepperVertexBlockDescent.h>
 
 //Eigen
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#ifdef GAUSS_FCL
+#include <CollisionsFCL.h>
+#endif
+
+//Collisions
+#include <CollisionsSelf.h>
+#include <CollisionsCCD.h>
+#include <CollisionsSDF.h>
+#include <TimeStepperEulerImplicitLinearCollisions.h>
+#include <SolverContactQP.h>
+#include <ForceBarrier.h>
+
 //CG Solver
 #include <SolverCG.h>
+#include <SolverCGDeflated.h>
+
+//Direct solvers
+#include <SolverMultiRHS.h>
+#include <SolverMixedPrecision.h>
+
+//Eigensolvers
+#include <SolverLOBPCG.h>
 
 using namespace Gauss;
 using namespace ParticleSystem;
 
+//[0,1]^3 split into 5 tets, shared by the contact tests
+void unitCubeTets(Eigen::MatrixXd &V, Eigen::MatrixXi &F) {
+    
+    V.resize(8,3);
+    F.resize(5,4);
+    
+    V << 0, 0, 0,
+         1, 0, 0,
+         1, 1, 0,
+         0, 1, 0,
+         0, 0, 1,
+         1, 0, 1,
+         1, 1, 1,
+         0, 1, 1;
+    
+    F << 0, 1, 3, 4,
+         1, 2, 3, 6,
+         1, 3, 4, 6,
+         3, 4, 6, 7,
+         1, 4, 5, 6;
+}
+
 
 //Single Particle Tests
 /*TEST (SingleParticleTest, Tests) {
@@ -429,6 +479,1837 @@ TEST(MVP, TestCG2) {
 }
 #endif
 
+TEST(MVP, TestCGDeflated) {
+    
+    //Recycled and deflated CG vs. plain CG (with the same extrapolated initial guess) and a direct solve
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, LinearTet> FEMLinearTets;
+    
+    typedef World<double, std::tuple<FEMLinearTets *>, std::tuple<ForceSpring<double> *>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    
+    MyWorld world;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    FEMLinearTets *test = new FEMLinearTets(V,F);
+    
+    world.addSystem(test);
+    fixDisplacementMin(world, test);
+    world.finalize();
+    
+    auto q = mapStateEigen(world);
+    q.setZero();
+    
+    AssemblerEigenSparseMatrix<double> M, K;
+    ASSEMBLEMATINIT(M, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+    ASSEMBLELIST(M, world.getSystemList(), getMassMatrix);
+    ASSEMBLEEND(M);
+    
+    ASSEMBLEMATINIT(K, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+    ASSEMBLELIST(K, world.getSystemList(), getStiffnessMatrix);
+    ASSEMBLELIST(K, world.getForceList(), getStiffnessMatrix);
+    ASSEMBLEEND(K);
+    
+    double dt = 0.01;
+    //K is dF/dq (negative semi-definite), M - dt*dt*K is the SPD implicit Euler system matrix
+    Eigen::SparseMatrix<double> A = ((*M) - dt*dt*(*K)).eval();
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > direct(A);
+    
+    auto mvp = [&A](auto &y)->Eigen::VectorXd {return A*y;};
+    
+    unsigned int n = world.getNumQDotDOFs();
+    
+    //deflation space, the lowest modes of A
+    Eigen::MatrixXd Adense = A;
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigs(Adense);
+    Eigen::MatrixXd W = eigs.eigenvectors().leftCols(10);
+    
+    //1. a load travelling along the beam, the right hand sides vary slowly but don't lie in a low dimensional subspace.
+    //Deflation + recycling has to beat plain CG started from the same extrapolated guess (2*x(i-1) - x(i-2))
+    SolverCGDeflated<double, Eigen::VectorXd> pcg(1e-8);
+    pcg.setDeflationSpace(W);
+    
+    //no recycling and no extrapolation is plain CG, the initial guess is set by hand
+    SolverCGDeflated<double, Eigen::VectorXd> plain(1e-8, 0, false);
+    SolverCG<double, Eigen::VectorXd> cg(1e-8);
+    
+    double xMin = V.col(0).minCoeff(), length = V.col(0).maxCoeff() - xMin;
+    Eigen::VectorXd f(n), x, xExtrapolated, xCG;
+    std::vector<Eigen::VectorXd> solutions;
+    
+    for(unsigned int ii=0; ii<8; ++ii) {
+        
+        double center = xMin + 0.1*length*(1 + ii);
+        
+        for(unsigned int jj=0; jj<V.rows(); ++jj) {
+            double r = (V(jj,0) - center)/(0.1*length);
+            f.segment<3>(3*jj) << 0, -1000.0*std::exp(-r*r), 500.0*r*std::exp(-r*r);
+        }
+        
+        x = 0*f;
+        xCG = 0*f;
+        xExtrapolated = (ii > 1 ? (2.0*solutions[ii-1] - solutions[ii-2]).eval() : (ii > 0 ? solutions[0] : 0*f));
+        
+        unsigned int iterations = pcg.solve(x, mvp, f, 100000);
+        unsigned int extrapolatedIterations = plain.solve(xExtrapolated, mvp, f, 100000);
+        cg.solve(xCG, mvp, f, 100000);
+        
+        ASSERT_LT(iterations, extrapolatedIterations);
+        ASSERT_LE((x-xCG).norm()/xCG.norm(), 1e-6);
+        ASSERT_LE((x-direct.solve(f)).norm()/f.norm(), 1e-8);
+        
+        solutions.push_back(x);
+    }
+    
+    //2. independent random right hand sides, nothing to recycle or extrapolate. The deflation space alone has to beat plain CG
+    SolverCGDeflated<double, Eigen::VectorXd> deflated(1e-8, 0, false);
+    deflated.setDeflationSpace(W);
+    
+    for(unsigned int ii=0; ii<4; ++ii) {
+        
+        f = 10.0*Eigen::VectorXd::Random(n);
+        x = 0*f;
+        Eigen::VectorXd xPlain = 0*f;
+        
+        unsigned int iterations = deflated.solve(x, mvp, f, 100000);
+        unsigned int plainIterations = plain.solve(xPlain, mvp, f, 100000);
+        
+        ASSERT_LT(iterations, plainIterations);
+        ASSERT_LE((x-direct.solve(f)).norm()/f.norm(), 1e-8);
+    }
+}
+
+TEST(FEM, ReorderMesh) {
+    
+    //reordered mesh is the same mesh (same vertices, same element volumes), RCM cuts the bandwidth of the beam (481 in
+    //file order) to a fraction and the permutation maps everything back to the file order
+    Eigen::MatrixXd V, V0;
+    Eigen::MatrixXi F, F0;
+    
+    readTetgen(V0, F0, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    auto bandwidth = [](Eigen::MatrixXi &F) {
+        int bw = 0;
+        for(unsigned int iel=0; iel<F.rows(); ++iel) {
+            bw = std::max(bw, F.row(iel).maxCoeff() - F.row(iel).minCoeff());
+        }
+        return bw;
+    };
+    
+    //lexicographically sorted rows, order independent
+    auto sortedRows = [](const Eigen::MatrixXd &V) {
+        std::vector<std::vector<double> > rows(V.rows());
+        for(unsigned int ii=0; ii<V.rows(); ++ii) {
+            for(unsigned int jj=0; jj<V.cols(); ++jj) {
+                rows[ii].push_back(V(ii,jj));
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+    
+    //signed volume of every element
+    auto volumes = [](const Eigen::MatrixXd &V, const Eigen::MatrixXi &F) {
+        Eigen::VectorXd vol(F.rows());
+        for(unsigned int iel=0; iel<F.rows(); ++iel) {
+            Eigen::Matrix3d E;
+            E << V.row(F(iel,1)) - V.row(F(iel,0)), V.row(F(iel,2)) - V.row(F(iel,0)), V.row(F(iel,3)) - V.row(F(iel,0));
+            vol[iel] = E.determinant()/6.0;
+        }
+        return vol;
+    };
+    
+    V = V0;
+    F = F0;
+    
+    MeshPermutation perm = reorderMesh(V, F, MeshOrdering::RCM);
+    
+    ASSERT_EQ(V.rows(), V0.rows());
+    ASSERT_EQ(F.rows(), F0.rows());
+    ASSERT_LT(bandwidth(F), bandwidth(F0));
+    ASSERT_LE(4*bandwidth(F), bandwidth(F0));
+    
+    ASSERT_TRUE(sortedRows(V) == sortedRows(V0));
+    
+    Eigen::VectorXd vol = volumes(V,F), vol0 = volumes(V0,F0);
+    
+    for(unsigned int iel=0; iel<F.rows(); ++iel) {
+        ASSERT_EQ(vol[iel], vol0[perm.elementNewToOld[iel]]);
+    }
+    
+    ASSERT_EQ((perm.toOriginalVertexOrder(V) - V0).norm(), 0);
+    
+    for(unsigned int iel=0; iel<F.rows(); ++iel) {
+        for(unsigned int ii=0; ii<F.cols(); ++ii) {
+            ASSERT_EQ(perm.vertexNewToOld[F(iel,ii)], F0(perm.elementNewToOld[iel], ii));
+        }
+    }
+}
+
+TEST(Newton, FullModeMatchesNewtonAssembler) {
+    
+    //a full Newton TimeStepperEulerImplicit does one factorization per iteration and lands where the plain
+    //NewtonSearchWithBackTracking/DirectionNewtonAssembler step started from zero does
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef Assembler<double, AssemblerImplEigenSparseMatrix> MatrixAssembler;
+    typedef Assembler<double, AssemblerImplEigenVector> VectorAssembler;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    //world is stepped by hand below (the ASSEMBLE macros expect that name), worldFull by the time stepper
+    MyWorld world, worldFull;
+    FEMTets *testFull = new FEMTets(V,F);
+    FEMTets *test = new FEMTets(V,F);
+    
+    worldFull.addSystem(testFull);
+    world.addSystem(test);
+    fixDisplacementMin(worldFull, testFull);
+    fixDisplacementMin(world, test);
+    worldFull.finalize();
+    world.finalize();
+    
+    mapStateEigen(worldFull).setZero();
+    mapStateEigen(world).setZero();
+    
+    double dt = 0.01;
+    TimeStepperEulerImplicit<double, MatrixAssembler, VectorAssembler> stepper(dt, 100, Optimization::HessianMode::Full, 20, 0.5, PredictorType::Zero);
+    
+    Optimization::NewtonSearchWithBackTracking<double> newton;
+    MatrixAssembler massMatrix, stiffnessMatrix, AeqMatrix;
+    VectorAssembler forceVector, bVector;
+    
+    unsigned int numIterations = 0;
+    
+    for(unsigned int istep=0; istep<10; ++istep) {
+        
+        stepper.step(worldFull);
+        numIterations += stepper.getImpl().getNewtonReport().iterations;
+        
+        //reference step
+        Eigen::VectorXd q = mapStateEigen<0>(world);
+        Eigen::VectorXd qDot = mapStateEigen<1>(world);
+        
+        ASSEMBLEMATINIT(massMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+        ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+        ASSEMBLEEND(massMatrix);
+        
+        auto E = [&](auto &a) {
+            return getEnergy(world) - a.head(world.getNumQDOFs()).transpose()*(*massMatrix)*qDot;
+        };
+        
+        auto H = [&](auto &a)->auto & {
+            ASSEMBLEMATINIT(stiffnessMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+            ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
+            ASSEMBLEEND(stiffnessMatrix);
+            (*stiffnessMatrix) *= -(dt*dt);
+            (*stiffnessMatrix) += (*massMatrix);
+            return stiffnessMatrix;
+        };
+        
+        auto Aeq = [&](auto &a)->auto & {
+            ASSEMBLEMATINIT(AeqMatrix, world.getNumConstraints(), world.getNumQDotDOFs());
+            ASSEMBLELISTCONSTRAINT(AeqMatrix, world.getConstraintList(), getGradient);
+            ASSEMBLEEND(AeqMatrix);
+            return AeqMatrix;
+        };
+        
+        auto g = [&](auto &a) -> auto & {
+            ASSEMBLEVECINIT(forceVector, world.getNumQDotDOFs());
+            ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+            ASSEMBLEEND(forceVector);
+            (*forceVector).head(world.getNumQDotDOFs()) *= -dt;
+            (*forceVector).head(world.getNumQDotDOFs()) += (*massMatrix)*(a.head(world.getNumQDOFs())-qDot);
+            return forceVector;
+        };
+        
+        auto b = [&](auto &a) -> auto & {
+            ASSEMBLEVECINIT(bVector, world.getNumConstraints());
+            ASSEMBLELISTCONSTRAINT(bVector, world.getConstraintList(), getDbDt);
+            ASSEMBLEEND(bVector);
+            return bVector;
+        };
+        
+        auto update = [&](auto &dx) {
+            mapStateEigen<1>(world) = dx.head(world.getNumQDOFs());
+            mapStateEigen<0>(world) = q + dt*dx.head(world.getNumQDOFs());
+        };
+        
+        Eigen::VectorXd x0(world.getNumQDotDOFs()+world.getNumConstraints());
+        x0.setZero();
+        newton(x0, E, g, H, b, Aeq, update, 1e-4, 100);
+        
+        ASSERT_LE((mapStateEigen(worldFull) - mapStateEigen(world)).norm(), 1e-8*(1.0 + mapStateEigen(world).norm()));
+    }
+    
+    ASSERT_GT(mapStateEigen<0>(worldFull).norm(), 0);
+    ASSERT_EQ(stepper.getImpl().getNumFactorizations(), numIterations);
+}
+
+TEST(Newton, KrylovMatchesDirect) {
+    
+    //the beam falling under its own weight, the matrix free Newton-Krylov stepper follows the factored Newton stepper to within
+    //the Newton tolerance and its directions actually come from CG
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef Assembler<double, AssemblerImplEigenSparseMatrix> MatrixAssembler;
+    typedef Assembler<double, AssemblerImplEigenVector> VectorAssembler;
+    typedef TimeStepperEulerImplicit<double, MatrixAssembler, VectorAssembler> DirectStepper;
+    typedef TimeStepperEulerImplicitNewtonKrylov<double, MatrixAssembler, VectorAssembler> KrylovStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.01;
+    unsigned int numSteps = 5;
+    
+    auto simulate = [&](auto &stepper) -> Eigen::VectorXd {
+        
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        
+        mapStateEigen(world).setZero();
+        
+        for(unsigned int istep=0; istep<numSteps; ++istep) {
+            stepper.step(world);
+            EXPECT_TRUE(stepper.getImpl().getNewtonReport().converged);
+        }
+        
+        return mapStateEigen(world);
+    };
+    
+    DirectStepper direct(dt, 100, Optimization::HessianMode::Full, 20, 0.5, PredictorType::Constant);
+    KrylovStepper krylov(dt, 100, 1000, 0, PredictorType::Constant);
+    
+    Eigen::VectorXd stateDirect = simulate(direct);
+    Eigen::VectorXd stateKrylov = simulate(krylov);
+    
+    ASSERT_GT(krylov.getImpl().getNumCGIterations(), 0);
+    ASSERT_GT(stateDirect.norm(), 0);
+    ASSERT_LE((stateKrylov - stateDirect).norm(), 1e-4*stateDirect.norm());
+}
+
+TEST(Newton, PredictorCutsIterations) {
+    
+    //the beam falling under its own weight with Newton started from zero, the current velocity or a quadratic extrapolation of the
+    //last velocities. The better the initial guess the fewer Newton iterations, the states agree to the Newton tolerance
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef Assembler<double, AssemblerImplEigenSparseMatrix> MatrixAssembler;
+    typedef Assembler<double, AssemblerImplEigenVector> VectorAssembler;
+    typedef TimeStepperEulerImplicit<double, MatrixAssembler, VectorAssembler> MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.01;
+    unsigned int numSteps = 20;
+    
+    std::array<PredictorType, 3> types = {{PredictorType::Zero, PredictorType::Constant, PredictorType::Quadratic}};
+    std::array<unsigned int, 3> iterations;
+    std::array<Eigen::VectorXd, 3> states;
+    
+    for(unsigned int ii=0; ii<types.size(); ++ii) {
+        
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        
+        mapStateEigen(world).setZero();
+        
+        MyTimeStepper stepper(dt, 100, Optimization::HessianMode::Full, 20, 0.5, types[ii]);
+        iterations[ii] = 0;
+        
+        for(unsigned int istep=0; istep<numSteps; ++istep) {
+            stepper.step(world);
+            ASSERT_TRUE(stepper.getImpl().getNewtonReport().converged);
+            iterations[ii] += stepper.getImpl().getNewtonReport().iterations;
+        }
+        
+        states[ii] = mapStateEigen(world);
+    }
+    
+    std::cout<<"Newton iterations (zero, constant, quadratic): "<<iterations[0]<<" "<<iterations[1]<<" "<<iterations[2]<<"\n";
+    
+    ASSERT_LT(iterations[1], iterations[0]);
+    ASSERT_LT(iterations[2], iterations[0]);
+    
+    for(unsigned int ii=1; ii<types.size(); ++ii) {
+        ASSERT_LE((states[ii] - states[0]).norm(), 1e-3*states[0].norm());
+    }
+}
+
+TEST(Newton, TimeBudget) {
+    
+    //budgeted Newton: a generous budget converges, an iteration cap or an exhausted deadline stop after one iteration with the
+    //residual of the best iterate, and an iterate with a non-finite residual (diverged) is never returned
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef Assembler<double, AssemblerImplEigenSparseMatrix> MatrixAssembler;
+    typedef Assembler<double, AssemblerImplEigenVector> VectorAssembler;
+    typedef TimeStepperEulerImplicit<double, MatrixAssembler, VectorAssembler> MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.05;
+    
+    //1. time steppers, budget, iteration cap and deadline
+    for(unsigned int test=0; test<3; ++test) {
+        
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        
+        mapStateEigen(world).setZero();
+        
+        MyTimeStepper stepper(dt, (test == 1 ? 1 : 100), Optimization::HessianMode::Full, 20, 0.5, PredictorType::Zero);
+        stepper.getImpl().setTimeBudget(test == 2 ? 1e-12 : 100.0);
+        stepper.step(world);
+        
+        const Optimization::NewtonReport &report = stepper.getImpl().getNewtonReport();
+        
+        ASSERT_TRUE(std::isfinite(report.initialResidual));
+        ASSERT_TRUE(std::isfinite(report.residual));
+        ASSERT_LE(report.residual, report.initialResidual);
+        ASSERT_GT(report.seconds, 0);
+        ASSERT_TRUE(mapStateEigen(world).allFinite());
+        
+        if(test == 0) {
+            ASSERT_TRUE(report.converged);
+            ASSERT_FALSE(report.outOfTime);
+            ASSERT_GT(report.iterations, 1);
+        } else {
+            ASSERT_EQ(report.iterations, 1);
+            ASSERT_FALSE(report.converged);
+            ASSERT_EQ(report.outOfTime, test == 2);
+        }
+    }
+    
+    //2. the gradient is NaN everywhere but at the starting point, every iterate diverges so the start is returned
+    MyWorld world;
+    FEMTets *beam = new FEMTets(V,F);
+    
+    world.addSystem(beam);
+    fixDisplacementMin(world, beam);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    
+    Eigen::VectorXd q = mapStateEigen<0>(world);
+    Eigen::VectorXd qDot = mapStateEigen<1>(world);
+    
+    Optimization::NewtonSearchWithBackTracking<double> newton;
+    MatrixAssembler massMatrix, stiffnessMatrix, AeqMatrix;
+    VectorAssembler forceVector, bVector;
+    
+    ASSEMBLEMATINIT(massMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+    ASSEMBLELIST(massMatrix, world.getSystemList(), getMassMatrix);
+    ASSEMBLEEND(massMatrix);
+    
+    auto E = [&](auto &a) {
+        return getEnergy(world) - a.head(world.getNumQDOFs()).transpose()*(*massMatrix)*qDot;
+    };
+    
+    auto H = [&](auto &a)->auto & {
+        ASSEMBLEMATINIT(stiffnessMatrix, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+        ASSEMBLELIST(stiffnessMatrix, world.getSystemList(), getStiffnessMatrix);
+        ASSEMBLEEND(stiffnessMatrix);
+        (*stiffnessMatrix) *= -(dt*dt);
+        (*stiffnessMatrix) += (*massMatrix);
+        return stiffnessMatrix;
+    };
+    
+    auto Aeq = [&](auto &a)->auto & {
+        ASSEMBLEMATINIT(AeqMatrix, world.getNumConstraints(), world.getNumQDotDOFs());
+        ASSEMBLELISTCONSTRAINT(AeqMatrix, world.getConstraintList(), getGradient);
+        ASSEMBLEEND(AeqMatrix);
+        return AeqMatrix;
+    };
+    
+    auto g = [&](auto &a) -> auto & {
+        ASSEMBLEVECINIT(forceVector, world.getNumQDotDOFs());
+        ASSEMBLELIST(forceVector, world.getSystemList(), getForce);
+        ASSEMBLEEND(forceVector);
+        (*forceVector).head(world.getNumQDotDOFs()) *= -dt;
+        (*forceVector).head(world.getNumQDotDOFs()) += (*massMatrix)*(a.head(world.getNumQDOFs())-qDot);
+        
+        if(a.norm() > 0) {
+            (*forceVector).setConstant(std::numeric_limits<double>::quiet_NaN());
+        }
+        
+        return forceVector;
+    };
+    
+    auto b = [&](auto &a) -> auto & {
+        ASSEMBLEVECINIT(bVector, world.getNumConstraints());
+        ASSEMBLELISTCONSTRAINT(bVector, world.getConstraintList(), getDbDt);
+        ASSEMBLEEND(bVector);
+        return bVector;
+    };
+    
+    auto update = [&](auto &dx) {
+        mapStateEigen<1>(world) = dx.head(world.getNumQDOFs());
+        mapStateEigen<0>(world) = q + dt*dx.head(world.getNumQDOFs());
+    };
+    
+    Eigen::VectorXd x0(world.getNumQDotDOFs()+world.getNumConstraints());
+    x0.setZero();
+    
+    newton.setTimeBudget(100.0);
+    newton(x0, E, g, H, b, Aeq, update, 1e-4, 3);
+    
+    ASSERT_EQ(newton.getReport().iterations, 3);
+    ASSERT_FALSE(newton.getReport().converged);
+    ASSERT_EQ(x0.norm(), 0);
+    ASSERT_EQ(newton.getReport().residual, newton.getReport().initialResidual);
+    ASSERT_EQ(mapStateEigen(world).norm(), 0);
+}
+
+TEST(TimeStepping, AdaptiveControlsError) {
+    
+    //the beam falling under its own weight from a much too large initial dt. Steps get rejected until the error estimate is
+    //met, advance lands exactly on the end time, the result is much closer to a fine fixed step reference than the coarse fixed
+    //step and tightening the tolerance takes more steps and lands closer still
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef TimeStepperEulerImplicitLinear<double, AssemblerEigenSparseMatrix<double>, AssemblerEigenVector<double> > MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double duration = 0.2;
+    
+    auto fixedSteps = [&](double dt) {
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        mapStateEigen(world).setZero();
+        
+        MyTimeStepper stepper(dt);
+        for(unsigned int istep=0; istep<std::round(duration/dt); ++istep) {
+            stepper.step(world);
+        }
+        
+        return Eigen::VectorXd(mapStateEigen<0>(world));
+    };
+    
+    Eigen::VectorXd reference = fixedSteps(2.5e-3);
+    double coarseError = (fixedSteps(0.1) - reference).norm();
+    
+    std::array<unsigned int, 2> numAccepted;
+    std::array<double, 2> errors;
+    std::array<double, 2> tolerances = {{1e-3, 1e-4}};
+    
+    for(unsigned int ii=0; ii<tolerances.size(); ++ii) {
+        
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        mapStateEigen(world).setZero();
+        
+        TimeStepperAdaptive<double, MyTimeStepper> stepper(0.1, tolerances[ii], 0.0);
+        stepper.advance(world, duration);
+        
+        ASSERT_NEAR(stepper.getTime(), duration, 1e-12);
+        ASSERT_GT(stepper.getNumRejected(), 0);
+        ASSERT_TRUE(mapStateEigen(world).allFinite());
+        
+        numAccepted[ii] = stepper.getNumAccepted();
+        errors[ii] = (Eigen::VectorXd(mapStateEigen<0>(world)) - reference).norm();
+        
+        ASSERT_LT(errors[ii], 0.2*coarseError);
+    }
+    
+    ASSERT_GT(numAccepted[1], numAccepted[0]);
+    ASSERT_LT(errors[1], errors[0]);
+}
+
+TEST(TimeStepping, ProjectiveDynamicsBeam) {
+    
+    //the cantilevered beam sags under gravity with its fixed DOFs held exactly in place, the local/global iterations of a step
+    //converge, and on the free beam every step changes linear momentum by exactly dt times the total body force (the ARAP
+    //projections exert no net force)
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef TimeStepperProjectiveDynamics<double, FEMTets> MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.01;
+    
+    {
+        MyWorld world;
+        FEMTets *beam = new FEMTets(V,F);
+        world.addSystem(beam);
+        fixDisplacementMin(world, beam);
+        world.finalize();
+        mapStateEigen(world).setZero();
+        
+        AssemblerEigenVector<double> force;
+        getForceVector(force, world);
+        Eigen::VectorXd fGravity = (*force);
+        
+        AssemblerEigenSparseMatrix<double> J;
+        ASSEMBLEMATINIT(J, world.getNumConstraints(), world.getNumQDotDOFs());
+        ASSEMBLELISTCONSTRAINT(J, world.getConstraintList(), getGradient);
+        ASSEMBLEEND(J);
+        
+        MyTimeStepper stepper(dt, 20);
+        
+        for(unsigned int istep=0; istep<20; ++istep) {
+            stepper.step(world);
+        }
+        
+        Eigen::VectorXd q = mapStateEigen<0>(world);
+        
+        ASSERT_TRUE(mapStateEigen(world).allFinite());
+        ASSERT_GT(world.getNumConstraints(), 0);
+        ASSERT_EQ(((*J)*q).norm(), 0);
+        ASSERT_GT(q.dot(fGravity), 0);
+    }
+    
+    MyWorld world;
+    FEMTets *beam = new FEMTets(V,F);
+    world.addSystem(beam);
+    world.finalize();
+    
+    srand(6);
+    mapStateEigen<0>(world) = 0.01*Eigen::VectorXd::Random(world.getNumQDOFs());
+    mapStateEigen<1>(world) = Eigen::VectorXd::Random(world.getNumQDotDOFs());
+    
+    Eigen::VectorXd state0 = mapStateEigen(world);
+    
+    //one step with a growing number of iterations
+    std::array<unsigned int, 3> iterations = {{2, 20, 200}};
+    std::array<Eigen::VectorXd, 3> states;
+    
+    AssemblerEigenSparseMatrix<double> mass;
+    getMassMatrix(mass, world);
+    
+    AssemblerEigenVector<double> force;
+    mapStateEigen<0>(world).setZero();
+    getForceVector(force, world);
+    
+    for(unsigned int ii=0; ii<iterations.size(); ++ii) {
+        
+        mapStateEigen(world) = state0;
+        
+        MyTimeStepper stepper(dt, iterations[ii]);
+        stepper.step(world);
+        
+        states[ii] = mapStateEigen<0>(world);
+        
+        for(unsigned int kk=0; kk<3; ++kk) {
+            
+            Eigen::VectorXd translation = Eigen::VectorXd::Zero(world.getNumQDotDOFs());
+            for(unsigned int jj=kk; jj<translation.rows(); jj+=3) {
+                translation[jj] = 1.0;
+            }
+            
+            double momentum0 = translation.dot((*mass)*state0.tail(world.getNumQDotDOFs()));
+            double momentum1 = translation.dot((*mass)*mapStateEigen<1>(world));
+            
+            ASSERT_NEAR(momentum1 - momentum0, dt*translation.dot(*force), 1e-8*(std::fabs(momentum0) + 1.0));
+        }
+    }
+    
+    ASSERT_LT((states[1] - states[2]).norm(), 1e-2*(states[0] - states[2]).norm());
+}
+
+TEST(TimeStepping, IMEXMatchesImplicit) {
+    
+    //the cantilevered beam falling under gravity. From rest K0 is the tangent stiffness so the first IMEX step is the linearly
+    //implicit Euler step. Once the beam has sagged the plain IMEX step leaves a residual in the implicit Euler equations
+    //M*(v+ - v) = dt*f(q + dt*v+) which the corrections shrink. The fixed DOFs stay in place
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef TimeStepperEulerIMEX<double, AssemblerEigenSparseMatrix<double>, AssemblerEigenVector<double> > MyTimeStepperIMEX;
+    typedef TimeStepperEulerImplicitLinear<double, AssemblerEigenSparseMatrix<double>, AssemblerEigenVector<double> > MyTimeStepperLinear;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.01;
+    
+    MyWorld world;
+    FEMTets *beam = new FEMTets(V,F);
+    world.addSystem(beam);
+    fixDisplacementMin(world, beam);
+    world.finalize();
+    mapStateEigen(world).setZero();
+    
+    AssemblerEigenSparseMatrix<double> J;
+    ASSEMBLEMATINIT(J, world.getNumConstraints(), world.getNumQDotDOFs());
+    ASSEMBLELISTCONSTRAINT(J, world.getConstraintList(), getGradient);
+    ASSEMBLEEND(J);
+    
+    AssemblerEigenSparseMatrix<double> mass;
+    getMassMatrix(mass, world);
+    
+    //implicit Euler residual of the step that ended in the current state, constrained DOFs are left out
+    Eigen::SparseMatrix<double> JTJ = (*J).transpose()*(*J);
+    Eigen::VectorXd isFree = (JTJ.diagonal().array() == 0).cast<double>();
+    
+    auto residual = [&](const Eigen::VectorXd &qDotOld) {
+        AssemblerEigenVector<double> force;
+        getForceVector(force, world);
+        
+        Eigen::VectorXd r = (*mass)*(mapStateEigen<1>(world) - qDotOld) - dt*(*force);
+        return r.cwiseProduct(isFree).norm();
+    };
+    
+    MyTimeStepperIMEX imex(dt), imexCorrected(dt, 3);
+    MyTimeStepperLinear linear(dt);
+    
+    linear.step(world);
+    Eigen::VectorXd xLinear = mapStateEigen(world);
+    
+    mapStateEigen(world).setZero();
+    imex.step(world);
+    
+    ASSERT_GT(xLinear.norm(), 0);
+    ASSERT_LE((Eigen::VectorXd(mapStateEigen(world)) - xLinear).norm(), 1e-8*xLinear.norm());
+    
+    for(unsigned int istep=1; istep<10; ++istep) {
+        imex.step(world);
+    }
+    
+    Eigen::VectorXd state = mapStateEigen(world);
+    Eigen::VectorXd qDotOld = mapStateEigen<1>(world);
+    
+    imex.step(world);
+    double r0 = residual(qDotOld);
+    
+    mapStateEigen(world) = state;
+    imexCorrected.step(world);
+    double r3 = residual(qDotOld);
+    
+    ASSERT_TRUE(mapStateEigen(world).allFinite());
+    ASSERT_LE(((*J)*mapStateEigen<0>(world)).norm(), 1e-10);
+    ASSERT_GT(r0, 0);
+    ASSERT_LT(r3, 1e-3*r0);
+}
+
+//exposes the vertex coloring
+template<typename FEMSystem>
+class TimeStepperImplVertexBlockDescentColors : public TimeStepperImplVertexBlockDescent<double, FEMSystem, AssemblerParallel<double, AssemblerEigenSparseMatrix<double> >, AssemblerParallel<double, AssemblerEigenVector<double> > > {
+public:
+    using TimeStepperImplVertexBlockDescent<double, FEMSystem, AssemblerParallel<double, AssemblerEigenSparseMatrix<double> >, AssemblerParallel<double, AssemblerEigenVector<double> > >::TimeStepperImplVertexBlockDescent;
+    
+    //color of every vertex, keyed by its first DOF
+    std::map<unsigned int, unsigned int> getColors() const {
+        std::map<unsigned int, unsigned int> colors;
+        for(unsigned int ii=0; ii<this->m_colors.size(); ++ii) {
+            for(auto vertex : this->m_colors[ii]) {
+                EXPECT_TRUE(colors.find(this->m_vertexDOF[vertex]) == colors.end());
+                colors[this->m_vertexDOF[vertex]] = ii;
+            }
+        }
+        return colors;
+    }
+};
+
+TEST(TimeStepping, VertexBlockDescentBeam) {
+    
+    //every vertex gets exactly one color and no element has two vertices of the same color. For a step of the falling cantilever
+    //the residual of the implicit Euler equations (lumped mass) shrinks with the number of sweeps, Chebyshev acceleration
+    //shrinks it faster and the fixed DOFs stay in place
+    using namespace Gauss;
+    using namespace FEM;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    typedef TimeStepper<double, TimeStepperImplVertexBlockDescentColors<FEMTets> > MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    
+    readTetgen(V, F, dataDir()+"/meshesTetgen/Beam/Beam.node", dataDir()+"/meshesTetgen/Beam/Beam.ele");
+    
+    double dt = 0.01;
+    
+    MyWorld world;
+    FEMTets *beam = new FEMTets(V,F);
+    world.addSystem(beam);
+    fixDisplacementMin(world, beam);
+    world.finalize();
+    mapStateEigen(world).setZero();
+    
+    MyTimeStepper stepper(dt, beam, 50);
+    
+    for(unsigned int istep=0; istep<5; ++istep) {
+        stepper.step(world);
+    }
+    
+    auto colors = stepper.getImpl().getColors();
+    auto &elements = beam->getImpl().getElements();
+    
+    ASSERT_EQ(colors.size(), static_cast<size_t>(V.rows()));
+    ASSERT_EQ(stepper.getImpl().getNumColors(), 1 + std::max_element(colors.begin(), colors.end(), [](auto &a, auto &b) { return a.second < b.second; })->second);
+    
+    for(unsigned int iel = 0; iel < elements.size(); ++iel) {
+        std::set<unsigned int> elementColors;
+        for(unsigned int ii=0; ii<4; ++ii) {
+            elementColors.insert(colors[elements[iel]->q()[ii]->getGlobalId()]);
+        }
+        ASSERT_EQ(elementColors.size(), 4u);
+    }
+    
+    AssemblerEigenSparseMatrix<double> J;
+    ASSEMBLEMATINIT(J, world.getNumConstraints(), world.getNumQDotDOFs());
+    ASSEMBLELISTCONSTRAINT(J, world.getConstraintList(), getGradient);
+    ASSEMBLEEND(J);
+    
+    AssemblerEigenSparseMatrix<double> mass;
+    getMassMatrix(mass, world);
+    Eigen::VectorXd lumped = (*mass)*Eigen::VectorXd::Ones(world.getNumQDotDOFs());
+    
+    Eigen::SparseMatrix<double> JTJ = (*J).transpose()*(*J);
+    Eigen::VectorXd isFree = (JTJ.diagonal().array() == 0).cast<double>();
+    
+    Eigen::VectorXd state = mapStateEigen(world);
+    Eigen::VectorXd y = mapStateEigen<0>(world) + dt*mapStateEigen<1>(world);
+    
+    //implicit Euler residual after one step from state
+    auto residual = [&](unsigned int iterations, double rho) {
+        mapStateEigen(world) = state;
+        
+        MyTimeStepper vbd(dt, beam, iterations, rho);
+        vbd.step(world);
+        
+        EXPECT_LE(((*J)*mapStateEigen<0>(world)).norm(), 1e-12);
+        
+        AssemblerEigenVector<double> force;
+        getForceVector(force, world);
+        
+        Eigen::VectorXd r = lumped.cwiseProduct(mapStateEigen<0>(world) - y)/(dt*dt) - (*force);
+        return r.cwiseProduct(isFree).norm();
+    };
+    
+    double r5 = residual(5, 0), r50 = residual(50, 0), r50Chebyshev = residual(50, 0.9);
+    
+    ASSERT_TRUE(mapStateEigen(world).allFinite());
+    ASSERT_LT(r50, 1e-2*r5);
+    ASSERT_LT(r50Chebyshev, 1e-2*r50);
+}
+
+#ifdef GAUSS_FCL
+TEST(Collisions, FCLOverlappingBoxes) {
+    
+    //two unit cubes overlapping in [0.5,1]x[0.25,1]x[0.25,1], every contact row pairs a surface vertex of the first box with one
+    //of the second and sits in the overlap. Pulled apart, the broad phase reports no pairs and there are no contacts
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    unitCubeTets(V, F);
+    
+    Eigen::MatrixXd V1 = V.rowwise() + Eigen::RowVector3d(0.5, 0.25, 0.25);
+    
+    MyWorld world;
+    FEMTets *box0 = new FEMTets(V,F);
+    FEMTets *box1 = new FEMTets(V1,F);
+    
+    world.addSystem(box0);
+    world.addSystem(box1);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    
+    CollisionFCLImpl<double> detector(world);
+    detector.detectCollisions(world);
+    
+    ASSERT_EQ(detector.getNumCandidatePairs(), 1);
+    ASSERT_GT(detector.getNumCollisions(), 0);
+    unsigned int numA = 0, numB = 0;
+    
+    forEach(detector.getCollisionsObjectA(), [&detector, &numA](auto &a) {
+        ++numA;
+        ASSERT_EQ(a.getObject().index(), 0);
+        ASSERT_GE(a.getData(0), 0);
+        ASSERT_LT(a.getData(0), 8);
+        
+        auto &shared = detector.getSharedInfo()[a.getShared()];
+        ASSERT_LE(std::abs(shared.getNormal().norm() - 1.0), 1e-8);
+        ASSERT_GE(shared.getDepth(), 0);
+        ASSERT_TRUE((shared.getPosition().array() >= Eigen::Array3d(0.5, 0.25, 0.25) - 1e-8).all());
+        ASSERT_TRUE((shared.getPosition().array() <= Eigen::Array3d(1.0, 1.0, 1.0) + 1e-8).all());
+    });
+    
+    forEach(detector.getCollisionsObjectB(), [&numB](auto &b) {
+        ++numB;
+        ASSERT_EQ(b.getObject().index(), 1);
+        ASSERT_GE(b.getData(0), 0);
+        ASSERT_LT(b.getData(0), 8);
+    });
+    
+    ASSERT_EQ(numA, detector.getNumCollisions());
+    ASSERT_EQ(numB, detector.getNumCollisions());
+    
+    //displace the second box, the detector refits its geometry
+    for(unsigned int ii=0; ii<8; ++ii) {
+        mapDOFEigen(box1->getQ(), world)[3*ii] = 2.0;
+    }
+    
+    detector.detectCollisions(world);
+    
+    ASSERT_EQ(detector.getNumCandidatePairs(), 0);
+    ASSERT_EQ(detector.getNumCollisions(), 0);
+}
+#endif
+
+TEST(Collisions, CCDStopsAtPlane) {
+    
+    //a cube falling fast enough to cross the floor in one step lands on it (at the contact thickness), it does not pass through
+    //the floor and does not hover where it was first detected. Both the full QP and the Schur complement contact solves are checked
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef ConstraintCollisionDetector<double, CollisionCCDImpl> CCD;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *, CCD *> > MyWorld;
+    typedef TimeStepperEulerImplicitLinearCollisions<double, AssemblerEigenSparseMatrix<double>, AssemblerEigenVector<double> > MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    unitCubeTets(V, F);
+    
+    double dt = 0.01, speed = 30.0, floor = -0.5, thickness = 1e-3;
+    
+    for(unsigned int schur=0; schur<2; ++schur) {
+        
+        MyWorld world;
+        FEMTets *cube = new FEMTets(V,F);
+        
+        //constructed with a stale step size, the stepper has to hand the detector the one it actually takes
+        CCD cd(std::ref(world), 10.0*dt, thickness);
+        cd.getImpl().getImpl().addPlane(Eigen::Vector3d(0,1,0), Eigen::Vector3d(0,floor,0));
+        
+        world.addSystem(cube);
+        world.addInequalityConstraint(&cd);
+        world.finalize();
+        
+        mapStateEigen(world).setZero();
+        Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
+        
+        for(unsigned int ii=0; ii<8; ++ii) {
+            qDot[3*ii+1] = -speed;
+        }
+        
+        MyTimeStepper stepper(dt, true, schur == 1);
+        
+        double yLowest = std::numeric_limits<double>::infinity();
+        
+        for(unsigned int istep=0; istep<10; ++istep) {
+            
+            stepper.step(world);
+            
+            double yMin = std::numeric_limits<double>::infinity();
+            for(unsigned int ii=0; ii<8; ++ii) {
+                yMin = std::min(yMin, cube->getPosition(world.getState(), ii)[1]);
+            }
+            
+            ASSERT_GE(yMin, floor + thickness - 1e-6);
+            yLowest = std::min(yLowest, yMin);
+        }
+        
+        ASSERT_LE(yLowest, floor + thickness + 1e-6);
+    }
+}
+
+TEST(Collisions, SDFClosesContactDistance) {
+    
+    //a cube falling onto a plane stored as a distance field. Vertices are reported contactDistance ahead of the plane but
+    //may close their gap within the step, so the cube lands on the plane instead of stopping where it was first reported.
+    //A cube pushed into the plane reports its penetration as the contact depth and may not sink further
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef ConstraintCollisionDetector<double, CollisionSDFImpl> SDF;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<ConstraintFixedPoint<double> *, SDF *> > MyWorld;
+    typedef TimeStepperEulerImplicitLinearCollisions<double, AssemblerEigenSparseMatrix<double>, AssemblerEigenVector<double> > MyTimeStepper;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    unitCubeTets(V, F);
+    
+    double dt = 0.01, speed = 10.0, floor = -0.5, contactDistance = 0.3, depth = 0.05;
+    
+    DistanceField<double> field;
+    field.fromFunction(Eigen::Vector3d(-1,-2,-1), Eigen::Vector3d(2,2,2), 0.1, [floor](const Eigen::Vector3d &x) { return x[1] - floor; });
+    
+    MyWorld world;
+    FEMTets *cube = new FEMTets(V,F);
+    SDF sdf(std::ref(world), field, contactDistance);
+    
+    world.addSystem(cube);
+    world.addInequalityConstraint(&sdf);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+    Eigen::Map<Eigen::VectorXd> qDot = mapStateEigen<1>(world);
+    
+    for(unsigned int ii=0; ii<8; ++ii) {
+        qDot[3*ii+1] = -speed;
+    }
+    
+    MyTimeStepper stepper(dt);
+    
+    double yLowest = std::numeric_limits<double>::infinity();
+    
+    for(unsigned int istep=0; istep<10; ++istep) {
+        
+        stepper.step(world);
+        
+        double yMin = std::numeric_limits<double>::infinity();
+        for(unsigned int ii=0; ii<8; ++ii) {
+            yMin = std::min(yMin, cube->getPosition(world.getState(), ii)[1]);
+        }
+        
+        ASSERT_GE(yMin, floor - 1e-6);
+        yLowest = std::min(yLowest, yMin);
+    }
+    
+    ASSERT_LE(yLowest, floor + 1e-6);
+    
+    //bottom face 5cm inside the plane
+    mapStateEigen(world).setZero();
+    for(unsigned int ii=0; ii<8; ++ii) {
+        q[3*ii+1] = floor - depth;
+    }
+    
+    auto &impl = sdf.getImpl().getImpl();
+    impl.detectCollisions(world);
+    
+    ASSERT_EQ(impl.getNumCollisions(), 4);
+    
+    Eigen::VectorXd b = Eigen::VectorXd::Ones(4);
+    impl.getContactBounds(b);
+    
+    for(unsigned int ii=0; ii<4; ++ii) {
+        ASSERT_NEAR(impl.getSharedInfo()[ii].getDepth(), depth, 1e-8);
+        ASSERT_EQ(b[ii], 0.0);
+    }
+}
+
+TEST(Collisions, ContactQPMatchesSchurLCP) {
+    
+    //small random SPD system with two equality and six contact rows, SolverContactQP finds the solution and multipliers of
+    //the dense active set solve, they are complementary and starting from the exact multipliers takes a single iteration
+    using namespace Gauss;
+    using namespace Collisions;
+    
+    unsigned int n = 20, numEq = 2, m = 8;
+    
+    srand(7);
+    
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(n,n);
+    Eigen::MatrixXd Adense = B.transpose()*B + n*Eigen::MatrixXd::Identity(n,n);
+    Eigen::SparseMatrix<double> A = Adense.sparseView();
+    Eigen::LDLT<Eigen::MatrixXd> factors(Adense);
+    
+    auto solveA = [&factors](const Eigen::VectorXd &rhs) -> Eigen::VectorXd { return factors.solve(rhs); };
+    
+    Eigen::SparseMatrix<double, Eigen::RowMajor> J = Eigen::MatrixXd(Eigen::MatrixXd::Random(m,n)).sparseView();
+    Eigen::VectorXd x0 = solveA(Eigen::VectorXd::Random(n));
+    
+    //about half of the contact rows are violated by the unconstrained solution
+    Eigen::VectorXd d = J*x0 + Eigen::VectorXd::Random(m);
+    
+    //reference, dense Schur complement
+    Eigen::MatrixXd Y = factors.solve(Eigen::MatrixXd(J.transpose()));
+    Eigen::MatrixXd S = J*Y;
+    Eigen::VectorXd q = J*x0 - d;
+    Eigen::VectorXd lambdaRef = Eigen::VectorXd::Zero(m);
+    
+    solveSchurComplementLCP(lambdaRef, S, q, numEq);
+    
+    Eigen::VectorXd xRef = x0 + Y*lambdaRef;
+    
+    ASSERT_GT((lambdaRef.tail(m - numEq).array() > 0).count(), 0);
+    ASSERT_LT((lambdaRef.tail(m - numEq).array() > 0).count(), m - numEq);
+    
+    SolverContactQP<double> solver(10000, 1e-10);
+    Eigen::VectorXd x, lambda;
+    
+    solver.solve(x, lambda, solveA, x0, J, d, numEq, Eigen::VectorXd(A.diagonal()));
+    
+    ASSERT_LE(solver.getResidual(), 1e-10);
+    ASSERT_LE((x - xRef).norm(), 1e-8*(1.0 + xRef.norm()));
+    ASSERT_LE((lambda - lambdaRef).norm(), 1e-6*(1.0 + lambdaRef.norm()));
+    
+    //complementarity
+    Eigen::VectorXd w = J*x - d;
+    
+    ASSERT_LE(w.head(numEq).cwiseAbs().maxCoeff(), 1e-9);
+    
+    for(unsigned int ii=numEq; ii<m; ++ii) {
+        ASSERT_GE(lambda[ii], 0);
+        ASSERT_GE(w[ii], -1e-9);
+        ASSERT_LE(std::abs(lambda[ii]*w[ii]), 1e-9*(1.0 + lambda.norm()));
+    }
+    
+    //warm start
+    lambda = lambdaRef;
+    solver.solve(x, lambda, solveA, x0, J, d, numEq, Eigen::VectorXd(A.diagonal()));
+    
+    ASSERT_EQ(solver.getNumIterations(), 1);
+    ASSERT_LE((x - xRef).norm(), 1e-8*(1.0 + xRef.norm()));
+}
+
+TEST(Collisions, SelfContactPairsReportedOnce) {
+    
+    //one FEM system made of two unit cubes, the second one 0.02 above the first and shifted sideways so vertices of each face
+    //land inside triangles of the other and the same vertex pairs are found from both sides. Every vertex pair is reported
+    //exactly once with the smaller id as object A, only pairs across the gap are reported and their normals point from B
+    //(the upper cube) towards A. Contacts are found again after the state changes
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<> > MyWorld;
+    
+    Eigen::MatrixXd V0, V(16,3);
+    Eigen::MatrixXi F0, F(10,4);
+    unitCubeTets(V0, F0);
+    
+    V << V0, V0.rowwise() + Eigen::RowVector3d(0.3, 0.2, 1.02);
+    F << F0, F0.array() + 8;
+    
+    MyWorld world;
+    FEMTets *cubes = new FEMTets(V,F);
+    
+    world.addSystem(cubes);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    
+    CollisionSelfImpl<double> self(world, 0.05);
+    
+    for(unsigned int call=0; call<2; ++call) {
+        
+        self.detectCollisions(world);
+        
+        auto &rowsA = self.getCollisionsObjectA().get<0>();
+        auto &rowsB = self.getCollisionsObjectB().get<0>();
+        auto &shared = self.getSharedInfo();
+        
+        ASSERT_GT(rowsA.size(), 0u);
+        ASSERT_EQ(rowsA.size(), rowsB.size());
+        ASSERT_EQ(self.getNumCollisions(), rowsA.size());
+        
+        std::set<std::pair<int, int> > pairs;
+        
+        for(unsigned int ii=0; ii<rowsA.size(); ++ii) {
+            
+            int a = rowsA[ii].getData(0), b = rowsB[ii].getData(0);
+            
+            ASSERT_EQ(rowsA[ii].getShared(), rowsB[ii].getShared());
+            ASSERT_LT(a, b);
+            ASSERT_LT(a, 8);
+            ASSERT_GE(b, 8);
+            ASSERT_TRUE(pairs.insert(std::make_pair(a, b)).second);
+            ASSERT_GT(shared[rowsA[ii].getShared()].getNormal().dot(Eigen::Vector3d(0,0,-1)), 0.99);
+        }
+        
+        //lower cube's top face against the upper cube's bottom face
+        for(auto &pair : pairs) {
+            ASSERT_NEAR(cubes->getPosition(world.getState(), pair.first)[2], 1.0, 1e-12);
+            ASSERT_NEAR(cubes->getPosition(world.getState(), pair.second)[2], 1.02, 1e-12);
+        }
+        
+        //second call with the upper cube moved sideways, still within the contact thickness
+        Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+        for(unsigned int ii=8; ii<16; ++ii) {
+            q[3*ii] = 0.1;
+        }
+    }
+}
+
+TEST(Collisions, WarmStartFollowsContactKeys) {
+    
+    //multipliers stored after one detection are handed back by contact key after the next one: the upper of two stacked cubes
+    //slides sideways so some vertex pairs persist (in different rows), some end and some are new. Persisting contacts get their
+    //old multiplier, new ones 0, and nothing is left after the cache is cleared
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<>, std::tuple<> > MyWorld;
+    
+    Eigen::MatrixXd V0, V(16,3);
+    Eigen::MatrixXi F0, F(10,4);
+    unitCubeTets(V0, F0);
+    
+    V << V0, V0.rowwise() + Eigen::RowVector3d(0.3, 0.2, 1.02);
+    F << F0, F0.array() + 8;
+    
+    MyWorld world;
+    FEMTets *cubes = new FEMTets(V,F);
+    
+    world.addSystem(cubes);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    
+    CollisionDetector<double, CollisionSelfImpl<double> > detector(world, 0.05);
+    
+    unsigned int offset = 3;
+    
+    detector.detectCollisions(world);
+    
+    std::vector<ContactKey> keys = detector.getContactKeys();
+    Eigen::VectorXd lambda = Eigen::VectorXd::Zero(offset + keys.size());
+    std::unordered_map<ContactKey, double, ContactKeyHash> stored;
+    
+    ASSERT_EQ(keys.size(), detector.getNumCollisions());
+    
+    for(unsigned int ii=0; ii<keys.size(); ++ii) {
+        lambda[offset + ii] = ii + 1;
+        ASSERT_TRUE(stored.insert(std::make_pair(keys[ii], lambda[offset + ii])).second);
+    }
+    
+    detector.setMultipliers(lambda, offset);
+    
+    Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+    for(unsigned int ii=8; ii<16; ++ii) {
+        q[3*ii] = -0.5;
+        q[3*ii+1] = -0.4;
+    }
+    
+    detector.detectCollisions(world);
+    
+    unsigned int numKept = 0, numNew = 0, numMoved = 0;
+    Eigen::VectorXd warmStart = Eigen::VectorXd::Constant(offset + detector.getNumCollisions(), -1);
+    
+    detector.getWarmStart(warmStart, offset);
+    
+    ASSERT_EQ(detector.getContactKeys().size(), detector.getNumCollisions());
+    
+    for(unsigned int ii=0; ii<offset; ++ii) {
+        ASSERT_EQ(warmStart[ii], -1);
+    }
+    
+    for(unsigned int ii=0; ii<detector.getNumCollisions(); ++ii) {
+        
+        auto &key = detector.getContactKeys()[ii];
+        auto old = stored.find(key);
+        
+        if(old == stored.end()) {
+            ASSERT_EQ(warmStart[offset + ii], 0);
+            ++numNew;
+        } else {
+            ASSERT_EQ(warmStart[offset + ii], old->second);
+            numMoved += (ii >= keys.size() || !(keys[ii] == key));
+            ++numKept;
+        }
+    }
+    
+    ASSERT_GT(numKept, 0u);
+    ASSERT_GT(numNew, 0u);
+    ASSERT_LT(numKept, keys.size());
+    ASSERT_GT(numMoved, 0u);
+    
+    detector.clearCache();
+    detector.getWarmStart(warmStart, offset);
+    
+    ASSERT_EQ(warmStart.tail(detector.getNumCollisions()).norm(), 0);
+}
+
+TEST(Collisions, ContactReductionKeepsContactPoints) {
+    
+    //ten contact points between two objects with three vertex rows each (like FCL triangle contacts), capped at four contact
+    //points per pair. The deepest contact point survives and every survivor keeps all three of its rows
+    using namespace Gauss;
+    using namespace Collisions;
+    
+    MultiVector<ObjectCollisionInfo<double, 0> > objA, objB;
+    std::vector<SharedCollisionInfo<double> > shared;
+    
+    for(unsigned int ii=0; ii<10; ++ii) {
+        for(unsigned int jj=0; jj<3; ++jj) {
+            shared.push_back(SharedCollisionInfo<double>(Eigen::Vector3d(0,1,0), Eigen::Vector3d(ii,0,0), 0.01*(ii+1)));
+            objA.add(ObjectCollisionInfo<double, 0>(shared.size()-1, SystemIndex(0,0), 3*ii+jj));
+            objB.add(ObjectCollisionInfo<double, 0>(shared.size()-1, SystemIndex(0,1), 3*ii+jj));
+        }
+    }
+    
+    ContactReduction<double> reduction(4);
+    reduction.reduce(objA, objB, shared);
+    
+    auto &rows = objA.get<0>();
+    
+    ASSERT_EQ(rows.size(), 12);
+    ASSERT_EQ(shared.size(), 12);
+    
+    std::map<int, unsigned int> rowsPerPoint;
+    
+    for(unsigned int ii=0; ii<rows.size(); ++ii) {
+        int point = rows[ii].getData(0)/3;
+        ASSERT_EQ(shared[rows[ii].getShared()].getPosition()[0], point);
+        ++rowsPerPoint[point];
+    }
+    
+    ASSERT_EQ(rowsPerPoint.size(), 4);
+    ASSERT_EQ(rowsPerPoint.count(9), 1);
+    
+    for(auto &point : rowsPerPoint) {
+        ASSERT_EQ(point.second, 3);
+    }
+}
+
+TEST(Collisions, ContactReductionMergesDuplicatesAndClusters) {
+    
+    //rows with the same vertex pair merge into the first of them with the averaged normal and the largest depth. Within an
+    //object pair contacts closer than the radius to a deeper contact with a similar normal are dropped together with all rows
+    //of their contact point, contacts with a different normal or in another object pair survive. Survivors keep their order
+    using namespace Gauss;
+    using namespace Collisions;
+    
+    MultiVector<ObjectCollisionInfo<double, 0> > objA, objB;
+    std::vector<SharedCollisionInfo<double> > shared;
+    
+    auto add = [&](int objectB, int vertexA, int vertexB, const Eigen::Vector3d &normal, double x, double depth) {
+        shared.push_back(SharedCollisionInfo<double>(normal, Eigen::Vector3d(x,0,0), depth));
+        objA.add(ObjectCollisionInfo<double, 0>(shared.size()-1, SystemIndex(0,0), vertexA));
+        objB.add(ObjectCollisionInfo<double, 0>(shared.size()-1, SystemIndex(0,objectB), vertexB));
+    };
+    
+    Eigen::Vector3d up(0,1,0), side(1,0,0);
+    
+    {
+        add(1, 0, 0, up, 0.0, 0.01);
+        add(1, 1, 0, up, 0.5, 0.02);
+        add(1, 0, 0, side, 0.1, 0.03);
+        
+        ContactReduction<double> reduction;
+        reduction.reduce(objA, objB, shared);
+        
+        auto &rowsA = objA.get<0>();
+        
+        ASSERT_EQ(rowsA.size(), 2u);
+        ASSERT_EQ(shared.size(), 2u);
+        ASSERT_EQ(rowsA[0].getData(0), 0);
+        ASSERT_EQ(rowsA[1].getData(0), 1);
+        
+        for(unsigned int ii=0; ii<rowsA.size(); ++ii) {
+            ASSERT_EQ(rowsA[ii].getShared(), ii);
+            ASSERT_EQ(objB.get<0>()[ii].getShared(), ii);
+        }
+        
+        ASSERT_LE((shared[0].getNormal() - (up + side).normalized()).norm(), 1e-12);
+        ASSERT_EQ(shared[0].getDepth(), 0.03);
+        ASSERT_EQ(shared[0].getPosition()[0], 0.0);
+        ASSERT_EQ(shared[1].getDepth(), 0.02);
+    }
+    
+    objA.clear();
+    objB.clear();
+    shared.clear();
+    
+    //three rows per contact point like FCL triangle contacts, vertex ids encode the point
+    std::vector<double> x = {0.0, 0.05, 0.3, 0.32}, depth = {0.01, 0.02, 0.03, 0.005};
+    
+    for(unsigned int ii=0; ii<x.size(); ++ii) {
+        for(unsigned int jj=0; jj<3; ++jj) {
+            add(1, 10*ii + jj, jj, up, x[ii], depth[ii]);
+        }
+    }
+    
+    add(1, 40, 0, side, 0.0, 0.001);
+    add(2, 50, 0, up, 0.32, 0.001);
+    
+    ContactReduction<double> reduction(0, 0.1);
+    reduction.reduce(objA, objB, shared);
+    
+    auto &rowsA = objA.get<0>();
+    std::vector<int> kept;
+    
+    for(unsigned int ii=0; ii<rowsA.size(); ++ii) {
+        kept.push_back(rowsA[ii].getData(0));
+        ASSERT_EQ(rowsA[ii].getShared(), ii);
+    }
+    
+    ASSERT_EQ(kept, std::vector<int>({10, 11, 12, 20, 21, 22, 40, 50}));
+    ASSERT_EQ(shared.size(), kept.size());
+    ASSERT_EQ(shared[3].getDepth(), 0.03);
+}
+
+TEST(Collisions, BarrierDerivatives) {
+    
+    //two cubes inside each others barrier and inside the barrier of the floor (vertex-plane, vertex-triangle and edge-edge pairs),
+    //the forces are the central differences of the energy. The stiffness matrix only keeps b''(d)*grad(d)*grad(d)' (Gauss-Newton,
+    //b'(d)*hess(d) is dropped). That is the exact derivative of the force for vertex-plane pairs (the distance is linear), checked
+    //with the floor alone. With vertex-triangle and edge-edge pairs it stays symmetric negative semi-definite and, since b' vanishes
+    //at dHat, close to the derivative of the force for pairs near dHat
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef ForceBarrier<double, FEMTets> Barrier;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<Barrier *>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    unitCubeTets(V, F);
+    
+    double dHat = 0.1, h = 1e-7;
+    
+    srand(11);
+    
+    Eigen::MatrixXd V0 = V.rowwise() + Eigen::RowVector3d(0, 0.5*dHat, 0);
+    Eigen::MatrixXd V1 = V.rowwise() + Eigen::RowVector3d(0.3, 1.0 + dHat, 0.2);
+    
+    V0 += 0.05*dHat*Eigen::MatrixXd::Random(8,3);
+    V1 += 0.05*dHat*Eigen::MatrixXd::Random(8,3);
+    
+    for(unsigned int test=0; test<2; ++test) {
+        
+        MyWorld world;
+        FEMTets *cube0 = new FEMTets(V0,F);
+        Barrier barrier(cube0, dHat);
+        
+        barrier.getImpl().addPlane(Eigen::Vector3d(0,1,0), Eigen::Vector3d(0,0,0));
+        world.addSystem(cube0);
+        
+        if(test == 0) {
+            FEMTets *cube1 = new FEMTets(V1,F);
+            barrier.getImpl().addSystem(cube1);
+            world.addSystem(cube1);
+        }
+        
+        world.addForce(&barrier);
+        world.finalize();
+        
+        mapStateEigen(world).setZero();
+        Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+        
+        AssemblerEigenVector<double> force;
+        AssemblerEigenSparseMatrix<double> stiffness;
+        
+        auto getForce = [&world, &force]() -> Eigen::VectorXd {
+            ASSEMBLEVECINIT(force, world.getNumQDotDOFs());
+            ASSEMBLELIST(force, world.getForceList(), getForce);
+            ASSEMBLEEND(force);
+            return (*force);
+        };
+        
+        Eigen::VectorXd f = getForce();
+        
+        ASSERT_GT(barrier.getImpl().getNumActivePairs(), (test == 0 ? 8 : 3));
+        ASSERT_GT(f.norm(), 0);
+        
+        ASSEMBLEMATINIT(stiffness, world.getNumQDotDOFs(), world.getNumQDotDOFs());
+        ASSEMBLELIST(stiffness, world.getForceList(), getStiffnessMatrix);
+        ASSEMBLEEND(stiffness);
+        
+        Eigen::MatrixXd K = Eigen::MatrixXd(*stiffness);
+        Eigen::MatrixXd J(K.rows(), K.cols());
+        
+        for(unsigned int ii=0; ii<q.rows(); ++ii) {
+            
+            q[ii] += h;
+            double energyPlus = barrier.getEnergy(world.getState());
+            Eigen::VectorXd fPlus = getForce();
+            
+            q[ii] -= 2*h;
+            double energyMinus = barrier.getEnergy(world.getState());
+            Eigen::VectorXd fMinus = getForce();
+            
+            q[ii] += h;
+            
+            ASSERT_LE(std::abs(f[ii] + (energyPlus - energyMinus)/(2*h)), 1e-5*(1.0 + f.cwiseAbs().maxCoeff()));
+            
+            J.col(ii) = (fPlus - fMinus)/(2*h);
+        }
+        
+        if(test == 1) {
+            ASSERT_LE((K - J).norm(), 1e-5*(1.0 + K.norm()));
+        } else {
+            Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigs(K);
+            
+            ASSERT_LE((K - K.transpose()).norm(), 1e-10*K.norm());
+            ASSERT_LE(eigs.eigenvalues().maxCoeff(), 1e-10*K.norm());
+            ASSERT_LE((K - J).norm(), 0.05*K.norm());
+        }
+    }
+}
+
+TEST(Collisions, BarrierStepBound) {
+    
+    //a cube resting inside the barrier of the floor is pushed through it, the step bound keeps it above the floor with finite
+    //energy and allows steps away from the floor completely
+    using namespace Gauss;
+    using namespace FEM;
+    using namespace Collisions;
+    
+    typedef PhysicalSystemFEM<double, NeohookeanTet> FEMTets;
+    typedef ForceBarrier<double, FEMTets> Barrier;
+    typedef World<double, std::tuple<FEMTets *>, std::tuple<Barrier *>, std::tuple<ConstraintFixedPoint<double> *> > MyWorld;
+    
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    unitCubeTets(V, F);
+    
+    double dHat = 0.1, gap = 0.5*dHat;
+    
+    MyWorld world;
+    FEMTets *cube = new FEMTets(Eigen::MatrixXd(V.rowwise() + Eigen::RowVector3d(0, gap, 0)), F);
+    Barrier barrier(cube, dHat);
+    
+    barrier.getImpl().addPlane(Eigen::Vector3d(0,1,0), Eigen::Vector3d(0,0,0));
+    world.addSystem(cube);
+    world.addForce(&barrier);
+    world.finalize();
+    
+    mapStateEigen(world).setZero();
+    Eigen::Map<Eigen::VectorXd> q = mapStateEigen<0>(world);
+    
+    //move down by 10 gaps
+    Eigen::VectorXd dq = Eigen::VectorXd::Zero(q.rows());
+    for(unsigned int ii=0; ii<8; ++ii) {
+        dq[3*ii+1] = -10*gap;
+    }
+    
+    double alpha = getStepBound(world, dq);
+    
+    ASSERT_GT(alpha, 0);
+    ASSERT_LE(std::abs(alpha - 0.8*0.1), 1e-12);
+    
+    q += alpha*dq;
+    
+    for(unsigned int ii=0; ii<8; ++ii) {
+        ASSERT_GT(cube->getPosition(world.getState(), ii)[1], 0);
+    }
+    
+    ASSERT_TRUE(std::isfinite(barrier.getEnergy(world.getState())));
+    
+    //steps away from the floor are not limited
+    ASSERT_EQ(getStepBound(world, Eigen::VectorXd(-dq)), 1.0);
+}
+
+//5 point Laplacian of a res x res grid plus shift*I, sparse SPD test matrix for the linear solvers
+Eigen::SparseMatrix<double> gridLaplacian(unsigned int res, double shift) {
+    
+    unsigned int n = res*res;
+    std::vector<Eigen::Triplet<double> > triplets;
+    
+    for(unsigned int ii=0; ii<res; ++ii) {
+        for(unsigned int jj=0; jj<res; ++jj) {
+            
+            unsigned int row = ii*res + jj;
+            triplets.push_back(Eigen::Triplet<double>(row, row, 4.0 + shift));
+            
+            if(ii+1 < res) {
+                triplets.push_back(Eigen::Triplet<double>(row, row + res, -1.0));
+                triplets.push_back(Eigen::Triplet<double>(row + res, row, -1.0));
+            }
+            
+            if(jj+1 < res) {
+                triplets.push_back(Eigen::Triplet<double>(row, row + 1, -1.0));
+                triplets.push_back(Eigen::Triplet<double>(row + 1, row, -1.0));
+            }
+        }
+    }
+    
+    Eigen::SparseMatrix<double> A(n,n);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    
+    return A;
+}
+
+TEST(Solvers, MultipleRHSMatchesColumnSolves) {
+    
+    //blocked substitution against a wide right hand side (not a multiple of the block size) gives the per column solves, with and
+    //without a fill reducing permutation and for any block size
+    Eigen::SparseMatrix<double> A = gridLaplacian(20, 0.1);
+    
+    srand(3);
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(A.rows(), 37);
+    
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > ldlt(A);
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::NaturalOrdering<int> > ldltNatural(A);
+    
+    Eigen::MatrixXd X(B.rows(), B.cols());
+    
+    for(unsigned int ii=0; ii<B.cols(); ++ii) {
+        X.col(ii) = ldlt.solve(Eigen::VectorXd(B.col(ii)));
+    }
+    
+    ASSERT_LE((A*X - B).norm(), 1e-10*B.norm());
+    
+    for(unsigned int blockSize : {0u, 1u, 16u, 64u}) {
+        ASSERT_LE((solveMultipleRHS(ldlt, B, blockSize) - X).norm(), 1e-12*X.norm());
+        ASSERT_LE((solveMultipleRHS(ldltNatural, B, blockSize) - X).norm(), 1e-12*X.norm());
+    }
+}
+
+TEST(Solvers, MixedPrecisionMatchesDouble) {
+    
+    //a float factor of a badly conditioned SPD matrix (condition number ~1e4) alone is far from double accuracy, iterative
+    //refinement and float preconditioned CG both recover the double precision solution and report success
+    Eigen::SparseMatrix<double> A = gridLaplacian(30, 1e-3);
+    
+    srand(4);
+    Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+    
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > ldlt(A);
+    Eigen::VectorXd x = ldlt.solve(b);
+    
+    SolverMixedPrecision<double> floatOnly(SolverPrecision::MixedRefinement, 0);
+    floatOnly.compute(A);
+    
+    ASSERT_GT((floatOnly.solve(b) - x).norm(), 1e-6*x.norm());
+    
+    for(SolverPrecision mode : {SolverPrecision::MixedRefinement, SolverPrecision::MixedPCG}) {
+        
+        SolverMixedPrecision<double> solver(mode, 50, 1e-12);
+        solver.compute(A);
+        
+        ASSERT_EQ(solver.info(), Eigen::Success);
+        
+        Eigen::VectorXd xMixed = solver.solve(b);
+        
+        ASSERT_EQ(solver.info(), Eigen::Success);
+        ASSERT_GT(solver.getNumIterations(), 0);
+        ASSERT_LE((A*xMixed - b).norm(), 1e-12*b.norm());
+        ASSERT_LE((xMixed - x).norm(), 1e-9*x.norm());
+    }
+}
+
+TEST(Eigensolvers, ShiftInvertMatchesDense) {
+    
+    //smallest magnitude eigenpairs of A x = lambda B x (A negative definite like a stiffness matrix) with a nonzero shift, from
+    //Lanczos on a cold start and from the warm started block iteration after B changes. Eigenvalues match the dense solver
+    //(this checks the back transform lambda = shift - 1/mu), eigenvectors are B-normalized eigenvectors
+    unsigned int numVecs = 5;
+    double shift = 0.05;
+    
+    Eigen::SparseMatrix<double> A = -gridLaplacian(12, 0.0);
+    unsigned int n = A.rows();
+    
+    auto mass = [n](double eps) {
+        Eigen::SparseMatrix<double> B(n,n);
+        for(unsigned int ii=0; ii<n; ++ii) {
+            B.insert(ii,ii) = 1.0 + 0.5*std::sin(ii) + eps*std::cos(3*ii);
+        }
+        return B;
+    };
+    
+    GeneralizedEigenSolverShiftInvert<double> solver;
+    
+    for(unsigned int call=0; call<2; ++call) {
+        
+        Eigen::SparseMatrix<double> B = mass(call == 0 ? 0.0 : 0.02);
+        Eigen::MatrixXd Ad = -A, Bd = B;
+        Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> dense(Ad, Bd);
+        
+        auto eigs = solver.compute(A, B, numVecs, shift);
+        
+        if(call == 1) {
+            ASSERT_GT(solver.getNumWarmIterations(), 0);
+        }
+        
+        ASSERT_EQ(eigs.first.cols(), numVecs);
+        ASSERT_EQ(eigs.second.rows(), numVecs);
+        
+        for(unsigned int ii=0; ii<numVecs; ++ii) {
+            
+            Eigen::VectorXd v = eigs.first.col(ii);
+            double lambda = eigs.second[ii];
+            
+            ASSERT_NEAR(lambda, -dense.eigenvalues()[ii], 1e-8*dense.eigenvalues()[ii]);
+            ASSERT_NEAR(v.dot(B*v), 1.0, 1e-8);
+            ASSERT_LE((A*v - lambda*(B*v)).norm(), 1e-5*std::abs(lambda));
+        }
+    }
+}
+
+TEST(Eigensolvers, LOBPCGMatchesShiftInvert) {
+    
+    //smallest eigenpairs of a 2D Laplacian against a varying diagonal mass, LOBPCG with and without a block Jacobi
+    //preconditioner agrees with shift-invert Lanczos and the dense solver, its eigenvectors are M-orthonormal and a second,
+    //warm started call on the same problem takes fewer iterations than the first
+    unsigned int numVecs = 6;
+    
+    Eigen::SparseMatrix<double> K = gridLaplacian(12, 0.0);
+    unsigned int n = K.rows();
+    
+    Eigen::SparseMatrix<double> M(n,n);
+    for(unsigned int ii=0; ii<n; ++ii) {
+        M.insert(ii,ii) = 1.0 + 0.5*std::sin(ii);
+    }
+    
+    Eigen::MatrixXd Kd = K, Md = M;
+    Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> dense(Kd, Md);
+    
+    GeneralizedEigenSolverShiftInvert<double> shiftInvert;
+    Eigen::SparseMatrix<double> A = -K;
+    auto reference = shiftInvert.compute(A, M, numVecs, 1e-6);
+    
+    for(unsigned int ii=0; ii<numVecs; ++ii) {
+        ASSERT_NEAR(-reference.second[ii], dense.eigenvalues()[ii], 1e-8*dense.eigenvalues()[ii]);
+    }
+    
+    PreconditionerBlockJacobi<double> pc(K);
+    
+    for(unsigned int usePC=0; usePC<2; ++usePC) {
+        
+        SolverLOBPCG<double> solver(500, 1e-8);
+        
+        auto solve = [&]() {
+            if(usePC) {
+                return solver.compute([&K](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return K*x; },
+                                      [&M](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return M*x; },
+                                      [&pc](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return pc(x); }, n, numVecs);
+            }
+            
+            return solver.compute([&K](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return K*x; },
+                                  [&M](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return M*x; }, n, numVecs);
+        };
+        
+        ASSERT_TRUE(solve());
+        
+        unsigned int coldIterations = solver.getNumIterations();
+        Eigen::MatrixXd U = solver.eigenvectors();
+        Eigen::VectorXd lambda = solver.eigenvalues();
+        
+        ASSERT_EQ(U.cols(), numVecs);
+        ASSERT_EQ(lambda.rows(), numVecs);
+        ASSERT_LE((U.transpose()*M*U - Eigen::MatrixXd::Identity(numVecs, numVecs)).norm(), 1e-8);
+        
+        for(unsigned int ii=0; ii<numVecs; ++ii) {
+            ASSERT_NEAR(lambda[ii], -reference.second[ii], 1e-6*lambda[ii]);
+            ASSERT_LE((K*U.col(ii) - lambda[ii]*(M*U.col(ii))).norm(), 1e-5*lambda[ii]);
+        }
+        
+        ASSERT_TRUE(solve());
+        ASSERT_LT(solver.getNumIterations(), coldIterations);
+    }
+}
+
+//exposes the warm start block
+class SolverLOBPCGWarmStart : public SolverLOBPCG<double> {
+public:
+    inline void setBlock(const Eigen::MatrixXd &X) { m_X = X; }
+};
+
+TEST(LOBPCG, RankDeficientWarmStart) {
+    
+    //a warm start block made of four copies of two vectors is refilled with random directions, the smallest eigenpairs of a
+    //1D Laplacian against a varying diagonal mass still come out complete, M-orthonormal and equal to the dense solution
+    unsigned int n = 60, numVecs = 4, blockSize = 8;
+    
+    Eigen::SparseMatrix<double> K(n,n), M(n,n);
+    std::vector<Eigen::Triplet<double> > KT, MT;
+    
+    for(unsigned int ii=0; ii<n; ++ii) {
+        KT.push_back(Eigen::Triplet<double>(ii, ii, 2.0));
+        MT.push_back(Eigen::Triplet<double>(ii, ii, 1.0 + static_cast<double>(ii)/n));
+        
+        if(ii+1 < n) {
+            KT.push_back(Eigen::Triplet<double>(ii, ii+1, -1.0));
+            KT.push_back(Eigen::Triplet<double>(ii+1, ii, -1.0));
+        }
+    }
+    
+    K.setFromTriplets(KT.begin(), KT.end());
+    M.setFromTriplets(MT.begin(), MT.end());
+    
+    Eigen::MatrixXd Kd = K, Md = M;
+    Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> dense(Kd, Md);
+    
+    srand(5);
+    
+    Eigen::MatrixXd X0 = Eigen::MatrixXd::Random(n,2), X(n, blockSize);
+    X << X0, X0, X0, X0;
+    
+    SolverLOBPCGWarmStart solver;
+    solver.setBlock(X);
+    
+    ASSERT_TRUE(solver.compute([&K](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return K*x; },
+                               [&M](const Eigen::MatrixXd &x) -> Eigen::MatrixXd { return M*x; }, n, numVecs));
+    
+    Eigen::MatrixXd U = solver.eigenvectors();
+    Eigen::VectorXd lambda = solver.eigenvalues();
+    
+    ASSERT_EQ(U.cols(), numVecs);
+    ASSERT_EQ(lambda.rows(), numVecs);
+    ASSERT_LE((U.transpose()*M*U - Eigen::MatrixXd::Identity(numVecs, numVecs)).norm(), 1e-8);
+    
+    for(unsigned int ii=0; ii<numVecs; ++ii) {
+        ASSERT_NEAR(lambda[ii], dense.eigenvalues()[ii], 1e-6*dense.eigenvalues()[ii]);
+    }
+}
+
 int main(int argc, char **argv) {
     std::cout<<"Start Tests ..... \n";
     